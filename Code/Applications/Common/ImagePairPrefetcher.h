@@ -0,0 +1,159 @@
+// Reads a list of image pairs ahead of the code scoring them, on threads of
+// its own, so decoding the next pairs (inflating .nii.gz and .mha files, for
+// one) overlaps the metric computations on the current ones
+//
+// Pairs are read in the read order, by default their order in the list.
+// Read pairs wait in a bounded queue until taken with GetPair: readers stop
+// while the queue holds MaximumQueueLength pairs or, with a memory limit,
+// while the pixel data of the queued pairs reaches it. Memory mapped images
+// (see MappedImageFileReader) hold no heap memory and count for nothing.
+// The limit is checked before each read, so the pairs being read can take
+// the queue past it by at most one pair per reader thread.
+//
+// GetPair blocks until the pair has been read. A pair that no reader has
+// started yet is read by the calling thread instead, so callers may take
+// pairs in any order without waiting on a full queue. Errors from reading a
+// pair are thrown by GetPair for that pair.
+
+#ifndef _ImagePairPrefetcher_h
+#define _ImagePairPrefetcher_h
+
+#include "itkConditionVariable.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkObject.h"
+
+#include "MappedImageFileReader.h"
+
+#include <string>
+#include <vector>
+
+template <class TFixedImage, class TMovingImage>
+class ImagePairPrefetcher: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef ImagePairPrefetcher                                Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  typedef TFixedImage FixedImageType;
+  typedef TMovingImage MovingImageType;
+
+  typedef typename FixedImageType::Pointer FixedImagePointer;
+  typedef typename MovingImageType::Pointer MovingImagePointer;
+
+  typedef MappedImageFileReader<FixedImageType> FixedReaderType;
+  typedef MappedImageFileReader<MovingImageType> MovingReaderType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ImagePairPrefetcher, itk::Object);
+
+  /** Appends a pair to the list, returning its number. */
+  unsigned int AddPair(const std::string& fixedfn, const std::string& movingfn);
+
+  unsigned int GetNumberOfPairs() const { return m_Pairs.size(); }
+
+  /** Order in which readers take the pairs, a permutation of the list. */
+  void SetReadOrder(const std::vector<unsigned int>& order);
+
+  itkSetMacro(NumberOfReaderThreads, unsigned int);
+  itkGetConstMacro(NumberOfReaderThreads, unsigned int);
+
+  /** Read pairs not yet taken beyond which readers wait. */
+  itkSetMacro(MaximumQueueLength, unsigned int);
+  itkGetConstMacro(MaximumQueueLength, unsigned int);
+
+  /** Bytes of pixel data of the queued pairs, 0 for no limit. */
+  itkSetMacro(MemoryLimit, itk::SizeValueType);
+  itkGetConstMacro(MemoryLimit, itk::SizeValueType);
+
+  /** Starts the reader threads. */
+  void Start();
+
+  /** Stops the reader threads once their current reads are done. */
+  void Stop();
+
+  /**
+   * Images of pair i, read by a reader thread or by this call. Each pair
+   * can be taken once, the prefetcher keeps no reference to it afterwards.
+   */
+  void GetPair(unsigned int i,
+    FixedImagePointer& fixedImage, MovingImagePointer& movingImage);
+
+protected:
+
+  ImagePairPrefetcher();
+  ~ImagePairPrefetcher();
+
+  typedef enum {Waiting, Reading, Read, Taken} PairStateType;
+
+  struct PairType
+  {
+    std::string FixedFileName;
+    std::string MovingFileName;
+
+    PairStateType State;
+
+    // Whether a reader thread, rather than GetPair, is reading the pair
+    bool Prefetched;
+
+    FixedImagePointer FixedImage;
+    MovingImagePointer MovingImage;
+
+    // Heap memory of the read images
+    itk::SizeValueType Size;
+
+    std::string Error;
+  };
+
+  static ITK_THREAD_RETURN_TYPE ReaderCallback(void* arg);
+
+  void ThreadedRead();
+
+  // Reads the images of the pair, outside of the lock
+  void ReadPair(PairType& pair);
+
+  // Next pair a reader may start, m_Pairs.size() when none is left
+  unsigned int NextPairToRead();
+
+  std::vector<PairType> m_Pairs;
+  std::vector<unsigned int> m_ReadOrder;
+
+  // Position in the read order of the next pair to look at
+  unsigned int m_NextRead;
+
+  unsigned int m_NumberOfReaderThreads;
+  unsigned int m_MaximumQueueLength;
+  itk::SizeValueType m_MemoryLimit;
+
+  // Prefetched pairs being read or read and not taken, and their size
+  unsigned int m_QueueLength;
+  itk::SizeValueType m_QueueSize;
+
+  bool m_Stopping;
+
+  itk::MultiThreader::Pointer m_Threader;
+  std::vector<itk::ThreadIdType> m_ReaderThreadIds;
+
+  itk::SimpleMutexLock m_Lock;
+  itk::ConditionVariable::Pointer m_Changed;
+
+private:
+
+  ImagePairPrefetcher(const Self&);  // Not implemented
+  void operator=(const Self&);       // Not implemented
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "ImagePairPrefetcher.txx"
+#endif
+
+#endif
@@ -0,0 +1,285 @@
+
+#ifndef _ImagePairPrefetcher_txx
+#define _ImagePairPrefetcher_txx
+
+#include "ImagePairPrefetcher.h"
+
+#include <exception>
+#include <sstream>
+
+template <class TFixedImage, class TMovingImage>
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::ImagePairPrefetcher()
+{
+  m_NextRead = 0;
+
+  m_NumberOfReaderThreads = 2;
+  m_MaximumQueueLength = 4;
+  m_MemoryLimit = 0;
+
+  m_QueueLength = 0;
+  m_QueueSize = 0;
+
+  m_Stopping = false;
+
+  m_Threader = itk::MultiThreader::New();
+  m_Changed = itk::ConditionVariable::New();
+}
+
+template <class TFixedImage, class TMovingImage>
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::~ImagePairPrefetcher()
+{
+  this->Stop();
+}
+
+template <class TFixedImage, class TMovingImage>
+unsigned int
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::AddPair(const std::string& fixedfn, const std::string& movingfn)
+{
+  if (!m_ReaderThreadIds.empty())
+    itkExceptionMacro(<< "Pairs cannot be added while reading");
+
+  PairType pair;
+  pair.FixedFileName = fixedfn;
+  pair.MovingFileName = movingfn;
+  pair.State = Waiting;
+  pair.Prefetched = false;
+  pair.Size = 0;
+
+  m_ReadOrder.push_back(m_Pairs.size());
+  m_Pairs.push_back(pair);
+
+  return m_Pairs.size() - 1;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::SetReadOrder(const std::vector<unsigned int>& order)
+{
+  if (!m_ReaderThreadIds.empty())
+    itkExceptionMacro(<< "Read order cannot be changed while reading");
+
+  std::vector<bool> listed(m_Pairs.size(), false);
+  for (unsigned int k = 0; k < order.size(); k++)
+  {
+    if (order[k] >= m_Pairs.size() || listed[order[k]])
+      itkExceptionMacro(<< "Read order is not a permutation of the pairs");
+    listed[order[k]] = true;
+  }
+  if (order.size() != m_Pairs.size())
+    itkExceptionMacro(<< "Read order is not a permutation of the pairs");
+
+  m_ReadOrder = order;
+  m_NextRead = 0;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::Start()
+{
+  if (!m_ReaderThreadIds.empty())
+    return;
+
+  m_Stopping = false;
+
+  unsigned int numThreads = m_NumberOfReaderThreads;
+  if (numThreads > m_Pairs.size())
+    numThreads = m_Pairs.size();
+
+  for (unsigned int t = 0; t < numThreads; t++)
+    m_ReaderThreadIds.push_back(
+      m_Threader->SpawnThread(Self::ReaderCallback, this));
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::Stop()
+{
+  m_Lock.Lock();
+  m_Stopping = true;
+  m_Changed->Broadcast();
+  m_Lock.Unlock();
+
+  for (unsigned int t = 0; t < m_ReaderThreadIds.size(); t++)
+    m_Threader->TerminateThread(m_ReaderThreadIds[t]);
+  m_ReaderThreadIds.clear();
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::GetPair(unsigned int i,
+  FixedImagePointer& fixedImage, MovingImagePointer& movingImage)
+{
+  if (i >= m_Pairs.size())
+    itkExceptionMacro(<< "Pair " << i << " is not in the list");
+
+  PairType& pair = m_Pairs[i];
+
+  m_Lock.Lock();
+
+  if (pair.State == Taken)
+  {
+    m_Lock.Unlock();
+    itkExceptionMacro(<< "Pair " << i << " has already been taken");
+  }
+
+  // Not started by a reader, read it here rather than wait for one
+  if (pair.State == Waiting)
+  {
+    pair.State = Reading;
+    pair.Prefetched = false;
+    m_Lock.Unlock();
+
+    this->ReadPair(pair);
+
+    m_Lock.Lock();
+    pair.State = Read;
+  }
+
+  while (pair.State == Reading)
+    m_Changed->Wait(&m_Lock);
+
+  fixedImage = pair.FixedImage;
+  movingImage = pair.MovingImage;
+  pair.FixedImage = 0;
+  pair.MovingImage = 0;
+  pair.State = Taken;
+
+  std::string error = pair.Error;
+
+  if (pair.Prefetched)
+  {
+    m_QueueLength--;
+    m_QueueSize -= pair.Size;
+    m_Changed->Broadcast();
+  }
+
+  m_Lock.Unlock();
+
+  if (!error.empty())
+    itkExceptionMacro(<< error);
+}
+
+template <class TFixedImage, class TMovingImage>
+ITK_THREAD_RETURN_TYPE
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::ReaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedRead();
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::ThreadedRead()
+{
+  m_Lock.Lock();
+
+  while (!m_Stopping)
+  {
+    unsigned int i = this->NextPairToRead();
+    if (i == m_Pairs.size())
+      break;
+
+    bool full = m_QueueLength >= m_MaximumQueueLength ||
+      (m_MemoryLimit > 0 && m_QueueSize >= m_MemoryLimit);
+    if (full)
+    {
+      m_Changed->Wait(&m_Lock);
+      continue;
+    }
+
+    PairType& pair = m_Pairs[i];
+    pair.State = Reading;
+    pair.Prefetched = true;
+    m_QueueLength++;
+    m_Lock.Unlock();
+
+    this->ReadPair(pair);
+
+    m_Lock.Lock();
+    pair.State = Read;
+    m_QueueSize += pair.Size;
+    m_Changed->Broadcast();
+  }
+
+  m_Lock.Unlock();
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::ReadPair(PairType& pair)
+{
+  pair.Size = 0;
+
+  try
+  {
+    typename FixedReaderType::Pointer freader = FixedReaderType::New();
+    freader->SetFileName(pair.FixedFileName);
+    freader->Update();
+    pair.FixedImage = freader->GetOutput();
+    if (!freader->GetMapped())
+      pair.Size += pair.FixedImage->GetBufferedRegion().GetNumberOfPixels() *
+        sizeof(typename FixedImageType::PixelType);
+
+    typename MovingReaderType::Pointer mreader = MovingReaderType::New();
+    mreader->SetFileName(pair.MovingFileName);
+    mreader->Update();
+    pair.MovingImage = mreader->GetOutput();
+    if (!mreader->GetMapped())
+      pair.Size += pair.MovingImage->GetBufferedRegion().GetNumberOfPixels() *
+        sizeof(typename MovingImageType::PixelType);
+  }
+  catch (itk::ExceptionObject& e)
+  {
+    std::ostringstream oss;
+    oss << e;
+    pair.Error = oss.str();
+  }
+  catch (std::exception& e)
+  {
+    pair.Error = std::string("Exception: ") + e.what();
+  }
+  catch (...)
+  {
+    pair.Error = "Unknown exception";
+  }
+
+  // Images of a pair that failed are not kept
+  if (!pair.Error.empty())
+  {
+    pair.FixedImage = 0;
+    pair.MovingImage = 0;
+    pair.Size = 0;
+  }
+}
+
+template <class TFixedImage, class TMovingImage>
+unsigned int
+ImagePairPrefetcher<TFixedImage, TMovingImage>
+::NextPairToRead()
+{
+  while (m_NextRead < m_ReadOrder.size() &&
+         m_Pairs[m_ReadOrder[m_NextRead]].State != Waiting)
+    m_NextRead++;
+
+  if (m_NextRead == m_ReadOrder.size())
+    return m_Pairs.size();
+
+  return m_ReadOrder[m_NextRead];
+}
+
+#endif
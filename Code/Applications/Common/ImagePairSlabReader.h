@@ -0,0 +1,112 @@
+// Reads two images of the same size slab by slab, for metrics that only
+// accumulate counts over voxels and so never need a whole volume in memory
+//
+// Slabs are bands of whole slices along the last axis, as thick as the
+// memory limit allows for one slab of both images together. Each slab is
+// read through the ImageFileReader requested region, so file formats whose
+// ImageIO can stream (uncompressed MetaImage, for one) only load the slab.
+// Other formats, images of different sizes and a memory limit of zero read
+// both images whole, as a single slab.
+//
+// When both files can be memory mapped as they are (see MappedImageFile)
+// there is a single slab of the two mapped images, since mapping costs no
+// heap memory whatever the image size.
+//
+// The images returned for a slab have it as their requested region, which
+// is what the overlap calculators and counters iterate over.
+
+#ifndef _ImagePairSlabReader_h
+#define _ImagePairSlabReader_h
+
+#include "itkImageFileReader.h"
+#include "itkObject.h"
+
+#include "MappedImageFileReader.h"
+
+#include <string>
+
+template <class TFixedImage, class TMovingImage>
+class ImagePairSlabReader: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef ImagePairSlabReader                                Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  typedef TFixedImage FixedImageType;
+  typedef TMovingImage MovingImageType;
+
+  typedef typename FixedImageType::RegionType FixedRegionType;
+  typedef typename MovingImageType::RegionType MovingRegionType;
+
+  typedef itk::ImageFileReader<FixedImageType> FixedReaderType;
+  typedef itk::ImageFileReader<MovingImageType> MovingReaderType;
+
+  typedef MappedImageFileReader<FixedImageType> FixedMappedReaderType;
+  typedef MappedImageFileReader<MovingImageType> MovingMappedReaderType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ImagePairSlabReader, itk::Object);
+
+  void SetFixedFileName(const std::string& fn) { m_FixedFileName = fn; }
+  void SetMovingFileName(const std::string& fn) { m_MovingFileName = fn; }
+
+  /** Bytes of pixel data for one slab of both images, 0 for no limit. */
+  itkSetMacro(MemoryLimit, itk::SizeValueType);
+  itkGetConstMacro(MemoryLimit, itk::SizeValueType);
+
+  /** Try memory mapping both files first, on by default. */
+  itkSetMacro(UseMemoryMapping, bool);
+  itkGetConstMacro(UseMemoryMapping, bool);
+  itkBooleanMacro(UseMemoryMapping);
+
+  /** Whether Initialize mapped both files. */
+  itkGetConstMacro(Mapped, bool);
+
+  /** Reads the image headers and plans the slabs. */
+  void Initialize();
+
+  unsigned int GetNumberOfSlabs() const { return m_NumberOfSlabs; }
+
+  /** Reads slab i of both images. */
+  void ReadSlab(unsigned int i);
+
+  FixedImageType* GetFixedImage() { return m_FixedImage; }
+  MovingImageType* GetMovingImage() { return m_MovingImage; }
+
+protected:
+
+  ImagePairSlabReader();
+  ~ImagePairSlabReader();
+
+  std::string m_FixedFileName;
+  std::string m_MovingFileName;
+
+  itk::SizeValueType m_MemoryLimit;
+
+  bool m_UseMemoryMapping;
+  bool m_Mapped;
+
+  typename FixedReaderType::Pointer m_FixedReader;
+  typename MovingReaderType::Pointer m_MovingReader;
+
+  typename FixedImageType::Pointer m_FixedImage;
+  typename MovingImageType::Pointer m_MovingImage;
+
+  unsigned int m_NumberOfSlabs;
+  itk::SizeValueType m_SlicesPerSlab;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "ImagePairSlabReader.txx"
+#endif
+
+#endif
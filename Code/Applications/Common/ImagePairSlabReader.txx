@@ -0,0 +1,161 @@
+
+#ifndef _ImagePairSlabReader_txx
+#define _ImagePairSlabReader_txx
+
+#include "ImagePairSlabReader.h"
+
+template <class TFixedImage, class TMovingImage>
+ImagePairSlabReader<TFixedImage, TMovingImage>
+::ImagePairSlabReader()
+{
+  m_MemoryLimit = 0;
+  m_UseMemoryMapping = true;
+  m_Mapped = false;
+  m_NumberOfSlabs = 0;
+  m_SlicesPerSlab = 0;
+}
+
+template <class TFixedImage, class TMovingImage>
+ImagePairSlabReader<TFixedImage, TMovingImage>
+::~ImagePairSlabReader()
+{
+
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairSlabReader<TFixedImage, TMovingImage>
+::Initialize()
+{
+  m_Mapped = false;
+  m_FixedReader = 0;
+  m_MovingReader = 0;
+
+  if (m_UseMemoryMapping)
+  {
+    typename FixedMappedReaderType::Pointer fixedMapped =
+      FixedMappedReaderType::New();
+    fixedMapped->SetFileName(m_FixedFileName);
+
+    typename MovingMappedReaderType::Pointer movingMapped =
+      MovingMappedReaderType::New();
+    movingMapped->SetFileName(m_MovingFileName);
+
+    if (fixedMapped->Map() && movingMapped->Map())
+    {
+      m_FixedImage = fixedMapped->GetOutput();
+      m_MovingImage = movingMapped->GetOutput();
+      m_Mapped = true;
+      m_NumberOfSlabs = 1;
+      m_SlicesPerSlab = m_FixedImage->GetLargestPossibleRegion().GetSize()[
+        FixedImageType::ImageDimension - 1];
+      return;
+    }
+  }
+
+  m_FixedReader = FixedReaderType::New();
+  m_FixedReader->SetFileName(m_FixedFileName);
+  m_FixedReader->UpdateOutputInformation();
+
+  m_MovingReader = MovingReaderType::New();
+  m_MovingReader->SetFileName(m_MovingFileName);
+  m_MovingReader->UpdateOutputInformation();
+
+  m_FixedImage = m_FixedReader->GetOutput();
+  m_MovingImage = m_MovingReader->GetOutput();
+
+  const unsigned int lastDim = FixedImageType::ImageDimension - 1;
+
+  FixedRegionType fixedRegion =
+    m_FixedReader->GetOutput()->GetLargestPossibleRegion();
+  MovingRegionType movingRegion =
+    m_MovingReader->GetOutput()->GetLargestPossibleRegion();
+
+  itk::SizeValueType numSlices = fixedRegion.GetSize()[lastDim];
+
+  m_NumberOfSlabs = 1;
+  m_SlicesPerSlab = numSlices;
+
+  bool canStream =
+    m_FixedReader->GetImageIO()->CanStreamRead() &&
+    m_MovingReader->GetImageIO()->CanStreamRead();
+
+  if (m_MemoryLimit == 0 || !canStream ||
+      fixedRegion.GetSize() != movingRegion.GetSize() || numSlices == 0)
+    return;
+
+  itk::SizeValueType sliceVoxels = fixedRegion.GetNumberOfPixels() / numSlices;
+
+  itk::SizeValueType bytesPerVoxel =
+    m_FixedReader->GetImageIO()->GetComponentSize() *
+      m_FixedReader->GetImageIO()->GetNumberOfComponents() +
+    m_MovingReader->GetImageIO()->GetComponentSize() *
+      m_MovingReader->GetImageIO()->GetNumberOfComponents();
+
+  // The reader converts to the output pixel type, count whichever is larger
+  itk::SizeValueType outputBytes =
+    sizeof(typename FixedImageType::PixelType) +
+    sizeof(typename MovingImageType::PixelType);
+  if (outputBytes > bytesPerVoxel)
+    bytesPerVoxel = outputBytes;
+
+  // At least one slice per slab, whatever the limit
+  m_SlicesPerSlab = m_MemoryLimit / (sliceVoxels * bytesPerVoxel);
+  if (m_SlicesPerSlab < 1)
+    m_SlicesPerSlab = 1;
+  if (m_SlicesPerSlab > numSlices)
+    m_SlicesPerSlab = numSlices;
+
+  m_NumberOfSlabs = (numSlices + m_SlicesPerSlab - 1) / m_SlicesPerSlab;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+ImagePairSlabReader<TFixedImage, TMovingImage>
+::ReadSlab(unsigned int i)
+{
+  if (m_FixedImage.IsNull() || m_MovingImage.IsNull())
+    itkExceptionMacro(<< "Slab reader not initialized");
+
+  if (i >= m_NumberOfSlabs)
+    itkExceptionMacro(<< "Slab " << i << " out of range");
+
+  FixedImageType* fixedImg = m_FixedImage;
+  MovingImageType* movingImg = m_MovingImage;
+
+  // Mapped images are already whole
+  if (m_Mapped)
+    return;
+
+  FixedRegionType fixedSlab = fixedImg->GetLargestPossibleRegion();
+  MovingRegionType movingSlab = movingImg->GetLargestPossibleRegion();
+
+  if (m_NumberOfSlabs > 1)
+  {
+    const unsigned int lastDim = FixedImageType::ImageDimension - 1;
+
+    itk::SizeValueType first = i * m_SlicesPerSlab;
+    itk::SizeValueType count = fixedSlab.GetSize()[lastDim] - first;
+    if (count > m_SlicesPerSlab)
+      count = m_SlicesPerSlab;
+
+    fixedSlab.SetIndex(lastDim, fixedSlab.GetIndex()[lastDim] + first);
+    fixedSlab.SetSize(lastDim, count);
+
+    movingSlab.SetIndex(lastDim, movingSlab.GetIndex()[lastDim] + first);
+    movingSlab.SetSize(lastDim, count);
+  }
+
+  fixedImg->SetRequestedRegion(fixedSlab);
+  movingImg->SetRequestedRegion(movingSlab);
+
+  fixedImg->Update();
+  movingImg->Update();
+
+  // The reader may have loaded more than the slab, restrict to it so that
+  // no voxel is counted twice
+  fixedImg->SetRequestedRegion(fixedSlab);
+  movingImg->SetRequestedRegion(movingSlab);
+}
+
+#endif
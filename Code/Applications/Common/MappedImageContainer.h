@@ -0,0 +1,59 @@
+// Pixel container for an image whose buffer is a memory mapped file
+//
+// The container holds the MappedImageFile, so the mapping lasts as long as
+// any image uses the buffer. The buffer is read only: writing to a pixel of
+// such an image faults.
+
+#ifndef _MappedImageContainer_h
+#define _MappedImageContainer_h
+
+#include "itkImportImageContainer.h"
+
+#include "MappedImageFile.h"
+
+template <class TElement>
+class MappedImageContainer:
+  public itk::ImportImageContainer<itk::SizeValueType, TElement>
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef MappedImageContainer                               Self;
+  typedef itk::ImportImageContainer<itk::SizeValueType, TElement>
+                                                             Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MappedImageContainer, itk::ImportImageContainer);
+
+  /** Points the container at the data of an open file. */
+  void SetMappedFile(MappedImageFile* file)
+  {
+    m_MappedFile = file;
+    this->SetImportPointer(
+      const_cast<TElement*>(static_cast<const TElement*>(file->GetData())),
+      file->GetNumberOfPixels(), false);
+  }
+
+  const MappedImageFile* GetMappedFile() const { return m_MappedFile; }
+
+protected:
+
+  MappedImageContainer() { }
+  ~MappedImageContainer() { }
+
+  MappedImageFile::Pointer m_MappedFile;
+
+private:
+
+  MappedImageContainer(const Self&);  // Not implemented
+  void operator=(const Self&);        // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,732 @@
+
+#include "MappedImageFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+std::string
+Trim(const std::string& s)
+{
+  std::string::size_type first = s.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos)
+    return std::string();
+  std::string::size_type last = s.find_last_not_of(" \t\r\n");
+  return s.substr(first, last - first + 1);
+}
+
+std::string
+ToLower(const std::string& s)
+{
+  std::string t = s;
+  for (unsigned int i = 0; i < t.size(); i++)
+    t[i] = (char)std::tolower((unsigned char)t[i]);
+  return t;
+}
+
+std::vector<std::string>
+SplitWords(const std::string& s)
+{
+  std::vector<std::string> words;
+  std::istringstream iss(s);
+  std::string w;
+  while (iss >> w)
+    words.push_back(w);
+  return words;
+}
+
+template <class T>
+bool
+ParseValues(const std::string& s, std::vector<T>& values)
+{
+  values.clear();
+  std::istringstream iss(s);
+  T v;
+  while (iss >> v)
+    values.push_back(v);
+  return iss.eof() && values.size() > 0;
+}
+
+// Parses NRRD vectors like "(1,0,0) (0,1,0) (0,0,1)"
+bool
+ParseNrrdVectors(const std::string& s, std::vector< std::vector<double> >& vectors)
+{
+  vectors.clear();
+
+  std::string::size_type pos = 0;
+  while (true)
+  {
+    std::string::size_type open = s.find('(', pos);
+    if (open == std::string::npos)
+      break;
+    std::string::size_type close = s.find(')', open);
+    if (close == std::string::npos)
+      return false;
+
+    std::string inner = s.substr(open + 1, close - open - 1);
+    std::replace(inner.begin(), inner.end(), ',', ' ');
+
+    std::vector<double> v;
+    if (!ParseValues(inner, v))
+      return false;
+    vectors.push_back(v);
+
+    pos = close + 1;
+  }
+
+  // Anything left, such as "none" for a non-spatial axis, is not handled
+  return Trim(s.substr(pos)).empty() && vectors.size() > 0;
+}
+
+std::string
+GetDataFilePath(const std::string& headerFileName, const std::string& dataFileName)
+{
+  if (dataFileName.empty())
+    return dataFileName;
+
+  bool isAbsolute = (dataFileName[0] == '/' || dataFileName[0] == '\\' ||
+    (dataFileName.size() > 1 && dataFileName[1] == ':'));
+  if (isAbsolute)
+    return dataFileName;
+
+  std::string::size_type slash = headerFileName.find_last_of("/\\");
+  if (slash == std::string::npos)
+    return dataFileName;
+
+  return headerFileName.substr(0, slash + 1) + dataFileName;
+}
+
+bool
+HostIsBigEndian()
+{
+  unsigned short one = 1;
+  return *reinterpret_cast<unsigned char*>(&one) == 0;
+}
+
+}
+
+MappedImageFile
+::MappedImageFile()
+{
+  m_ComponentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+
+  m_View = 0;
+  m_ViewLength = 0;
+#ifdef _WIN32
+  m_FileHandle = 0;
+  m_MappingHandle = 0;
+#endif
+
+  m_Data = 0;
+}
+
+MappedImageFile
+::~MappedImageFile()
+{
+  this->Close();
+}
+
+unsigned int
+MappedImageFile
+::GetComponentSize(ComponentType type)
+{
+  switch (type)
+  {
+    case itk::ImageIOBase::UCHAR:
+    case itk::ImageIOBase::CHAR:
+      return 1;
+    case itk::ImageIOBase::USHORT:
+    case itk::ImageIOBase::SHORT:
+      return 2;
+    case itk::ImageIOBase::UINT:
+    case itk::ImageIOBase::INT:
+    case itk::ImageIOBase::FLOAT:
+      return 4;
+    case itk::ImageIOBase::DOUBLE:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+itk::SizeValueType
+MappedImageFile
+::GetNumberOfPixels() const
+{
+  itk::SizeValueType n = 1;
+  for (unsigned int dim = 0; dim < m_Size.size(); dim++)
+    n *= m_Size[dim];
+  return n;
+}
+
+bool
+MappedImageFile
+::Open(const std::string& fileName)
+{
+  this->Close();
+
+  HeaderType header;
+  header.Component = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  header.BigEndian = false;
+  header.DataOffset = 0;
+
+  std::string ext;
+  std::string::size_type dot = fileName.find_last_of('.');
+  if (dot != std::string::npos)
+    ext = ToLower(fileName.substr(dot));
+
+  bool parsed = false;
+  if (ext == ".mha" || ext == ".mhd")
+    parsed = this->ReadMetaImageHeader(fileName, header);
+  else if (ext == ".nrrd" || ext == ".nhdr")
+    parsed = this->ReadNrrdHeader(fileName, header);
+
+  if (!parsed)
+    return false;
+
+  unsigned int numDims = header.Size.size();
+  if (numDims == 0 || header.Spacing.size() != numDims ||
+      header.Origin.size() != numDims ||
+      header.Direction.size() != numDims * numDims)
+    return false;
+
+  unsigned int componentSize = GetComponentSize(header.Component);
+  if (componentSize == 0)
+    return false;
+
+  if (componentSize > 1 && header.BigEndian != HostIsBigEndian())
+    return false;
+
+  itk::SizeValueType numPixels = 1;
+  for (unsigned int dim = 0; dim < numDims; dim++)
+    numPixels *= header.Size[dim];
+
+  itk::OffsetValueType offset = header.DataOffset;
+
+  if (!this->MapData(header.DataFileName, offset, numPixels * componentSize))
+    return false;
+
+  // The view starts at a page boundary, the data must still be aligned to
+  // its element size
+  if (((const char*)m_Data - (const char*)m_View) % componentSize != 0)
+  {
+    this->Close();
+    return false;
+  }
+
+  m_Size = header.Size;
+  m_Spacing = header.Spacing;
+  m_Origin = header.Origin;
+  m_Direction = header.Direction;
+  m_ComponentType = header.Component;
+
+  return true;
+}
+
+void
+MappedImageFile
+::Close()
+{
+#ifdef _WIN32
+  if (m_View != 0)
+    UnmapViewOfFile(m_View);
+  if (m_MappingHandle != 0)
+    CloseHandle((HANDLE)m_MappingHandle);
+  if (m_FileHandle != 0)
+    CloseHandle((HANDLE)m_FileHandle);
+  m_MappingHandle = 0;
+  m_FileHandle = 0;
+#else
+  if (m_View != 0)
+    munmap(m_View, m_ViewLength);
+#endif
+
+  m_View = 0;
+  m_ViewLength = 0;
+  m_Data = 0;
+
+  m_Size.clear();
+  m_Spacing.clear();
+  m_Origin.clear();
+  m_Direction.clear();
+  m_ComponentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+}
+
+bool
+MappedImageFile
+::ReadMetaImageHeader(const std::string& fileName, HeaderType& header)
+{
+  std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open())
+    return false;
+
+  unsigned int numDims = 0;
+  std::vector<double> elementSize;
+  std::vector<double> transform;
+  long headerSize = 0;
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    line = Trim(line);
+    if (line.empty())
+      continue;
+
+    std::string::size_type eq = line.find('=');
+    if (eq == std::string::npos)
+      return false;
+
+    std::string key = Trim(line.substr(0, eq));
+    std::string value = Trim(line.substr(eq + 1));
+    std::string lvalue = ToLower(value);
+
+    if (key == "ObjectType")
+    {
+      if (value != "Image")
+        return false;
+    }
+    else if (key == "NDims")
+    {
+      numDims = std::atoi(value.c_str());
+    }
+    else if (key == "DimSize")
+    {
+      if (!ParseValues(value, header.Size))
+        return false;
+    }
+    else if (key == "ElementSpacing")
+    {
+      if (!ParseValues(value, header.Spacing))
+        return false;
+    }
+    else if (key == "ElementSize")
+    {
+      if (!ParseValues(value, elementSize))
+        return false;
+    }
+    else if (key == "Offset" || key == "Position" || key == "Origin")
+    {
+      if (!ParseValues(value, header.Origin))
+        return false;
+    }
+    else if (key == "TransformMatrix" || key == "Rotation" || key == "Orientation")
+    {
+      if (!ParseValues(value, transform))
+        return false;
+    }
+    else if (key == "ElementType")
+    {
+      if (value == "MET_UCHAR")
+        header.Component = itk::ImageIOBase::UCHAR;
+      else if (value == "MET_CHAR")
+        header.Component = itk::ImageIOBase::CHAR;
+      else if (value == "MET_USHORT")
+        header.Component = itk::ImageIOBase::USHORT;
+      else if (value == "MET_SHORT")
+        header.Component = itk::ImageIOBase::SHORT;
+      else if (value == "MET_UINT")
+        header.Component = itk::ImageIOBase::UINT;
+      else if (value == "MET_INT")
+        header.Component = itk::ImageIOBase::INT;
+      else if (value == "MET_FLOAT")
+        header.Component = itk::ImageIOBase::FLOAT;
+      else if (value == "MET_DOUBLE")
+        header.Component = itk::ImageIOBase::DOUBLE;
+      else
+        return false;
+    }
+    else if (key == "ElementNumberOfChannels")
+    {
+      if (std::atoi(value.c_str()) != 1)
+        return false;
+    }
+    else if (key == "CompressedData")
+    {
+      if (lvalue == "true")
+        return false;
+    }
+    else if (key == "BinaryData")
+    {
+      if (lvalue == "false")
+        return false;
+    }
+    else if (key == "BinaryDataByteOrderMSB" || key == "ElementByteOrderMSB")
+    {
+      header.BigEndian = (lvalue == "true");
+    }
+    else if (key == "HeaderSize")
+    {
+      headerSize = std::atol(value.c_str());
+    }
+    else if (key == "ElementDataFile")
+    {
+      // Always the last field, local data starts on the next line
+      if (value == "LOCAL")
+      {
+        if (headerSize > 0)
+          return false;
+        header.DataFileName = fileName;
+        header.DataOffset = (headerSize == -1) ? -1 : (itk::OffsetValueType)in.tellg();
+      }
+      else
+      {
+        if (SplitWords(value).size() != 1 || value.find('%') != std::string::npos ||
+            value == "LIST")
+          return false;
+        header.DataFileName = GetDataFilePath(fileName, value);
+        header.DataOffset = headerSize;
+      }
+      break;
+    }
+  }
+
+  if (header.DataFileName.empty() || numDims == 0 || header.Size.size() != numDims)
+    return false;
+
+  if (header.Spacing.empty())
+  {
+    if (elementSize.size() == numDims)
+      header.Spacing = elementSize;
+    else
+      header.Spacing.assign(numDims, 1.0);
+  }
+
+  if (header.Origin.empty())
+    header.Origin.assign(numDims, 0.0);
+
+  // Row i of the transform matrix is the direction of axis i
+  header.Direction.assign(numDims * numDims, 0.0);
+  if (transform.empty())
+  {
+    for (unsigned int i = 0; i < numDims; i++)
+      header.Direction[i*numDims + i] = 1.0;
+  }
+  else
+  {
+    if (transform.size() != numDims * numDims)
+      return false;
+    for (unsigned int i = 0; i < numDims; i++)
+      for (unsigned int j = 0; j < numDims; j++)
+        header.Direction[j*numDims + i] = transform[i*numDims + j];
+  }
+
+  return true;
+}
+
+bool
+MappedImageFile
+::ReadNrrdHeader(const std::string& fileName, HeaderType& header)
+{
+  std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open())
+    return false;
+
+  std::string line;
+  if (!std::getline(in, line) || line.compare(0, 7, "NRRD000") != 0)
+    return false;
+
+  unsigned int numDims = 0;
+  bool flipRAS = false;
+  bool hasEndian = false;
+  std::vector< std::vector<double> > directions;
+  std::vector< std::vector<double> > origins;
+  std::vector<double> spacings;
+  std::string dataFile;
+  long byteSkip = 0;
+  bool attached = true;
+
+  while (true)
+  {
+    if (!std::getline(in, line))
+    {
+      // Detached headers may end without a blank line
+      if (attached)
+        return false;
+      break;
+    }
+
+    line = Trim(line);
+    if (line.empty())
+      break;
+    if (line[0] == '#')
+      continue;
+    if (line.find(":=") != std::string::npos)
+      continue;
+
+    std::string::size_type colon = line.find(": ");
+    if (colon == std::string::npos)
+      return false;
+
+    std::string key = ToLower(Trim(line.substr(0, colon)));
+    std::string value = Trim(line.substr(colon + 2));
+    std::string lvalue = ToLower(value);
+
+    if (key == "type")
+    {
+      if (lvalue == "uchar" || lvalue == "unsigned char" || lvalue == "uint8" ||
+          lvalue == "uint8_t")
+        header.Component = itk::ImageIOBase::UCHAR;
+      else if (lvalue == "signed char" || lvalue == "int8" || lvalue == "int8_t")
+        header.Component = itk::ImageIOBase::CHAR;
+      else if (lvalue == "ushort" || lvalue == "unsigned short" ||
+          lvalue == "unsigned short int" || lvalue == "uint16" ||
+          lvalue == "uint16_t")
+        header.Component = itk::ImageIOBase::USHORT;
+      else if (lvalue == "short" || lvalue == "short int" ||
+          lvalue == "signed short" || lvalue == "signed short int" ||
+          lvalue == "int16" || lvalue == "int16_t")
+        header.Component = itk::ImageIOBase::SHORT;
+      else if (lvalue == "uint" || lvalue == "unsigned int" ||
+          lvalue == "uint32" || lvalue == "uint32_t")
+        header.Component = itk::ImageIOBase::UINT;
+      else if (lvalue == "int" || lvalue == "signed int" ||
+          lvalue == "int32" || lvalue == "int32_t")
+        header.Component = itk::ImageIOBase::INT;
+      else if (lvalue == "float")
+        header.Component = itk::ImageIOBase::FLOAT;
+      else if (lvalue == "double")
+        header.Component = itk::ImageIOBase::DOUBLE;
+      else
+        return false;
+    }
+    else if (key == "dimension")
+    {
+      numDims = std::atoi(value.c_str());
+    }
+    else if (key == "sizes")
+    {
+      if (!ParseValues(value, header.Size))
+        return false;
+    }
+    else if (key == "encoding")
+    {
+      if (lvalue != "raw")
+        return false;
+    }
+    else if (key == "endian")
+    {
+      hasEndian = true;
+      header.BigEndian = (lvalue == "big");
+    }
+    else if (key == "space")
+    {
+      if (lvalue == "right-anterior-superior" || lvalue == "ras")
+        flipRAS = true;
+      else if (lvalue != "left-posterior-superior" && lvalue != "lps")
+        return false;
+    }
+    else if (key == "space directions")
+    {
+      if (!ParseNrrdVectors(value, directions))
+        return false;
+    }
+    else if (key == "space origin")
+    {
+      if (!ParseNrrdVectors(value, origins) || origins.size() != 1)
+        return false;
+    }
+    else if (key == "spacings")
+    {
+      if (!ParseValues(value, spacings))
+        return false;
+    }
+    else if (key == "data file" || key == "datafile")
+    {
+      if (SplitWords(value).size() != 1 || value.find('%') != std::string::npos ||
+          value == "LIST")
+        return false;
+      dataFile = GetDataFilePath(fileName, value);
+      attached = false;
+    }
+    else if (key == "byte skip" || key == "byteskip")
+    {
+      byteSkip = std::atol(value.c_str());
+    }
+    else if (key == "line skip" || key == "lineskip")
+    {
+      if (std::atol(value.c_str()) != 0)
+        return false;
+    }
+  }
+
+  if (numDims == 0 || header.Size.size() != numDims)
+    return false;
+
+  if (!hasEndian && header.Component != itk::ImageIOBase::UCHAR &&
+      header.Component != itk::ImageIOBase::CHAR)
+    return false;
+
+  if (attached)
+  {
+    if (byteSkip != 0)
+      return false;
+    header.DataFileName = fileName;
+    header.DataOffset = (itk::OffsetValueType)in.tellg();
+  }
+  else
+  {
+    if (byteSkip < -1)
+      return false;
+    header.DataFileName = dataFile;
+    header.DataOffset = byteSkip;
+  }
+
+  // Spacing is the length of each axis direction
+  header.Spacing.assign(numDims, 1.0);
+  header.Origin.assign(numDims, 0.0);
+  header.Direction.assign(numDims * numDims, 0.0);
+  for (unsigned int i = 0; i < numDims; i++)
+    header.Direction[i*numDims + i] = 1.0;
+
+  if (directions.size() > 0)
+  {
+    if (directions.size() != numDims)
+      return false;
+
+    for (unsigned int i = 0; i < numDims; i++)
+    {
+      if (directions[i].size() != numDims)
+        return false;
+
+      double norm = 0;
+      for (unsigned int j = 0; j < numDims; j++)
+        norm += directions[i][j] * directions[i][j];
+      norm = std::sqrt(norm);
+      if (norm == 0)
+        return false;
+
+      header.Spacing[i] = norm;
+      for (unsigned int j = 0; j < numDims; j++)
+      {
+        double d = directions[i][j] / norm;
+        if (flipRAS && j < 2)
+          d = -d;
+        header.Direction[j*numDims + i] = d;
+      }
+    }
+  }
+  else if (spacings.size() == numDims)
+  {
+    header.Spacing = spacings;
+  }
+
+  if (origins.size() == 1)
+  {
+    if (origins[0].size() != numDims)
+      return false;
+    for (unsigned int j = 0; j < numDims; j++)
+      header.Origin[j] = (flipRAS && j < 2) ? -origins[0][j] : origins[0][j];
+  }
+
+  return true;
+}
+
+bool
+MappedImageFile
+::MapData(const std::string& fileName, itk::OffsetValueType offset,
+  itk::SizeValueType length)
+{
+  if (length == 0)
+    return false;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize))
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  if (offset == -1)
+    offset = (itk::OffsetValueType)fileSize.QuadPart - (itk::OffsetValueType)length;
+  if (offset < 0 || offset + (LONGLONG)length > fileSize.QuadPart)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+  if (mapping == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  itk::OffsetValueType start = offset - offset % info.dwAllocationGranularity;
+
+  itk::SizeValueType viewLength = (offset - start) + length;
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ,
+    (DWORD)((unsigned long long)start >> 32), (DWORD)(start & 0xffffffff),
+    viewLength);
+  if (view == 0)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  m_FileHandle = file;
+  m_MappingHandle = mapping;
+#else
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  itk::OffsetValueType fileSize = st.st_size;
+
+  if (offset == -1)
+    offset = fileSize - (itk::OffsetValueType)length;
+  if (offset < 0 || offset + (itk::OffsetValueType)length > fileSize)
+  {
+    close(fd);
+    return false;
+  }
+
+  itk::OffsetValueType pageSize = sysconf(_SC_PAGESIZE);
+  itk::OffsetValueType start = offset - offset % pageSize;
+
+  itk::SizeValueType viewLength = (offset - start) + length;
+  void* view = mmap(0, viewLength, PROT_READ, MAP_SHARED, fd, start);
+
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+
+  if (view == MAP_FAILED)
+    return false;
+#endif
+
+  m_View = view;
+  m_ViewLength = viewLength;
+  m_Data = (const char*)view + (offset - start);
+
+  return true;
+}
@@ -0,0 +1,120 @@
+// Read-only memory mapping of the voxel data in an uncompressed MetaImage
+// (.mha/.mhd) or NRRD (.nrrd/.nhdr) file
+//
+// Open parses the header and maps the bytes of the voxel data straight from
+// the file, so the data is served from the OS page cache and shared by every
+// process that maps the same file. Nothing is copied or converted: files
+// that are compressed, split into several data files, stored in the other
+// byte order, have multiple components or data not aligned to its element
+// size are not opened, and the caller should read them the usual way.
+//
+// The mapping lasts as long as this object.
+
+#ifndef _MappedImageFile_h
+#define _MappedImageFile_h
+
+#include "itkImageIOBase.h"
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+
+#include <string>
+#include <vector>
+
+class MappedImageFile: public itk::LightObject
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef MappedImageFile                                    Self;
+  typedef itk::LightObject                                   Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MappedImageFile, itk::LightObject);
+
+  typedef itk::ImageIOBase::IOComponentType ComponentType;
+
+  /**
+   * Parses the header and maps the voxel data. Returns false, leaving
+   * nothing mapped, if the file cannot be mapped as is.
+   */
+  bool Open(const std::string& fileName);
+
+  void Close();
+
+  bool IsOpen() const { return m_Data != 0; }
+
+  unsigned int GetNumberOfDimensions() const { return m_Size.size(); }
+
+  const std::vector<itk::SizeValueType>& GetSize() const { return m_Size; }
+  const std::vector<double>& GetSpacing() const { return m_Spacing; }
+  const std::vector<double>& GetOrigin() const { return m_Origin; }
+
+  /** Direction cosines, row i column j at i*N+j, columns are the axes. */
+  const std::vector<double>& GetDirection() const { return m_Direction; }
+
+  ComponentType GetComponentType() const { return m_ComponentType; }
+
+  /** Start of the voxel data, read only. */
+  const void* GetData() const { return m_Data; }
+
+  itk::SizeValueType GetNumberOfPixels() const;
+
+protected:
+
+  MappedImageFile();
+  ~MappedImageFile();
+
+  // Header fields and where the data lies, filled by the parsers
+  struct HeaderType
+  {
+    std::vector<itk::SizeValueType> Size;
+    std::vector<double> Spacing;
+    std::vector<double> Origin;
+    std::vector<double> Direction;
+    ComponentType Component;
+    bool BigEndian;
+    std::string DataFileName;
+    itk::OffsetValueType DataOffset;
+  };
+
+  // Returns false for files that cannot be mapped, DataOffset of -1 means
+  // the data ends the file
+  bool ReadMetaImageHeader(const std::string& fileName, HeaderType& header);
+  bool ReadNrrdHeader(const std::string& fileName, HeaderType& header);
+
+  bool MapData(const std::string& fileName, itk::OffsetValueType offset,
+    itk::SizeValueType length);
+
+  static unsigned int GetComponentSize(ComponentType type);
+
+  std::vector<itk::SizeValueType> m_Size;
+  std::vector<double> m_Spacing;
+  std::vector<double> m_Origin;
+  std::vector<double> m_Direction;
+
+  ComponentType m_ComponentType;
+
+  // Mapped view, which starts at a page boundary before the data
+  void* m_View;
+  itk::SizeValueType m_ViewLength;
+#ifdef _WIN32
+  void* m_FileHandle;
+  void* m_MappingHandle;
+#endif
+
+  const void* m_Data;
+
+private:
+
+  MappedImageFile(const Self&);  // Not implemented
+  void operator=(const Self&);   // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,85 @@
+// Reads an image by memory mapping its file when the file holds the pixel
+// type as is, and through ImageFileReader otherwise
+//
+// Mapping applies to uncompressed MetaImage and NRRD files with a single
+// component of exactly the output pixel type in the native byte order (see
+// MappedImageFile). The output then shares the OS page cache instead of
+// holding a private copy, and costs no read time until its voxels are
+// touched. Such an output is read only and must not be modified.
+
+#ifndef _MappedImageFileReader_h
+#define _MappedImageFileReader_h
+
+#include "itkImageFileReader.h"
+#include "itkObject.h"
+
+#include "MappedImageContainer.h"
+#include "MappedImageFile.h"
+
+#include <string>
+
+template <class TImage>
+class MappedImageFileReader: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef MappedImageFileReader                              Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MappedImageFileReader, itk::Object);
+
+  typedef TImage ImageType;
+  typedef typename ImageType::Pointer ImagePointer;
+  typedef typename ImageType::PixelType PixelType;
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  typedef MappedImageContainer<PixelType> ContainerType;
+
+  void SetFileName(const std::string& fn) { m_FileName = fn; }
+  const std::string& GetFileName() const { return m_FileName; }
+
+  /** Try mapping the file before reading it, on by default. */
+  itkSetMacro(UseMemoryMapping, bool);
+  itkGetConstMacro(UseMemoryMapping, bool);
+  itkBooleanMacro(UseMemoryMapping);
+
+  void Update();
+
+  /**
+   * Maps the file without falling back to reading it. Returns false, with
+   * no output, if the file does not hold this image type as is.
+   */
+  bool Map();
+
+  ImageType* GetOutput() { return m_Output; }
+
+  /** Whether the last Update mapped the file. */
+  itkGetConstMacro(Mapped, bool);
+
+protected:
+
+  MappedImageFileReader();
+  ~MappedImageFileReader();
+
+  std::string m_FileName;
+
+  bool m_UseMemoryMapping;
+  bool m_Mapped;
+
+  ImagePointer m_Output;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "MappedImageFileReader.txx"
+#endif
+
+#endif
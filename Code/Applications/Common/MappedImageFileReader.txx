@@ -0,0 +1,92 @@
+
+#ifndef _MappedImageFileReader_txx
+#define _MappedImageFileReader_txx
+
+#include "MappedImageFileReader.h"
+
+#include "itkImageIOBase.h"
+
+template <class TImage>
+MappedImageFileReader<TImage>
+::MappedImageFileReader()
+{
+  m_UseMemoryMapping = true;
+  m_Mapped = false;
+}
+
+template <class TImage>
+MappedImageFileReader<TImage>
+::~MappedImageFileReader()
+{
+
+}
+
+template <class TImage>
+void
+MappedImageFileReader<TImage>
+::Update()
+{
+  if (m_UseMemoryMapping && this->Map())
+    return;
+
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(m_FileName);
+  reader->Update();
+
+  m_Output = reader->GetOutput();
+}
+
+template <class TImage>
+bool
+MappedImageFileReader<TImage>
+::Map()
+{
+  const unsigned int dim = ImageType::ImageDimension;
+
+  m_Mapped = false;
+  m_Output = 0;
+
+  MappedImageFile::Pointer file = MappedImageFile::New();
+  if (!file->Open(m_FileName))
+    return false;
+
+  if (file->GetNumberOfDimensions() != dim)
+    return false;
+
+  if (file->GetComponentType() !=
+      itk::ImageIOBase::MapPixelType<PixelType>::CType)
+    return false;
+
+  typename ImageType::SizeType size;
+  typename ImageType::SpacingType spacing;
+  typename ImageType::PointType origin;
+  typename ImageType::DirectionType direction;
+
+  for (unsigned int i = 0; i < dim; i++)
+  {
+    size[i] = file->GetSize()[i];
+    spacing[i] = file->GetSpacing()[i];
+    origin[i] = file->GetOrigin()[i];
+    for (unsigned int j = 0; j < dim; j++)
+      direction(i, j) = file->GetDirection()[i*dim + j];
+  }
+
+  typename ImageType::RegionType region;
+  region.SetSize(size);
+
+  typename ContainerType::Pointer container = ContainerType::New();
+  container->SetMappedFile(file);
+
+  m_Output = ImageType::New();
+  m_Output->SetRegions(region);
+  m_Output->SetSpacing(spacing);
+  m_Output->SetOrigin(origin);
+  m_Output->SetDirection(direction);
+  m_Output->SetPixelContainer(container);
+
+  m_Mapped = true;
+
+  return true;
+}
+
+#endif
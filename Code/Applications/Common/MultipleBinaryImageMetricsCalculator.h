@@ -2,6 +2,7 @@
 #ifndef _MultipleBinaryImageMetricsCalculator_h
 #define _MultipleBinaryImageMetricsCalculator_h
 
+#include "itkMultiThreader.h"
 #include "itkObject.h"
 
 #include <vector>
@@ -34,12 +35,31 @@ public:
   void SetFixedImage(FixedImageType* img);
   void SetMovingImage(MovingImageType* img);
 
+  /** Number of threads passed on to the thresholding filters and metrics. */
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  typedef typename MetricType::SurfaceDistanceCacheType SurfaceDistanceCacheType;
+
+  /**
+   * With a cache, the metric is given the label images, each label and the
+   * cache instead of thresholded masks, and the labels come from the cache
+   * inventories. Entries already in the cache, such as ground truth loaded
+   * by a GroundTruthCache, are used as they are. Each label is released
+   * from the cache once scored.
+   */
+  void SetSurfaceDistanceCache(SurfaceDistanceCacheType* cache)
+  { m_SurfaceDistanceCache = cache; }
+
   void Update();
 
   unsigned int GetNumberOfValues() const;
 
   double GetValue(unsigned int i);
 
+  /** Label of the i-th value, only positive labels present in an image get one. */
+  unsigned int GetLabel(unsigned int i) const;
+
 protected:
 
   MultipleBinaryImageMetricsCalculator();
@@ -48,8 +68,13 @@ protected:
   FixedImagePointer m_FixedImage;
   MovingImagePointer m_MovingImage;
 
+  itk::ThreadIdType m_NumberOfThreads;
+
+  typename SurfaceDistanceCacheType::Pointer m_SurfaceDistanceCache;
+
+  std::vector<unsigned int> m_Labels;
   std::vector<double> m_MetricValues;
-  
+
 
 };
 
@@ -4,16 +4,19 @@
 
 #include "MultipleBinaryImageMetricsCalculator.h"
 
+#include "LabelImageInventory.h"
+
 #include "itkBinaryThresholdImageFilter.h"
-#include "itkMinimumMaximumImageCalculator.h"
 
 #include "itkImageRegionIterator.h"
 
+#include <algorithm>
+
 template <class TFixedImage, class TMovingImage, class TMetric>
 MultipleBinaryImageMetricsCalculator<TFixedImage, TMovingImage, TMetric>
 ::MultipleBinaryImageMetricsCalculator()
 {
-
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
 }
 
 template <class TFixedImage, class TMovingImage, class TMetric>
@@ -55,6 +58,14 @@ MultipleBinaryImageMetricsCalculator<TFixedImage, TMovingImage, TMetric>
   return m_MetricValues[i];
 }
 
+template <class TFixedImage, class TMovingImage, class TMetric>
+unsigned int
+MultipleBinaryImageMetricsCalculator<TFixedImage, TMovingImage, TMetric>
+::GetLabel(unsigned int i) const
+{
+  return m_Labels[i];
+}
+
 template <class TFixedImage, class TMovingImage, class TMetric>
 void
 MultipleBinaryImageMetricsCalculator<TFixedImage, TMovingImage, TMetric>
@@ -66,33 +77,79 @@ MultipleBinaryImageMetricsCalculator<TFixedImage, TMovingImage, TMetric>
   if (m_MovingImage.IsNull())
     itkExceptionMacro(<< "Moving image undefined");
 
-  typedef itk::MinimumMaximumImageCalculator<FixedImageType> FixedMinMaxCalculator;
-  typename FixedMinMaxCalculator::Pointer fminmax = FixedMinMaxCalculator::New();
-  fminmax->SetImage(m_FixedImage);
-  fminmax->ComputeMaximum();
-
-  unsigned int maxLabel = fminmax->GetMaximum();
-
-  typedef itk::MinimumMaximumImageCalculator<MovingImageType> MovingMinMaxCalculator;
-  typename MovingMinMaxCalculator::Pointer mminmax = MovingMinMaxCalculator::New();
-  mminmax->SetImage(m_MovingImage);
-  mminmax->ComputeMaximum();
+  // Positive labels present in either image, labels missing from both are
+  // skipped. Other values are background, as in MultipleLabelOverlapCalculator
+  // and LabelConfusionCounter.
+  m_Labels.clear();
+  if (m_SurfaceDistanceCache.IsNotNull())
+  {
+    const typename SurfaceDistanceCacheType::InventoryType* finventory =
+      m_SurfaceDistanceCache->GetLabelImageInventory(m_FixedImage);
+    const typename SurfaceDistanceCacheType::InventoryType* minventory =
+      m_SurfaceDistanceCache->GetLabelImageInventory(m_MovingImage);
+
+    for (unsigned int i = 0; i < finventory->GetLabels().size(); i++)
+      if (finventory->GetLabels()[i] > 0)
+        m_Labels.push_back(finventory->GetLabels()[i]);
+    for (unsigned int i = 0; i < minventory->GetLabels().size(); i++)
+      if (minventory->GetLabels()[i] > 0)
+        m_Labels.push_back(minventory->GetLabels()[i]);
+  }
+  else
+  {
+    typedef LabelImageInventory<FixedImageType> FixedInventoryType;
+    typename FixedInventoryType::Pointer finventory = FixedInventoryType::New();
+    finventory->SetImage(m_FixedImage);
+    finventory->SetNumberOfThreads(m_NumberOfThreads);
+    finventory->Update();
+
+    typedef LabelImageInventory<MovingImageType> MovingInventoryType;
+    typename MovingInventoryType::Pointer minventory = MovingInventoryType::New();
+    minventory->SetImage(m_MovingImage);
+    minventory->SetNumberOfThreads(m_NumberOfThreads);
+    minventory->Update();
+
+    for (unsigned int i = 0; i < finventory->GetLabels().size(); i++)
+      if (finventory->GetLabels()[i] > 0)
+        m_Labels.push_back(finventory->GetLabels()[i]);
+    for (unsigned int i = 0; i < minventory->GetLabels().size(); i++)
+      if (minventory->GetLabels()[i] > 0)
+        m_Labels.push_back(minventory->GetLabels()[i]);
+  }
 
-  if (mminmax->GetMaximum() > maxLabel)
-    maxLabel = mminmax->GetMaximum();
+  std::sort(m_Labels.begin(), m_Labels.end());
+  m_Labels.erase(std::unique(m_Labels.begin(), m_Labels.end()), m_Labels.end());
 
   m_MetricValues.clear();
 
-  for (unsigned int label = 1; label <= maxLabel; label++)
+  for (unsigned int i = 0; i < m_Labels.size(); i++)
   {
+    unsigned int label = m_Labels[i];
+
     itkDebugMacro(<< "Computing metric for label " << label << "\n");
 
+    if (m_SurfaceDistanceCache.IsNotNull())
+    {
+      typename MetricType::Pointer metric = MetricType::New();
+      metric->SetFixedImage(m_FixedImage);
+      metric->SetMovingImage(m_MovingImage);
+      metric->SetNumberOfThreads(m_NumberOfThreads);
+      metric->SetSurfaceDistanceCache(m_SurfaceDistanceCache);
+      metric->SetLabel(label);
+
+      m_MetricValues.push_back(metric->GetValue());
+
+      m_SurfaceDistanceCache->ReleaseLabel(label);
+      continue;
+    }
+
     typedef itk::BinaryThresholdImageFilter<FixedImageType, FixedImageType>
       FixedThresholderType;
     typename FixedThresholderType::Pointer thresf = FixedThresholderType::New();
     thresf->SetInput(m_FixedImage);
     thresf->SetLowerThreshold(label);
     thresf->SetUpperThreshold(label);
+    thresf->SetNumberOfThreads(m_NumberOfThreads);
     thresf->Update();
 
     typedef itk::BinaryThresholdImageFilter<MovingImageType, MovingImageType>
@@ -101,11 +158,13 @@ MultipleBinaryImageMetricsCalculator<TFixedImage, TMovingImage, TMetric>
     thresm->SetInput(m_MovingImage);
     thresm->SetLowerThreshold(label);
     thresm->SetUpperThreshold(label);
+    thresm->SetNumberOfThreads(m_NumberOfThreads);
     thresm->Update();
 
     typename MetricType::Pointer metric = MetricType::New();
     metric->SetFixedImage(thresf->GetOutput());
     metric->SetMovingImage(thresm->GetOutput());
+    metric->SetNumberOfThreads(m_NumberOfThreads);
 
     m_MetricValues.push_back(metric->GetValue());
   }
@@ -0,0 +1,153 @@
+// Computes the overlap metrics (Dice, Jaccard, sensitivity, specificity and
+// PPV) for every label in a pair of label images
+//
+// The per-label confusion table (TP/FP/FN/TN) is built in a single sweep over
+// both images, so no intermediate thresholded volumes are created. The sweep
+// is split across threads, each filling its own table. Small labels are
+// counted in arrays indexed by label and larger ones in a map, so memory
+// scales with the labels present rather than with the largest value; a
+// stray voxel of a huge value costs one map entry. When both images hold
+// unsigned char the arrays cover every value, and regions of the same size
+// are counted row by row straight from the pixel buffers.
+//
+// Values are reported for the positive labels present in either image, in
+// increasing order, GetLabel(i) giving the label of value i. Non-positive
+// values are background, as with thresholded masks.
+//
+// With AccumulateOn, each Update adds the counts over the current requested
+// regions to those of earlier updates, so images read in slabs can be
+// scored one slab at a time. Reset clears the counts.
+
+#ifndef _MultipleLabelOverlapCalculator_h
+#define _MultipleLabelOverlapCalculator_h
+
+#include "BinaryOverlapCounts.h"
+#include "ImageRegionPairSplitter.h"
+#include "LabelPixelTraits.h"
+
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include <map>
+#include <vector>
+
+template <class TFixedImage, class TMovingImage>
+class MultipleLabelOverlapCalculator:
+  public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef MultipleLabelOverlapCalculator                     Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  typedef TFixedImage FixedImageType;
+  typedef TMovingImage MovingImageType;
+
+  typedef typename FixedImageType::Pointer FixedImagePointer;
+  typedef typename MovingImageType::Pointer MovingImagePointer;
+
+  typedef typename FixedImageType::PixelType FixedPixelType;
+  typedef typename MovingImageType::PixelType MovingPixelType;
+
+  typedef BinaryOverlapCounts::CountType CountType;
+  typedef unsigned long LabelType;
+
+  typedef typename FixedImageType::RegionType RegionType;
+
+  typedef ImageRegionPairSplitter<FixedImageType::ImageDimension> SplitterType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MultipleLabelOverlapCalculator, itk::Object);
+
+  void SetFixedImage(FixedImageType* img);
+  void SetMovingImage(MovingImageType* img);
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  itkSetMacro(Accumulate, bool);
+  itkGetConstMacro(Accumulate, bool);
+  itkBooleanMacro(Accumulate);
+
+  void Update();
+
+  void Reset();
+
+  unsigned int GetNumberOfValues() const;
+
+  LabelType GetLabel(unsigned int i) const { return m_Labels[i]; }
+
+  const BinaryOverlapCounts& GetCounts(unsigned int i) const;
+
+  double GetDice(unsigned int i) const;
+  double GetJaccard(unsigned int i) const;
+  double GetSensitivity(unsigned int i) const;
+  double GetSpecificity(unsigned int i) const;
+  double GetPositivePredictiveValue(unsigned int i) const;
+
+protected:
+
+  MultipleLabelOverlapCalculator();
+  ~MultipleLabelOverlapCalculator();
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedUpdate(unsigned int threadId, unsigned int numThreads);
+
+  // Whether the arrays hold every value of both pixel types
+  static const bool DenseCoversAllValues =
+    LabelPixelTraits<FixedPixelType>::NumberOfValues == 256 &&
+    LabelPixelTraits<MovingPixelType>::NumberOfValues == 256;
+
+  // Labels below this are counted in the arrays, others in the map
+  static const unsigned int DenseTableSize =
+    DenseCoversAllValues ? 256 : 1024;
+
+  typedef std::map<LabelType, BinaryOverlapCounts> SparseCountMapType;
+
+  // Counts of small labels indexed by label value, of the others by map.
+  // True negatives are derived from the voxel count at the end.
+  struct LabelCountTable
+  {
+    std::vector<CountType> TruePositives;
+    std::vector<CountType> FalsePositives;
+    std::vector<CountType> FalseNegatives;
+    SparseCountMapType SparseCounts;
+    CountType NumberOfVoxels;
+  };
+
+  // Counts regions of the same size row by row into a fixed size table
+  void CountRows(const RegionType& fixedRegion, const RegionType& movingRegion,
+    LabelCountTable& table) const;
+
+  FixedImagePointer m_FixedImage;
+  MovingImagePointer m_MovingImage;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  bool m_Accumulate;
+
+  std::vector<LabelCountTable> m_ThreadTables;
+
+  // Counts over all updates since the last reset
+  LabelCountTable m_Totals;
+
+  // Labels present and their counts
+  std::vector<LabelType> m_Labels;
+  std::vector<BinaryOverlapCounts> m_LabelCounts;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "MultipleLabelOverlapCalculator.txx"
+#endif
+
+
+#endif
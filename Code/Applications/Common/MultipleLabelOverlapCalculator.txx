@@ -0,0 +1,398 @@
+
+#ifndef _MultipleLabelOverlapCalculator_txx
+#define _MultipleLabelOverlapCalculator_txx
+
+#include "MultipleLabelOverlapCalculator.h"
+
+#include "DiceOverlapImageToImageMetric.h"
+#include "JaccardOverlapImageToImageMetric.h"
+#include "PositivePredictiveValueImageToImageMetric.h"
+#include "SensitivityImageToImageMetric.h"
+#include "SpecificityImageToImageMetric.h"
+
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+template <class TFixedImage, class TMovingImage>
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::MultipleLabelOverlapCalculator()
+{
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  m_Accumulate = false;
+
+  this->Reset();
+}
+
+template <class TFixedImage, class TMovingImage>
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::~MultipleLabelOverlapCalculator()
+{
+
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::SetFixedImage(FixedImageType* img)
+{
+  m_FixedImage = img;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::SetMovingImage(MovingImageType* img)
+{
+  m_MovingImage = img;
+}
+
+template <class TFixedImage, class TMovingImage>
+unsigned int
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetNumberOfValues() const
+{
+  return m_LabelCounts.size();
+}
+
+template <class TFixedImage, class TMovingImage>
+const BinaryOverlapCounts&
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetCounts(unsigned int i) const
+{
+  return m_LabelCounts[i];
+}
+
+template <class TFixedImage, class TMovingImage>
+double
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetDice(unsigned int i) const
+{
+  return DiceOverlapImageToImageMetric<TFixedImage, TMovingImage>
+    ::ComputeValue(m_LabelCounts[i]);
+}
+
+template <class TFixedImage, class TMovingImage>
+double
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetJaccard(unsigned int i) const
+{
+  return JaccardOverlapImageToImageMetric<TFixedImage, TMovingImage>
+    ::ComputeValue(m_LabelCounts[i]);
+}
+
+template <class TFixedImage, class TMovingImage>
+double
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetSensitivity(unsigned int i) const
+{
+  return SensitivityImageToImageMetric<TFixedImage, TMovingImage>
+    ::ComputeValue(m_LabelCounts[i]);
+}
+
+template <class TFixedImage, class TMovingImage>
+double
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetSpecificity(unsigned int i) const
+{
+  return SpecificityImageToImageMetric<TFixedImage, TMovingImage>
+    ::ComputeValue(m_LabelCounts[i]);
+}
+
+template <class TFixedImage, class TMovingImage>
+double
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::GetPositivePredictiveValue(unsigned int i) const
+{
+  return PositivePredictiveValueImageToImageMetric<TFixedImage, TMovingImage>
+    ::ComputeValue(m_LabelCounts[i]);
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::Reset()
+{
+  m_Totals.TruePositives.assign(DenseTableSize, 0);
+  m_Totals.FalsePositives.assign(DenseTableSize, 0);
+  m_Totals.FalseNegatives.assign(DenseTableSize, 0);
+  m_Totals.SparseCounts.clear();
+  m_Totals.NumberOfVoxels = 0;
+
+  m_Labels.clear();
+  m_LabelCounts.clear();
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::Update()
+{
+  if (m_FixedImage.IsNull())
+    itkExceptionMacro(<< "Fixed image undefined");
+
+  if (m_MovingImage.IsNull())
+    itkExceptionMacro(<< "Moving image undefined");
+
+  unsigned int numThreads = SplitterType::GetNumberOfSplits(
+    m_FixedImage->GetRequestedRegion(), m_MovingImage->GetRequestedRegion(),
+    m_NumberOfThreads);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+
+  m_ThreadTables.clear();
+  m_ThreadTables.resize(threader->GetNumberOfThreads());
+
+  threader->SingleMethodExecute();
+
+  if (!m_Accumulate)
+    this->Reset();
+
+  // Merge the per-thread tables into the totals
+  std::vector<CountType>& truePositives = m_Totals.TruePositives;
+  std::vector<CountType>& falsePositives = m_Totals.FalsePositives;
+  std::vector<CountType>& falseNegatives = m_Totals.FalseNegatives;
+
+  for (unsigned int t = 0; t < m_ThreadTables.size(); t++)
+  {
+    const LabelCountTable& table = m_ThreadTables[t];
+
+    for (unsigned int label = 0; label < DenseTableSize; label++)
+    {
+      truePositives[label] += table.TruePositives[label];
+      falsePositives[label] += table.FalsePositives[label];
+      falseNegatives[label] += table.FalseNegatives[label];
+    }
+
+    typename SparseCountMapType::const_iterator it;
+    for (it = table.SparseCounts.begin(); it != table.SparseCounts.end(); ++it)
+      m_Totals.SparseCounts[it->first] += it->second;
+
+    m_Totals.NumberOfVoxels += table.NumberOfVoxels;
+  }
+
+  m_ThreadTables.clear();
+
+  // Entry 0 collects background and is not reported, nor are labels in
+  // neither image
+  m_Labels.clear();
+  m_LabelCounts.clear();
+
+  for (unsigned int label = 1; label < DenseTableSize; label++)
+  {
+    if (truePositives[label] == 0 && falsePositives[label] == 0 &&
+        falseNegatives[label] == 0)
+      continue;
+
+    BinaryOverlapCounts counts;
+    counts.TruePositives = truePositives[label];
+    counts.FalsePositives = falsePositives[label];
+    counts.FalseNegatives = falseNegatives[label];
+
+    m_Labels.push_back(label);
+    m_LabelCounts.push_back(counts);
+  }
+
+  // Map entries are all above the array labels, in increasing order
+  typename SparseCountMapType::const_iterator it;
+  for (it = m_Totals.SparseCounts.begin(); it != m_Totals.SparseCounts.end(); ++it)
+  {
+    m_Labels.push_back(it->first);
+    m_LabelCounts.push_back(it->second);
+  }
+
+  for (unsigned int i = 0; i < m_LabelCounts.size(); i++)
+  {
+    BinaryOverlapCounts& counts = m_LabelCounts[i];
+    counts.TrueNegatives =
+      m_Totals.NumberOfVoxels - counts.TruePositives - counts.FalsePositives - counts.FalseNegatives;
+  }
+
+}
+
+template <class TFixedImage, class TMovingImage>
+ITK_THREAD_RETURN_TYPE
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedUpdate(info->ThreadID, info->NumberOfThreads);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::ThreadedUpdate(unsigned int threadId, unsigned int numThreads)
+{
+  RegionType fixedRegion = m_FixedImage->GetRequestedRegion();
+  RegionType movingRegion = m_MovingImage->GetRequestedRegion();
+
+  LabelCountTable& table = m_ThreadTables[threadId];
+  table.TruePositives.assign(DenseTableSize, 0);
+  table.FalsePositives.assign(DenseTableSize, 0);
+  table.FalseNegatives.assign(DenseTableSize, 0);
+  table.SparseCounts.clear();
+  table.NumberOfVoxels = 0;
+
+  if (!SplitterType::GetSplit(threadId, numThreads, fixedRegion, movingRegion))
+    return;
+
+  if (DenseCoversAllValues && fixedRegion.GetSize() == movingRegion.GetSize())
+  {
+    this->CountRows(fixedRegion, movingRegion, table);
+    return;
+  }
+
+  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
+  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+
+  FixedIteratorType fixedIt(m_FixedImage, fixedRegion);
+  MovingIteratorType movingIt(m_MovingImage, movingRegion);
+
+  std::vector<CountType>& truePositives = table.TruePositives;
+  std::vector<CountType>& falsePositives = table.FalsePositives;
+  std::vector<CountType>& falseNegatives = table.FalseNegatives;
+
+  // Map entries of the last large fixed and moving labels seen
+  BinaryOverlapCounts* lastFixedCounts = 0;
+  LabelType lastFixedLabel = 0;
+  BinaryOverlapCounts* lastMovingCounts = 0;
+  LabelType lastMovingLabel = 0;
+
+  CountType numVoxels = 0;
+
+  fixedIt.GoToBegin();
+  movingIt.GoToBegin();
+  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
+  {
+    // Non-positive values are background, as with the thresholded masks
+    LabelType r = 0;
+    if (fixedIt.Get() > 0)
+      r = (LabelType)fixedIt.Get();
+
+    LabelType c = 0;
+    if (movingIt.Get() > 0)
+      c = (LabelType)movingIt.Get();
+
+    if (r < DenseTableSize && c < DenseTableSize)
+    {
+      if (r == c)
+      {
+        truePositives[r]++;
+      }
+      else
+      {
+        falseNegatives[r]++;
+        falsePositives[c]++;
+      }
+    }
+    else
+    {
+      if (r >= DenseTableSize &&
+          (lastFixedCounts == 0 || r != lastFixedLabel))
+      {
+        lastFixedLabel = r;
+        lastFixedCounts = &table.SparseCounts[r];
+      }
+      if (c >= DenseTableSize &&
+          (lastMovingCounts == 0 || c != lastMovingLabel))
+      {
+        lastMovingLabel = c;
+        lastMovingCounts = &table.SparseCounts[c];
+      }
+
+      if (r == c)
+        lastFixedCounts->TruePositives++;
+      else
+      {
+        if (r < DenseTableSize)
+          falseNegatives[r]++;
+        else
+          lastFixedCounts->FalseNegatives++;
+
+        if (c < DenseTableSize)
+          falsePositives[c]++;
+        else
+          lastMovingCounts->FalsePositives++;
+      }
+    }
+
+    numVoxels++;
+
+    ++fixedIt;
+    ++movingIt;
+  }
+
+  table.NumberOfVoxels = numVoxels;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+MultipleLabelOverlapCalculator<TFixedImage, TMovingImage>
+::CountRows(const RegionType& fixedRegion, const RegionType& movingRegion,
+  LabelCountTable& table) const
+{
+  const unsigned int dim = FixedImageType::ImageDimension;
+
+  unsigned int rowLength = fixedRegion.GetSize()[0];
+
+  RegionType rowStarts = fixedRegion;
+  typename RegionType::SizeType size = fixedRegion.GetSize();
+  size[0] = 1;
+  rowStarts.SetSize(size);
+
+  CountType* truePositives = &table.TruePositives[0];
+  CountType* falsePositives = &table.FalsePositives[0];
+  CountType* falseNegatives = &table.FalseNegatives[0];
+
+  const FixedPixelType* fixedBuffer = m_FixedImage->GetBufferPointer();
+  const MovingPixelType* movingBuffer = m_MovingImage->GetBufferPointer();
+
+  CountType numVoxels = 0;
+
+  typedef itk::ImageRegionConstIteratorWithIndex<FixedImageType> RowIteratorType;
+  RowIteratorType rowIt(m_FixedImage, rowStarts);
+  for (rowIt.GoToBegin(); !rowIt.IsAtEnd(); ++rowIt)
+  {
+    typename FixedImageType::IndexType fixedIndex = rowIt.GetIndex();
+
+    typename MovingImageType::IndexType movingIndex;
+    for (unsigned int d = 0; d < dim; d++)
+      movingIndex[d] = fixedIndex[d]
+        - fixedRegion.GetIndex()[d] + movingRegion.GetIndex()[d];
+
+    const FixedPixelType* f =
+      fixedBuffer + m_FixedImage->ComputeOffset(fixedIndex);
+    const MovingPixelType* m =
+      movingBuffer + m_MovingImage->ComputeOffset(movingIndex);
+
+    // Every value indexes the tables directly
+    for (unsigned int k = 0; k < rowLength; k++)
+    {
+      unsigned int r = (unsigned int)f[k];
+      unsigned int c = (unsigned int)m[k];
+
+      if (r == c)
+      {
+        truePositives[r]++;
+      }
+      else
+      {
+        falseNegatives[r]++;
+        falsePositives[c]++;
+      }
+    }
+
+    numVoxels += rowLength;
+  }
+
+  table.NumberOfVoxels = numVoxels;
+}
+
+#endif
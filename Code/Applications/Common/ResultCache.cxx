@@ -0,0 +1,200 @@
+
+#include "ResultCache.h"
+
+#include "CacheFile.h"
+
+#include "itkMutexLockHolder.h"
+
+#include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+const char* const ResultCache::CodeVersion = "2";
+
+ResultCache
+::ResultCache()
+{
+  m_Version = CodeVersion;
+}
+
+ResultCache
+::~ResultCache()
+{
+
+}
+
+std::string
+ResultCache
+::ComputeFileHash(const std::string& fn)
+{
+  std::ifstream is(fn.c_str(), std::ios::in | std::ios::binary);
+  if (!is.is_open())
+    return std::string();
+
+  itksysMD5* md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+
+  std::vector<char> buffer(1 << 20);
+  while (is)
+  {
+    is.read(&buffer[0], buffer.size());
+    if (is.gcount() > 0)
+      itksysMD5_Append(md5, (const unsigned char*)&buffer[0], (int)is.gcount());
+  }
+
+  char hex[33];
+  itksysMD5_FinalizeHex(md5, hex);
+  itksysMD5_Delete(md5);
+
+  if (is.bad())
+    return std::string();
+
+  hex[32] = 0;
+  return std::string(hex);
+}
+
+std::string
+ResultCache
+::GetFileHash(const std::string& fn)
+{
+  std::ostringstream oss;
+  oss << fn << " " << itksys::SystemTools::FileLength(fn) << " "
+    << itksys::SystemTools::ModifiedTime(fn);
+  std::string fileKey = oss.str();
+
+  {
+    itk::MutexLockHolder<itk::SimpleFastMutexLock> holder(m_FileHashesLock);
+    std::map<std::string, std::string>::const_iterator it =
+      m_FileHashes.find(fileKey);
+    if (it != m_FileHashes.end())
+      return it->second;
+  }
+
+  // Hashed outside of the lock, threads hashing the same file get the same
+  std::string hash = Self::ComputeFileHash(fn);
+  if (hash.empty())
+    return hash;
+
+  itk::MutexLockHolder<itk::SimpleFastMutexLock> holder(m_FileHashesLock);
+  m_FileHashes[fileKey] = hash;
+
+  return hash;
+}
+
+std::string
+ResultCache
+::GetKey(const std::string& fn1, const std::string& fn2,
+  const std::string& metric, const std::string& parameters)
+{
+  if (!this->GetEnabled())
+    return std::string();
+
+  // Files that cannot be read are left for the metric to report
+  std::string hash1 = this->GetFileHash(fn1);
+  std::string hash2 = this->GetFileHash(fn2);
+  if (hash1.empty() || hash2.empty())
+    return std::string();
+
+  std::ostringstream oss;
+  oss << "version " << m_Version << "\n"
+    << "metric " << metric << "\n"
+    << "parameters " << parameters << "\n"
+    << "inputs " << hash1 << " " << hash2 << "\n";
+
+  return CacheFile::ComputeStringHash(oss.str());
+}
+
+std::string
+ResultCache
+::GetFileName(const std::string& key) const
+{
+  return m_Directory + "/" + key + ".result";
+}
+
+bool
+ResultCache
+::Find(const std::string& key, std::string& result) const
+{
+  if (key.empty() || !this->GetEnabled())
+    return false;
+
+  std::ifstream is(this->GetFileName(key).c_str(),
+    std::ios::in | std::ios::binary);
+  if (!is.is_open())
+    return false;
+
+  std::ostringstream oss;
+  oss << is.rdbuf();
+  if (is.bad())
+    return false;
+
+  result = oss.str();
+  return true;
+}
+
+void
+ResultCache
+::Store(const std::string& key, const std::string& result)
+{
+  if (key.empty() || !this->GetEnabled())
+    return;
+
+  itksys::SystemTools::MakeDirectory(m_Directory.c_str());
+
+  std::string fn = this->GetFileName(key);
+
+  std::string tmpfn = CacheFile::GetTemporaryFileName(fn);
+
+  {
+    std::ofstream os(tmpfn.c_str(), std::ios::out | std::ios::binary);
+    os.write(result.c_str(), result.size());
+    os.close();
+    if (os.fail())
+    {
+      std::remove(tmpfn.c_str());
+      itkWarningMacro(<< "Cannot write result cache file " << fn);
+      return;
+    }
+  }
+
+  if (!CacheFile::Replace(tmpfn, fn))
+    itkWarningMacro(<< "Cannot write result cache file " << fn);
+}
+
+bool
+ResultCache
+::FindFile(const std::string& key, const std::string& fn) const
+{
+  std::string result;
+  if (!this->Find(key, result))
+    return false;
+
+  std::ofstream os(fn.c_str(), std::ios::out | std::ios::binary);
+  os.write(result.c_str(), result.size());
+  os.close();
+
+  return !os.fail();
+}
+
+void
+ResultCache
+::StoreFile(const std::string& key, const std::string& fn)
+{
+  if (key.empty() || !this->GetEnabled())
+    return;
+
+  std::ifstream is(fn.c_str(), std::ios::in | std::ios::binary);
+  if (!is.is_open())
+    return;
+
+  std::ostringstream oss;
+  oss << is.rdbuf();
+  if (is.bad())
+    return;
+
+  this->Store(key, oss.str());
+}
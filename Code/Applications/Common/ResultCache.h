@@ -0,0 +1,129 @@
+// Results of metric runs kept on disk, so scoring files that have not
+// changed with the same metric and parameters is a lookup
+//
+// Results are stored in a directory, one file per result, named after the
+// MD5 hash of the contents of the input files, the metric name, a string of
+// the parameters that change the result and the code version. File names
+// and parameters that only change how the result is computed (threads,
+// memory limits) are not part of the key. CodeVersion must be bumped
+// whenever a metric changes its results, which invalidates every stored
+// result.
+//
+// Results are written under a temporary name and renamed into place, so
+// runs sharing a directory never see a partly written result (see
+// CacheFile). With no
+// directory set the cache is disabled: nothing is hashed, found or stored.
+//
+// Thread safe, one cache may be shared by the threads scoring a batch.
+
+#ifndef _ResultCache_h
+#define _ResultCache_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <map>
+#include <string>
+
+class ResultCache: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef ResultCache                                        Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ResultCache, itk::Object);
+
+  /** Bumped whenever a metric changes its results. */
+  static const char* const CodeVersion;
+
+  /**
+   * Version in the keys, CodeVersion unless set otherwise. Results stored
+   * under another version are not found.
+   */
+  void SetVersion(const std::string& v) { m_Version = v; }
+  const std::string& GetVersion() const { return m_Version; }
+
+  void SetDirectory(const std::string& dir) { m_Directory = dir; }
+  const std::string& GetDirectory() const { return m_Directory; }
+
+  bool GetEnabled() const { return !m_Directory.empty(); }
+
+  /**
+   * Key of the result of a metric on a pair of files, empty when the cache
+   * is disabled.
+   */
+  std::string GetKey(const std::string& fn1, const std::string& fn2,
+    const std::string& metric, const std::string& parameters);
+
+  /** Stored result for the key, returns false if there is none. */
+  bool Find(const std::string& key, std::string& result) const;
+
+  /** Stores the result for the key, a warning is issued if it cannot. */
+  void Store(const std::string& key, const std::string& result);
+
+  /** Writes the stored result to a file, returns false if there is none. */
+  bool FindFile(const std::string& key, const std::string& fn) const;
+
+  /** Stores the contents of a file as the result for the key. */
+  void StoreFile(const std::string& key, const std::string& fn);
+
+  /**
+   * Writes the stored result for the key to the output file if there is
+   * one, otherwise calls compute(), which writes the output file, and
+   * stores the file if it returns 0. Returns 0 on a hit, else the value
+   * returned by compute().
+   */
+  template <class TCompute>
+  int FindOrCompute(const std::string& key, const std::string& fn,
+    TCompute compute)
+  {
+    if (this->FindFile(key, fn))
+      return 0;
+
+    int val = compute();
+    if (val == 0)
+      this->StoreFile(key, fn);
+
+    return val;
+  }
+
+  /**
+   * MD5 of the contents of a file, as 32 hex digits. Hashes are kept for
+   * the life of the cache, keyed by file name, size and modification time.
+   */
+  std::string GetFileHash(const std::string& fn);
+
+protected:
+
+  ResultCache();
+  ~ResultCache();
+
+  static std::string ComputeFileHash(const std::string& fn);
+
+  std::string GetFileName(const std::string& key) const;
+
+  std::string m_Directory;
+  std::string m_Version;
+
+  // Hashes of the files seen, keyed by name, size and modification time
+  std::map<std::string, std::string> m_FileHashes;
+  itk::SimpleFastMutexLock m_FileHashesLock;
+
+private:
+
+  ResultCache(const Self&);          // Not implemented
+  void operator=(const Self&);       // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,235 @@
+
+#include "WorkStealingJobPool.h"
+
+#include "itkMutexLockHolder.h"
+
+#include <algorithm>
+#include <exception>
+#include <sstream>
+
+namespace
+{
+
+// Orders job numbers by decreasing cost, ties by job number
+class CostlierJob
+{
+public:
+  CostlierJob(const std::vector<double>& costs): m_Costs(costs) { }
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    if (m_Costs[a] != m_Costs[b])
+      return m_Costs[a] > m_Costs[b];
+    return a < b;
+  }
+
+private:
+  const std::vector<double>& m_Costs;
+};
+
+}
+
+WorkStealingJobPool
+::WorkStealingJobPool()
+{
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  m_JobFunction = 0;
+  m_JobData = 0;
+
+  m_QueueLocks = 0;
+}
+
+WorkStealingJobPool
+::~WorkStealingJobPool()
+{
+  delete [] m_QueueLocks;
+}
+
+void
+WorkStealingJobPool
+::SetNumberOfJobs(unsigned int n)
+{
+  m_JobCosts.assign(n, 1.0);
+  m_JobErrors.assign(n, std::string());
+  this->Modified();
+}
+
+void
+WorkStealingJobPool
+::SetJobCosts(const std::vector<double>& costs)
+{
+  m_JobCosts = costs;
+  m_JobErrors.assign(costs.size(), std::string());
+  this->Modified();
+}
+
+std::vector<unsigned int>
+WorkStealingJobPool
+::GetJobOrder() const
+{
+  std::vector<unsigned int> order(m_JobCosts.size());
+  for (unsigned int i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), CostlierJob(m_JobCosts));
+  return order;
+}
+
+unsigned int
+WorkStealingJobPool
+::GetNumberOfFailedJobs() const
+{
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < m_JobErrors.size(); i++)
+    if (!m_JobErrors[i].empty())
+      n++;
+  return n;
+}
+
+void
+WorkStealingJobPool
+::Run(JobFunctionType f, void* data)
+{
+  if (f == 0)
+    itkExceptionMacro(<< "Job function undefined");
+
+  m_JobFunction = f;
+  m_JobData = data;
+
+  m_JobErrors.assign(m_JobCosts.size(), std::string());
+
+  if (m_JobCosts.size() == 0)
+    return;
+
+  // No more threads than jobs
+  itk::ThreadIdType numThreads = m_NumberOfThreads;
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numThreads > m_JobCosts.size())
+    numThreads = m_JobCosts.size();
+
+  std::vector<unsigned int> order = this->GetJobOrder();
+
+  m_Queues.clear();
+  m_Queues.resize(numThreads);
+  for (unsigned int i = 0; i < order.size(); i++)
+    m_Queues[i % numThreads].push_back(order[i]);
+
+  delete [] m_QueueLocks;
+  m_QueueLocks = new itk::SimpleFastMutexLock[numThreads];
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+  threader->SingleMethodExecute();
+
+  delete [] m_QueueLocks;
+  m_QueueLocks = 0;
+
+  m_Queues.clear();
+}
+
+ITK_THREAD_RETURN_TYPE
+WorkStealingJobPool
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedRun(info->ThreadID);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void
+WorkStealingJobPool
+::ThreadedRun(unsigned int threadId)
+{
+  // The threader may start fewer threads than asked for, those missing
+  // leave their queues to be taken by the others
+  if (threadId >= m_Queues.size())
+    return;
+
+  unsigned int job = 0;
+  while (this->NextJob(threadId, job))
+  {
+    try
+    {
+      m_JobFunction(job, threadId, m_JobData);
+    }
+    catch (itk::ExceptionObject& e)
+    {
+      std::ostringstream oss;
+      oss << e;
+      m_JobErrors[job] = oss.str();
+    }
+    catch (std::exception& e)
+    {
+      m_JobErrors[job] = std::string("Exception: ") + e.what();
+    }
+    catch (std::string& s)
+    {
+      m_JobErrors[job] = "Exception: " + s;
+    }
+    catch (...)
+    {
+      m_JobErrors[job] = "Unknown exception";
+    }
+  }
+}
+
+bool
+WorkStealingJobPool
+::NextJob(unsigned int threadId, unsigned int& job)
+{
+  {
+    itk::MutexLockHolder<itk::SimpleFastMutexLock> holder(m_QueueLocks[threadId]);
+    std::deque<unsigned int>& queue = m_Queues[threadId];
+    if (!queue.empty())
+    {
+      job = queue.front();
+      queue.pop_front();
+      return true;
+    }
+  }
+
+  // Queues only shrink once running, so with every queue empty all jobs
+  // have been started
+  while (true)
+  {
+    unsigned int victim = m_Queues.size();
+    double victimCost = 0.0;
+
+    for (unsigned int q = 0; q < m_Queues.size(); q++)
+    {
+      if (q == threadId)
+        continue;
+
+      itk::MutexLockHolder<itk::SimpleFastMutexLock> holder(m_QueueLocks[q]);
+      if (m_Queues[q].empty())
+        continue;
+
+      double cost = m_JobCosts[m_Queues[q].front()];
+      if (victim == m_Queues.size() || cost > victimCost)
+      {
+        victim = q;
+        victimCost = cost;
+      }
+    }
+
+    if (victim == m_Queues.size())
+      return false;
+
+    itk::MutexLockHolder<itk::SimpleFastMutexLock> holder(m_QueueLocks[victim]);
+    std::deque<unsigned int>& queue = m_Queues[victim];
+    if (!queue.empty())
+    {
+      job = queue.front();
+      queue.pop_front();
+      return true;
+    }
+
+    // Emptied since it was looked at, look again
+  }
+}
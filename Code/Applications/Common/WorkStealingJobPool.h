@@ -0,0 +1,101 @@
+// Runs a set of independent jobs on a fixed number of threads, for batches
+// of image pairs where each job is a whole case
+//
+// Jobs are ordered by decreasing cost and dealt round robin to one queue
+// per thread. A thread runs the jobs of its own queue in order, and once it
+// is empty takes the costliest job not yet started from the other queues.
+// Large cases therefore start first and small ones fill in around them, and
+// no thread sits idle while another has jobs waiting. Costs only order the
+// jobs, any estimate of the work (file sizes, for one) will do.
+//
+// Each job runs once, on one thread. Exceptions thrown by a job are caught
+// and kept as its error, the other jobs still run.
+
+#ifndef _WorkStealingJobPool_h
+#define _WorkStealingJobPool_h
+
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+class WorkStealingJobPool: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef WorkStealingJobPool                                Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(WorkStealingJobPool, itk::Object);
+
+  /** Called for each job, with the thread running it and the user data. */
+  typedef void (*JobFunctionType)(unsigned int job, unsigned int threadId,
+    void* data);
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  /** Jobs of equal cost, run in order of their number. */
+  void SetNumberOfJobs(unsigned int n);
+
+  /** One job per cost. */
+  void SetJobCosts(const std::vector<double>& costs);
+
+  unsigned int GetNumberOfJobs() const { return m_JobCosts.size(); }
+
+  /** Jobs by decreasing cost, about the order in which they are started. */
+  std::vector<unsigned int> GetJobOrder() const;
+
+  /** Runs every job, returning once all are done. */
+  void Run(JobFunctionType f, void* data);
+
+  /** Description of the exception thrown by a job, empty if it had none. */
+  const std::string& GetJobError(unsigned int job) const
+  { return m_JobErrors[job]; }
+
+  unsigned int GetNumberOfFailedJobs() const;
+
+protected:
+
+  WorkStealingJobPool();
+  ~WorkStealingJobPool();
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedRun(unsigned int threadId);
+
+  // Next job for the thread, from its own queue or taken from another
+  bool NextJob(unsigned int threadId, unsigned int& job);
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  std::vector<double> m_JobCosts;
+  std::vector<std::string> m_JobErrors;
+
+  JobFunctionType m_JobFunction;
+  void* m_JobData;
+
+  // Job queue of each thread, most costly first, and its lock
+  std::vector< std::deque<unsigned int> > m_Queues;
+  itk::SimpleFastMutexLock* m_QueueLocks;
+
+private:
+
+  WorkStealingJobPool(const Self&);  // Not implemented
+  void operator=(const Self&);       // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,346 @@
+
+// Computes a selection of the image metrics from a single read of the image
+// pair, writing all values to one JSON file
+//
+// The overlap metrics of every label and kappa come from one confusion
+// table, and the two distance metrics of each label share the boundaries
+// and distance maps of a SurfaceDistanceCache, loaded from a ground truth
+// cache directory when one is given. Values are the same as those of the
+// ValidateImage<Metric> apps, keyed by the same metric names.
+
+#include "AverageDistanceImageToImageMetric.h"
+#include "CohenKappaImageToImageMetric.h"
+#include "DiceOverlapImageToImageMetric.h"
+#include "GroundTruthCache.h"
+#include "HausdorffDistanceImageToImageMetric.h"
+#include "JaccardOverlapImageToImageMetric.h"
+#include "LabelConfusionCounter.h"
+#include "PositivePredictiveValueImageToImageMetric.h"
+#include "SensitivityImageToImageMetric.h"
+#include "SpecificityImageToImageMetric.h"
+#include "SurfaceDistanceCache.h"
+
+#include "itkImage.h"
+
+#include "MappedImageFileReader.h"
+
+#include "ResultCache.h"
+
+#include "itkOutputWindow.h"
+#include "itkTextOutput.h"
+
+#include "vnl/vnl_math.h"
+
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ValidateImageAllCLP.h"
+
+// Writes a value, with null for the infinite and undefined values JSON has
+// no number for
+void
+writeJSONValue(std::ostream& os, double v)
+{
+  if (vnl_math_isfinite(v))
+    os << v;
+  else
+    os << "null";
+}
+
+// Writes "name": {"label": value, ...} for the given labels
+void
+writeJSONLabelValues(std::ostream& os, const std::string& name,
+  const std::vector<unsigned long>& labels, const std::vector<double>& values)
+{
+  os << "  \"" << name << "\": {";
+  for (unsigned int i = 0; i < labels.size(); i++)
+  {
+    if (i > 0)
+      os << ", ";
+    os << "\"" << labels[i] << "\": ";
+    writeJSONValue(os, values[i]);
+  }
+  os << "}";
+}
+
+template <class TPixel>
+int
+validateImageAll(const char* fn1, const char* fn2, const char* outFile,
+  const std::vector<std::string>& metrics, const std::string& weighting,
+  const std::string& cacheDir, int numThreads)
+{
+
+  itk::OutputWindow::SetInstance(itk::TextOutput::New());
+
+  for (unsigned int m = 0; m < metrics.size(); m++)
+  {
+    if (metrics[m] != "Dice" && metrics[m] != "Jaccard" &&
+        metrics[m] != "PPV" && metrics[m] != "Sensitivity" &&
+        metrics[m] != "Specificity" && metrics[m] != "AveDist" &&
+        metrics[m] != "HausdorffDist" && metrics[m] != "Kappa")
+    {
+      std::cerr << "Error: unknown metric " << metrics[m] << std::endl;
+      return -1;
+    }
+  }
+
+  typedef itk::Image<TPixel, 3> ImageType;
+
+  typedef MappedImageFileReader<ImageType> ReaderType;
+
+  typename ImageType::Pointer truthImg;
+  {
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(fn1);
+    reader->Update();
+    truthImg = reader->GetOutput();
+  }
+
+  typename ImageType::Pointer testImg;
+  {
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(fn2);
+    reader->Update();
+    testImg = reader->GetOutput();
+  }
+
+  // Set test image to have the same image coordinate information, in case of
+  // bad submissions
+  testImg->SetOrigin(truthImg->GetOrigin());
+  testImg->SetSpacing(truthImg->GetSpacing());
+  testImg->SetDirection(truthImg->GetDirection());
+
+  typedef DiceOverlapImageToImageMetric<ImageType, ImageType> DiceMetricType;
+  typedef JaccardOverlapImageToImageMetric<ImageType, ImageType>
+    JaccardMetricType;
+  typedef PositivePredictiveValueImageToImageMetric<ImageType, ImageType>
+    PPVMetricType;
+  typedef SensitivityImageToImageMetric<ImageType, ImageType>
+    SensitivityMetricType;
+  typedef SpecificityImageToImageMetric<ImageType, ImageType>
+    SpecificityMetricType;
+  typedef AverageDistanceImageToImageMetric<ImageType, ImageType>
+    AveDistMetricType;
+  typedef HausdorffDistanceImageToImageMetric<ImageType, ImageType>
+    HausdorffDistMetricType;
+  typedef CohenKappaImageToImageMetric<ImageType, ImageType>
+    CohenKappaMetricType;
+
+  typename CohenKappaMetricType::WeightingType weightingType =
+    CohenKappaMetricType::Unweighted;
+  if (weighting == "linear")
+    weightingType = CohenKappaMetricType::LinearWeights;
+  else if (weighting == "quadratic")
+    weightingType = CohenKappaMetricType::QuadraticWeights;
+
+  // One pass over both images, every other metric but the distances is a
+  // function of the confusion table
+  typedef LabelConfusionCounter<ImageType, ImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->SetFixedImage(truthImg);
+  counter->SetMovingImage(testImg);
+  if (numThreads > 0)
+    counter->SetNumberOfThreads(numThreads);
+  counter->Compute();
+
+  const LabelConfusionCounts& counts = counter->GetCounts();
+
+  // Every metric is reported for the positive labels present in either
+  // image, as in the overlap and distance apps
+  std::vector<unsigned long> labels;
+  for (unsigned int i = 0; i < counts.GetNumberOfLabels(); i++)
+    if (counts.GetLabel(i) != 0)
+      labels.push_back(counts.GetLabel(i));
+
+  // Distances are only computed when asked for, the two distance metrics of
+  // a label share its boundaries and distance maps, released once both are
+  // done with the label
+  bool doAveDist = false;
+  bool doHausdorffDist = false;
+  for (unsigned int m = 0; m < metrics.size(); m++)
+  {
+    if (metrics[m] == "AveDist")
+      doAveDist = true;
+    else if (metrics[m] == "HausdorffDist")
+      doHausdorffDist = true;
+  }
+
+  std::vector<double> aveDistValues;
+  std::vector<double> hausdorffDistValues;
+  if (doAveDist || doHausdorffDist)
+  {
+    typedef SurfaceDistanceCache<ImageType> SurfaceDistanceCacheType;
+    typename SurfaceDistanceCacheType::Pointer distanceCache =
+      SurfaceDistanceCacheType::New();
+    distanceCache->CropToBoundingBoxOn();
+    if (numThreads > 0)
+      distanceCache->SetNumberOfThreads(numThreads);
+
+    // Ground truth boundaries and distance maps from the cache directory, or
+    // computed and stored there for the next run against the same truth
+    if (!cacheDir.empty())
+    {
+      typedef GroundTruthCache<ImageType> GroundTruthCacheType;
+      typename GroundTruthCacheType::Pointer truthCache =
+        GroundTruthCacheType::New();
+      truthCache->SetDirectory(cacheDir);
+      truthCache->SetSurfaceDistanceCache(distanceCache);
+      truthCache->Load(truthImg);
+    }
+
+    for (unsigned int i = 0; i < labels.size(); i++)
+    {
+      TPixel label = static_cast<TPixel>(labels[i]);
+
+      if (doAveDist)
+      {
+        typename AveDistMetricType::Pointer metric = AveDistMetricType::New();
+        metric->SetFixedImage(truthImg);
+        metric->SetMovingImage(testImg);
+        metric->SetSurfaceDistanceCache(distanceCache);
+        metric->SetLabel(label);
+        aveDistValues.push_back(metric->GetValue());
+      }
+
+      if (doHausdorffDist)
+      {
+        typename HausdorffDistMetricType::Pointer metric =
+          HausdorffDistMetricType::New();
+        metric->SetFixedImage(truthImg);
+        metric->SetMovingImage(testImg);
+        metric->SetSurfaceDistanceCache(distanceCache);
+        metric->SetLabel(label);
+        hausdorffDistValues.push_back(metric->GetValue());
+      }
+
+      distanceCache->ReleaseLabel(label);
+    }
+  }
+
+  std::ofstream outputfile;
+  outputfile.open(outFile, std::ios::out);
+  outputfile << std::setprecision(12);
+
+  outputfile << "{" << std::endl;
+
+  for (unsigned int m = 0; m < metrics.size(); m++)
+  {
+    const std::string& name = metrics[m];
+
+    if (name == "AveDist")
+    {
+      writeJSONLabelValues(outputfile, name, labels, aveDistValues);
+    }
+    else if (name == "HausdorffDist")
+    {
+      writeJSONLabelValues(outputfile, name, labels, hausdorffDistValues);
+    }
+    else if (name == "Kappa")
+    {
+      outputfile << "  \"" << name << "\": ";
+      writeJSONValue(outputfile,
+        CohenKappaMetricType::ComputeValue(counts, false, weightingType));
+    }
+    else
+    {
+      std::vector<double> values;
+      for (unsigned int i = 0; i < labels.size(); i++)
+      {
+        BinaryOverlapCounts labelCounts =
+          counts.GetOverlapCounts(labels[i]);
+        if (name == "Dice")
+          values.push_back(DiceMetricType::ComputeValue(labelCounts));
+        else if (name == "Jaccard")
+          values.push_back(JaccardMetricType::ComputeValue(labelCounts));
+        else if (name == "PPV")
+          values.push_back(PPVMetricType::ComputeValue(labelCounts));
+        else if (name == "Sensitivity")
+          values.push_back(SensitivityMetricType::ComputeValue(labelCounts));
+        else
+          values.push_back(SpecificityMetricType::ComputeValue(labelCounts));
+      }
+      writeJSONLabelValues(outputfile, name, labels, values);
+    }
+
+    if (m+1 < metrics.size())
+      outputfile << ",";
+    outputfile << std::endl;
+  }
+
+  outputfile << "}" << std::endl;
+
+  outputfile.close();
+
+  return 0;
+
+}
+
+// Forward declaration required by CLIHelperFunctions
+template <class TPixel, unsigned int VDimension>
+int DoIt(int argc, char* argv[]);
+
+#include "covalicCLIHelperFunctions.h"
+
+// Both images are read with the pixel type of the file that can hold the
+// labels of both, two dimensional images as volumes of one slice
+template <class TPixel, unsigned int VDimension>
+int
+DoIt(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  return validateImageAll<TPixel>(
+    inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str(),
+    metrics, weighting, groundTruthCache, numberOfThreads);
+}
+
+int
+main(int argc, char** argv)
+{
+  PARSE_ARGS;
+
+  try
+  {
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::ostringstream parameters;
+    parameters << "metrics";
+    for (unsigned int i = 0; i < metrics.size(); i++)
+      parameters << " " << metrics[i];
+    parameters << " weighting " << weighting;
+    std::string key = cache->GetKey(
+      inputVolume1, inputVolume2, "ValidateImageAll", parameters.str());
+    return cache->FindOrCompute(key, outputFile,
+      covalic::CallDoItWithWidestImage(inputVolume1, inputVolume2, argc, argv));
+  }
+  catch (itk::ExceptionObject& e)
+  {
+    std::cerr << e << std::endl;
+    return -1;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return -1;
+  }
+  catch (std::string& s)
+  {
+    std::cerr << "Exception: " << s << std::endl;
+    return -1;
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown exception" << std::endl;
+    return -1;
+  }
+
+  return 0;
+
+
+}
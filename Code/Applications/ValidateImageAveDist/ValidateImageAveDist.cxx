@@ -1,11 +1,15 @@
 
 #include "AverageDistanceImageToImageMetric.h"
+#include "GroundTruthCache.h"
 #include "MultipleBinaryImageMetricsCalculator.h"
 
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "MappedImageFileReader.h"
+
+#include "ResultCache.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -16,27 +20,29 @@
 #include "ValidateImageAveDistCLP.h"
 
 
+template <class TPixel>
 int
-validateImageAveDist(const char* fn1, const char* fn2, const char* outFile)
+validateImageAveDist(const char* fn1, const char* fn2, const char* outFile,
+  const std::string& cacheDir)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
-  typedef itk::Image<unsigned short, 3> ImageType;
+  typedef itk::Image<TPixel, 3> ImageType;
 
-  typedef itk::ImageFileReader<ImageType> ReaderType;
+  typedef MappedImageFileReader<ImageType> ReaderType;
 
-  ImageType::Pointer truthImg;
+  typename ImageType::Pointer truthImg;
   {
-    ReaderType::Pointer reader = ReaderType::New();
+    typename ReaderType::Pointer reader = ReaderType::New();
     reader->SetFileName(fn1);
     reader->Update();
     truthImg = reader->GetOutput();
   }
 
-  ImageType::Pointer testImg;
+  typename ImageType::Pointer testImg;
   {
-    ReaderType::Pointer reader = ReaderType::New();
+    typename ReaderType::Pointer reader = ReaderType::New();
     reader->SetFileName(fn2);
     reader->Update();
     testImg = reader->GetOutput();
@@ -56,12 +62,33 @@ validateImageAveDist(const char* fn1, const char* fn2, const char* outFile)
 
   typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, AveDistMetricType>
     AveDistCalculatorType;
-  AveDistCalculatorType::Pointer calc = AveDistCalculatorType::New();
+  typename AveDistCalculatorType::Pointer calc = AveDistCalculatorType::New();
   calc->SetFixedImage(truthImg);
   calc->SetMovingImage(testImg);
+
+  // Ground truth boundaries and distance maps from the cache directory, or
+  // computed and stored there for the next run against the same truth
+  if (!cacheDir.empty())
+  {
+    typedef typename AveDistCalculatorType::SurfaceDistanceCacheType
+      SurfaceDistanceCacheType;
+    typename SurfaceDistanceCacheType::Pointer distanceCache =
+      SurfaceDistanceCacheType::New();
+    distanceCache->CropToBoundingBoxOn();
+
+    typedef GroundTruthCache<ImageType> GroundTruthCacheType;
+    typename GroundTruthCacheType::Pointer truthCache =
+      GroundTruthCacheType::New();
+    truthCache->SetDirectory(cacheDir);
+    truthCache->SetSurfaceDistanceCache(distanceCache);
+    truthCache->Load(truthImg);
+
+    calc->SetSurfaceDistanceCache(distanceCache);
+  }
+
   calc->Update();
   for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-    outputfile << "AveDist(" << "A_" << i+1 << ", B_" << i+1 << ") = " << calc->GetValue(i) << std::endl;
+    outputfile << "AveDist(" << "A_" << calc->GetLabel(i) << ", B_" << calc->GetLabel(i) << ") = " << calc->GetValue(i) << std::endl;
 
   outputfile.close();
 
@@ -69,6 +96,25 @@ validateImageAveDist(const char* fn1, const char* fn2, const char* outFile)
 
 }
 
+// Forward declaration required by CLIHelperFunctions
+template <class TPixel, unsigned int VDimension>
+int DoIt(int argc, char* argv[]);
+
+#include "covalicCLIHelperFunctions.h"
+
+// Both images are read with the pixel type of the file that can hold the
+// labels of both, two dimensional images as volumes of one slice
+template <class TPixel, unsigned int VDimension>
+int
+DoIt(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  return validateImageAveDist<TPixel>(
+    inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str(),
+    groundTruthCache);
+}
+
 int
 main(int argc, char** argv)
 {
@@ -76,8 +122,13 @@ main(int argc, char** argv)
 
   try
   {
-    validateImageAveDist(
-      inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str());
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::string key = cache->GetKey(
+      inputVolume1, inputVolume2, "ValidateImageAveDist", "");
+    return cache->FindOrCompute(key, outputFile,
+      covalic::CallDoItWithWidestImage(inputVolume1, inputVolume2, argc, argv));
   } 
   catch (itk::ExceptionObject& e)
   {
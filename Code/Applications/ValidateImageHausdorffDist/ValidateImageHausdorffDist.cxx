@@ -1,11 +1,15 @@
 
 #include "HausdorffDistanceImageToImageMetric.h"
+#include "GroundTruthCache.h"
 #include "MultipleBinaryImageMetricsCalculator.h"
 
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "MappedImageFileReader.h"
+
+#include "ResultCache.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -16,27 +20,29 @@
 #include "ValidateImageHausdorffDistCLP.h"
 
 
+template <class TPixel>
 int
-validateImageHausdorffDist(const char* fn1, const char* fn2, const char* outFile)
+validateImageHausdorffDist(const char* fn1, const char* fn2, const char* outFile,
+  const std::string& cacheDir)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
-  typedef itk::Image<unsigned short, 3> ImageType;
+  typedef itk::Image<TPixel, 3> ImageType;
 
-  typedef itk::ImageFileReader<ImageType> ReaderType;
+  typedef MappedImageFileReader<ImageType> ReaderType;
 
-  ImageType::Pointer truthImg;
+  typename ImageType::Pointer truthImg;
   {
-    ReaderType::Pointer reader = ReaderType::New();
+    typename ReaderType::Pointer reader = ReaderType::New();
     reader->SetFileName(fn1);
     reader->Update();
     truthImg = reader->GetOutput();
   }
 
-  ImageType::Pointer testImg;
+  typename ImageType::Pointer testImg;
   {
-    ReaderType::Pointer reader = ReaderType::New();
+    typename ReaderType::Pointer reader = ReaderType::New();
     reader->SetFileName(fn2);
     reader->Update();
     testImg = reader->GetOutput();
@@ -56,12 +62,33 @@ validateImageHausdorffDist(const char* fn1, const char* fn2, const char* outFile
 
   typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, HausdorffDistMetricType>
     HausdorffDistCalculatorType;
-  HausdorffDistCalculatorType::Pointer calc = HausdorffDistCalculatorType::New();
+  typename HausdorffDistCalculatorType::Pointer calc = HausdorffDistCalculatorType::New();
   calc->SetFixedImage(truthImg);
   calc->SetMovingImage(testImg);
+
+  // Ground truth boundaries and distance maps from the cache directory, or
+  // computed and stored there for the next run against the same truth
+  if (!cacheDir.empty())
+  {
+    typedef typename HausdorffDistCalculatorType::SurfaceDistanceCacheType
+      SurfaceDistanceCacheType;
+    typename SurfaceDistanceCacheType::Pointer distanceCache =
+      SurfaceDistanceCacheType::New();
+    distanceCache->CropToBoundingBoxOn();
+
+    typedef GroundTruthCache<ImageType> GroundTruthCacheType;
+    typename GroundTruthCacheType::Pointer truthCache =
+      GroundTruthCacheType::New();
+    truthCache->SetDirectory(cacheDir);
+    truthCache->SetSurfaceDistanceCache(distanceCache);
+    truthCache->Load(truthImg);
+
+    calc->SetSurfaceDistanceCache(distanceCache);
+  }
+
   calc->Update();
   for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-    outputfile << "HausdorffDist(" << "A_" << i+1 << ", B_" << i+1 << ") = " << calc->GetValue(i) << std::endl;
+    outputfile << "HausdorffDist(" << "A_" << calc->GetLabel(i) << ", B_" << calc->GetLabel(i) << ") = " << calc->GetValue(i) << std::endl;
 
   outputfile.close();
 
@@ -69,6 +96,25 @@ validateImageHausdorffDist(const char* fn1, const char* fn2, const char* outFile
 
 }
 
+// Forward declaration required by CLIHelperFunctions
+template <class TPixel, unsigned int VDimension>
+int DoIt(int argc, char* argv[]);
+
+#include "covalicCLIHelperFunctions.h"
+
+// Both images are read with the pixel type of the file that can hold the
+// labels of both, two dimensional images as volumes of one slice
+template <class TPixel, unsigned int VDimension>
+int
+DoIt(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  return validateImageHausdorffDist<TPixel>(
+    inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str(),
+    groundTruthCache);
+}
+
 int
 main(int argc, char** argv)
 {
@@ -76,8 +122,13 @@ main(int argc, char** argv)
 
   try
   {
-    validateImageHausdorffDist(
-      inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str());
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::string key = cache->GetKey(
+      inputVolume1, inputVolume2, "ValidateImageHausdorffDist", "");
+    return cache->FindOrCompute(key, outputFile,
+      covalic::CallDoItWithWidestImage(inputVolume1, inputVolume2, argc, argv));
   } 
   catch (itk::ExceptionObject& e)
   {
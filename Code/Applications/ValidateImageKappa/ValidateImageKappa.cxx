@@ -1,10 +1,13 @@
 
 #include "CohenKappaImageToImageMetric.h"
+#include "ImagePairSlabReader.h"
+#include "LabelConfusionCounter.h"
 
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "ResultCache.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -15,47 +18,80 @@
 #include "ValidateImageKappaCLP.h"
 
 
+template <class TPixel>
 int
-validateImageKappa(const char* fn1, const char* fn2, const char* outFile)
+validateImageKappa(const char* fn1, const char* fn2, const char* outFile,
+  const std::string& weighting, int numThreads, int memoryLimit)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
-  typedef itk::Image<unsigned char, 3> ByteImageType;
-
-  typedef itk::ImageFileReader<ByteImageType> ReaderType;
+  typedef itk::Image<TPixel, 3> ImageType;
 
-  ByteImageType::Pointer Amask;
-  {
-    ReaderType::Pointer reader = ReaderType::New();
-    reader->SetFileName(fn1);
-    reader->Update();
-    Amask = reader->GetOutput();
-  }
+  typedef CohenKappaImageToImageMetric<ImageType, ImageType>
+    CohenKappaMetricType;
 
-  ByteImageType::Pointer Bmask;
+  typename CohenKappaMetricType::WeightingType weightingType =
+    CohenKappaMetricType::Unweighted;
+  if (weighting == "linear")
+    weightingType = CohenKappaMetricType::LinearWeights;
+  else if (weighting == "quadratic")
+    weightingType = CohenKappaMetricType::QuadraticWeights;
+
+  // Images are read in slabs that fit the memory limit, in MB, and the
+  // confusion table is accumulated over the slabs
+  typedef ImagePairSlabReader<ImageType, ImageType> SlabReaderType;
+  typename SlabReaderType::Pointer slabReader = SlabReaderType::New();
+  slabReader->SetFixedFileName(fn1);
+  slabReader->SetMovingFileName(fn2);
+  if (memoryLimit > 0)
+    slabReader->SetMemoryLimit((itk::SizeValueType)memoryLimit << 20);
+  slabReader->Initialize();
+
+  typedef LabelConfusionCounter<ImageType, ImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->AccumulateOn();
+  if (numThreads > 0)
+    counter->SetNumberOfThreads(numThreads);
+
+  for (unsigned int slab = 0; slab < slabReader->GetNumberOfSlabs(); slab++)
   {
-    ReaderType::Pointer reader = ReaderType::New();
-    reader->SetFileName(fn2);
-    reader->Update();
-    Bmask = reader->GetOutput();
+    slabReader->ReadSlab(slab);
+    counter->SetFixedImage(slabReader->GetFixedImage());
+    counter->SetMovingImage(slabReader->GetMovingImage());
+    counter->Compute();
   }
 
-  typedef CohenKappaImageToImageMetric<ByteImageType, ByteImageType>
-    CohenKappaMetricType;
-  CohenKappaMetricType::Pointer kappaMetric = CohenKappaMetricType::New();
-  kappaMetric->SetFixedImage(Amask);
-  kappaMetric->SetMovingImage(Bmask);
-
   std::ofstream outputfile;
   outputfile.open(outFile, std::ios::out);
-  outputfile << "Kappa(A,B) = " <<  kappaMetric->GetValue() << std::endl;
+  outputfile << "Kappa(A,B) = " <<
+    CohenKappaMetricType::ComputeValue(counter->GetCounts(), false, weightingType)
+    << std::endl;
   outputfile.close();
 
   return 0;
 
 }
 
+// Forward declaration required by CLIHelperFunctions
+template <class TPixel, unsigned int VDimension>
+int DoIt(int argc, char* argv[]);
+
+#include "covalicCLIHelperFunctions.h"
+
+// Both images are read with the pixel type of the file that can hold the
+// labels of both, two dimensional images as volumes of one slice
+template <class TPixel, unsigned int VDimension>
+int
+DoIt(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  return validateImageKappa<TPixel>(
+    inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str(),
+    weighting, numberOfThreads, memoryLimit);
+}
+
 int
 main(int argc, char** argv)
 {
@@ -63,8 +99,14 @@ main(int argc, char** argv)
 
   try
   {
-    validateImageKappa(
-      inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str());
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::string parameters = "weighting " + weighting;
+    std::string key = cache->GetKey(
+      inputVolume1, inputVolume2, "ValidateImageKappa", parameters);
+    return cache->FindOrCompute(key, outputFile,
+      covalic::CallDoItWithWidestImage(inputVolume1, inputVolume2, argc, argv));
   } 
   catch (itk::ExceptionObject& e)
   {
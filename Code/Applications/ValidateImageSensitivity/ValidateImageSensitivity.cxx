@@ -1,11 +1,12 @@
 
-#include "SensitivityImageToImageMetric.h"
-#include "MultipleBinaryImageMetricsCalculator.h"
+#include "ImagePairSlabReader.h"
+#include "MultipleLabelOverlapCalculator.h"
 
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "ResultCache.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -16,46 +17,48 @@
 #include "ValidateImageSensitivityCLP.h"
 
 
+template <class TPixel>
 int
-validateImageSensitivity(const char* fn1, const char* fn2, const char* outFile)
+validateImageSensitivity(
+  const char* fn1, const char* fn2, const char* outFile, int numThreads,
+  int memoryLimit)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
-  typedef itk::Image<unsigned short, 3> ImageType;
+  typedef itk::Image<TPixel, 3> ImageType;
 
-  typedef itk::ImageFileReader<ImageType> ReaderType;
-
-  ImageType::Pointer truthImg;
-  {
-    ReaderType::Pointer reader = ReaderType::New();
-    reader->SetFileName(fn1);
-    reader->Update();
-    truthImg = reader->GetOutput();
-  }
-
-  ImageType::Pointer testImg;
-  {
-    ReaderType::Pointer reader = ReaderType::New();
-    reader->SetFileName(fn2);
-    reader->Update();
-    testImg = reader->GetOutput();
-  }
+  // Images are read in slabs that fit the memory limit, in MB
+  typedef ImagePairSlabReader<ImageType, ImageType> SlabReaderType;
+  typename SlabReaderType::Pointer slabReader = SlabReaderType::New();
+  slabReader->SetFixedFileName(fn1);
+  slabReader->SetMovingFileName(fn2);
+  if (memoryLimit > 0)
+    slabReader->SetMemoryLimit((itk::SizeValueType)memoryLimit << 20);
+  slabReader->Initialize();
 
   std::ofstream outputfile;
   outputfile.open(outFile, std::ios::out);
 
-  typedef SensitivityImageToImageMetric<ImageType, ImageType>
-    SensitivityMetricType;
+  // All labels are scored from one pass over both images, with counts
+  // accumulated over the slabs
+  typedef MultipleLabelOverlapCalculator<ImageType, ImageType>
+    OverlapCalculatorType;
+  typename OverlapCalculatorType::Pointer calc = OverlapCalculatorType::New();
+  calc->AccumulateOn();
+  if (numThreads > 0)
+    calc->SetNumberOfThreads(numThreads);
+
+  for (unsigned int slab = 0; slab < slabReader->GetNumberOfSlabs(); slab++)
+  {
+    slabReader->ReadSlab(slab);
+    calc->SetFixedImage(slabReader->GetFixedImage());
+    calc->SetMovingImage(slabReader->GetMovingImage());
+    calc->Update();
+  }
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, SensitivityMetricType>
-    SensitivityCalculatorType;
-  SensitivityCalculatorType::Pointer calc = SensitivityCalculatorType::New();
-  calc->SetFixedImage(truthImg);
-  calc->SetMovingImage(testImg);
-  calc->Update();
   for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-    outputfile << "Sensitivity(" << "A_" << i+1 << ", B_" << i+1 << ") = " << calc->GetValue(i) << std::endl;
+    outputfile << "Sensitivity(" << "A_" << calc->GetLabel(i) << ", B_" << calc->GetLabel(i) << ") = " << calc->GetSensitivity(i) << std::endl;
 
   outputfile.close();
 
@@ -63,6 +66,25 @@ validateImageSensitivity(const char* fn1, const char* fn2, const char* outFile)
 
 }
 
+// Forward declaration required by CLIHelperFunctions
+template <class TPixel, unsigned int VDimension>
+int DoIt(int argc, char* argv[]);
+
+#include "covalicCLIHelperFunctions.h"
+
+// Both images are read with the pixel type of the file that can hold the
+// labels of both, two dimensional images as volumes of one slice
+template <class TPixel, unsigned int VDimension>
+int
+DoIt(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  return validateImageSensitivity<TPixel>(
+    inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str(),
+    numberOfThreads, memoryLimit);
+}
+
 int
 main(int argc, char** argv)
 {
@@ -70,8 +92,13 @@ main(int argc, char** argv)
 
   try
   {
-    validateImageSensitivity(
-      inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str());
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::string key = cache->GetKey(
+      inputVolume1, inputVolume2, "ValidateImageSensitivity", "");
+    return cache->FindOrCompute(key, outputFile,
+      covalic::CallDoItWithWidestImage(inputVolume1, inputVolume2, argc, argv));
   } 
   catch (itk::ExceptionObject& e)
   {
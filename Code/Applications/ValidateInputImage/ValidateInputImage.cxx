@@ -3,9 +3,10 @@
 #include "MultipleBinaryImageMetricsCalculator.h"
 
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "MappedImageFileReader.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -16,27 +17,28 @@
 #include "ValidateInputImageCLP.h"
 
 
+template <class TPixel>
 int
 validateInputImage(const char* fn1, const char* fn2, const char* outFile)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
-  typedef itk::Image<unsigned short, 3> ImageType;
+  typedef itk::Image<TPixel, 3> ImageType;
 
-  typedef itk::ImageFileReader<ImageType> ReaderType;
+  typedef MappedImageFileReader<ImageType> ReaderType;
 
-  ImageType::Pointer truthImg;
+  typename ImageType::Pointer truthImg;
   {
-    ReaderType::Pointer reader = ReaderType::New();
+    typename ReaderType::Pointer reader = ReaderType::New();
     reader->SetFileName(fn1);
     reader->Update();
     truthImg = reader->GetOutput();
   }
 
-  ImageType::Pointer testImg;
+  typename ImageType::Pointer testImg;
   {
-    ReaderType::Pointer reader = ReaderType::New();
+    typename ReaderType::Pointer reader = ReaderType::New();
     reader->SetFileName(fn2);
     reader->Update();
     testImg = reader->GetOutput();
@@ -48,7 +50,7 @@ validateInputImage(const char* fn1, const char* fn2, const char* outFile)
   typedef ImageToImageValidator<ImageType, ImageType>
     ImageValidatorType;
 
-  ImageValidatorType::Pointer checker = ImageValidatorType::New();
+  typename ImageValidatorType::Pointer checker = ImageValidatorType::New();
   checker->SetFixedImage(truthImg);
   checker->SetMovingImage(testImg);
 
@@ -62,6 +64,27 @@ validateInputImage(const char* fn1, const char* fn2, const char* outFile)
 
 }
 
+// Forward declaration required by CLIHelperFunctions
+template <class TPixel, unsigned int VDimension>
+int DoIt(int argc, char* argv[]);
+
+#include "covalicCLIHelperFunctions.h"
+
+// Both images are read with the pixel type of the file that can hold the
+// labels of both, two dimensional images as volumes of one slice
+template <class TPixel, unsigned int VDimension>
+int
+DoIt(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  // The domain check is reported in the output file, not the exit code
+  validateInputImage<TPixel>(
+    inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str());
+
+  return EXIT_SUCCESS;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -69,8 +92,8 @@ main(int argc, char** argv)
 
   try
   {
-    validateInputImage(
-      inputVolume1.c_str(), inputVolume2.c_str(), outputFile.c_str());
+    return covalic::ParseArgsAndCallDoIt(
+      covalic::GetWidestImage(inputVolume1, inputVolume2), argc, argv);
   } 
   catch (itk::ExceptionObject& e)
   {
@@ -5,6 +5,8 @@
 #include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "ResultCache.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -13,6 +15,7 @@
 
 #include <exception>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include "ValidateSurfaceCurrentsCLP.h"
@@ -22,7 +25,9 @@
 
 int
 validateSurfaceCurrents(
-  const char* fn1, const char* fn2, double h, const char* outFile)
+  const char* fn1, const char* fn2, double h, const char* outFile,
+  bool particleMesh, double particleMeshResolution,
+  bool fastKernelSum, int numThreads)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
@@ -35,6 +40,14 @@ validateSurfaceCurrents(
   currMetric->SetFixedSurface(surf1);
   currMetric->SetMovingSurface(surf2);
   currMetric->SetKernelWidth(h);
+  if (particleMesh)
+  {
+    currMetric->UseParticleMeshApproximation();
+    currMetric->SetParticleMeshResolution(particleMeshResolution);
+  }
+  currMetric->SetFastKernelSum(fastKernelSum);
+  if (numThreads > 0)
+    currMetric->SetNumberOfThreads(numThreads);
 
 
   std::ofstream outputfile;
@@ -47,6 +60,23 @@ validateSurfaceCurrents(
 
 }
 
+// Computes the metric from the command line, for ResultCache::FindOrCompute
+struct ComputeSurfaceCurrents
+{
+  int argc;
+  char** argv;
+
+  int operator()() const
+  {
+    PARSE_ARGS;
+
+    return validateSurfaceCurrents(
+      inputSurface1.c_str(), inputSurface2.c_str(), kernelWidth,
+      outputFile.c_str(), particleMesh, particleMeshResolution,
+      fastKernelSum, numberOfThreads);
+  }
+};
+
 int
 main(int argc, char** argv)
 {
@@ -54,9 +84,20 @@ main(int argc, char** argv)
 
   try
   {
-    validateSurfaceCurrents(
-      inputSurface1.c_str(), inputSurface2.c_str(), kernelWidth,
-      outputFile.c_str());
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::ostringstream parameters;
+    parameters.precision(17);
+    parameters << "kernelWidth " << kernelWidth
+      << " particleMesh " << particleMesh;
+    if (particleMesh)
+      parameters << " particleMeshResolution " << particleMeshResolution;
+    parameters << " fastKernelSum " << fastKernelSum;
+    std::string key = cache->GetKey(
+      inputSurface1, inputSurface2, "ValidateSurfaceCurrents", parameters.str());
+    ComputeSurfaceCurrents compute = { argc, argv };
+    return cache->FindOrCompute(key, outputFile, compute);
   } 
   catch (itk::ExceptionObject& e)
   {
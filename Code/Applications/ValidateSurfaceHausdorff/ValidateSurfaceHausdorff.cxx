@@ -5,6 +5,8 @@
 #include "itkImageFileReader.h"
 #include "itkImageRegionIteratorWithIndex.h"
 
+#include "ResultCache.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
@@ -13,6 +15,7 @@
 
 #include <exception>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include "ValidateSurfaceHausdorffCLP.h"
@@ -22,7 +25,8 @@
 
 int
 validateSurfaceHausdorff(
-  const char* fn1, const char* fn2, const char* outFile)
+  const char* fn1, const char* fn2, const char* outFile,
+  bool pointToTriangle, int numThreads)
 {
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
@@ -34,6 +38,9 @@ validateSurfaceHausdorff(
   HausdorffDistanceSurfaceToSurfaceMetric::Pointer haussdMetric = HausdorffDistanceSurfaceToSurfaceMetric::New();
   haussdMetric->SetFixedSurface(surf1);
   haussdMetric->SetMovingSurface(surf2);
+  haussdMetric->SetPointToTriangleDistance(pointToTriangle);
+  if (numThreads > 0)
+    haussdMetric->SetNumberOfThreads(numThreads);
 
   std::ofstream outputfile;
   outputfile.open(outFile, std::ios::out);
@@ -44,6 +51,22 @@ validateSurfaceHausdorff(
 
 }
 
+// Computes the metric from the command line, for ResultCache::FindOrCompute
+struct ComputeSurfaceHausdorff
+{
+  int argc;
+  char** argv;
+
+  int operator()() const
+  {
+    PARSE_ARGS;
+
+    return validateSurfaceHausdorff(
+      inputSurface1.c_str(), inputSurface2.c_str(),
+      outputFile.c_str(), pointToTriangle, numberOfThreads);
+  }
+};
+
 int
 main(int argc, char** argv)
 {
@@ -51,9 +74,15 @@ main(int argc, char** argv)
 
   try
   {
-    validateSurfaceHausdorff(
-      inputSurface1.c_str(), inputSurface2.c_str(),
-      outputFile.c_str());
+    // Unchanged inputs scored before with the same parameters are looked up
+    ResultCache::Pointer cache = ResultCache::New();
+    cache->SetDirectory(resultCache);
+    std::ostringstream parameters;
+    parameters << "pointToTriangle " << pointToTriangle;
+    std::string key = cache->GetKey(
+      inputSurface1, inputSurface2, "ValidateSurfaceHausdorff", parameters.str());
+    ComputeSurfaceHausdorff compute = { argc, argv };
+    return cache->FindOrCompute(key, outputFile, compute);
   } 
   catch (itk::ExceptionObject& e)
   {
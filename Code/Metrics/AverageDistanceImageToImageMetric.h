@@ -2,12 +2,16 @@
 // Average boundary distances, given two binary image masks
 //
 // Both fixed and moving images should have the same unsigned type
+//
+// Boundaries and distance maps come from a SurfaceDistanceCache, pass a
+// shared cache and a label to evaluate label images without recomputing them
 // Only handles 3D images
 
 #ifndef _AverageDistanceImageToImageMetric_h
 #define _AverageDistanceImageToImageMetric_h
 
 #include "AbstractValidationMetric.h"
+#include "SurfaceDistanceCache.h"
 
 #include "itkImageToImageMetric.h"
 
@@ -53,6 +57,15 @@ public:
   typedef typename TFixedImage::SizeType FixedImageSizeType;
   typedef typename TFixedImage::SpacingType FixedImageSpacingType;
 
+  typedef SurfaceDistanceCache<TFixedImage> SurfaceDistanceCacheType;
+  typedef typename SurfaceDistanceCacheType::Pointer SurfaceDistanceCachePointer;
+
+  // Label 0 (default) compares all nonzero voxels
+  void SetLabel(FixedImagePixelType label) { m_Label = label; }
+
+  void SetSurfaceDistanceCache(SurfaceDistanceCacheType* cache)
+  { m_SurfaceDistanceCache = cache; }
+
   MeasureType GetValue() const;
 
   MeasureType GetValue(const TransformParametersType& p) const
@@ -73,12 +86,17 @@ protected:
   AverageDistanceImageToImageMetric();
   ~AverageDistanceImageToImageMetric();
 
-  double ComputeNonSymmetricDistance(const FixedImageType*, const MovingImageType*) const;
+  double ComputeNonSymmetricDistance(SurfaceDistanceCacheType* cache,
+    const FixedImageType*, const FixedImageType*) const;
 
 private:
 
   bool m_DoBlurring;
 
+  FixedImagePixelType m_Label;
+
+  SurfaceDistanceCachePointer m_SurfaceDistanceCache;
+
 };
 
 #ifndef MU_MANUAL_INSTANTIATION
@@ -2,25 +2,20 @@
 #ifndef _AverageDistanceImageToImageMetric_txx
 #define _AverageDistanceImageToImageMetric_txx
 
-#include "itkBSplineInterpolateImageFunction.h"
-#include "itkDiscreteGaussianImageFilter.h"
-#include "itkImageRegionConstIteratorWithIndex.h"
-#include "itkLinearInterpolateImageFunction.h"
-#include "itkSignedMaurerDistanceMapImageFilter.h"
-
-#include "itkBinaryBallStructuringElement.h"
-#include "itkMorphologicalGradientImageFilter.h"
-
 #include "vnl/vnl_math.h"
 
 #include "AverageDistanceImageToImageMetric.h"
 
+#include <vector>
+
 
 template <class TFixedImage, class TMovingImage>
 AverageDistanceImageToImageMetric<TFixedImage, TMovingImage>
 ::AverageDistanceImageToImageMetric()
 {
   m_DoBlurring = false;
+
+  m_Label = 0;
 }
 
 template <class TFixedImage, class TMovingImage>
@@ -33,106 +28,20 @@ AverageDistanceImageToImageMetric<TFixedImage, TMovingImage>
 template <class TFixedImage, class TMovingImage>
 double
 AverageDistanceImageToImageMetric<TFixedImage, TMovingImage>
-::ComputeNonSymmetricDistance(
-  const TFixedImage* img1, const TMovingImage* img2) const
+::ComputeNonSymmetricDistance(SurfaceDistanceCacheType* cache,
+  const TFixedImage* img1, const TFixedImage* img2) const
 {
-  typedef itk::Image<float, FixedImageType::ImageDimension> FloatImageType;
-
-  typedef itk::SignedMaurerDistanceMapImageFilter<
-    FixedImageType, FloatImageType> DistanceMapFilterType;
-
-  typedef itk::DiscreteGaussianImageFilter<
-    FloatImageType, FloatImageType> BlurFilterType;
-
-  // Compute distance transform
-  typename FloatImageType::Pointer distMap2;
-  {
-    typename DistanceMapFilterType::Pointer distanceMapFilter =
-      DistanceMapFilterType::New();
-
-    distanceMapFilter->InsideIsPositiveOff();
-    distanceMapFilter->SetInput(img2);
-    distanceMapFilter->SquaredDistanceOff();
-    distanceMapFilter->UseImageSpacingOn();
-
-    distanceMapFilter->Update();
-
-    if (!m_DoBlurring)
-    {
-      distMap2 = distanceMapFilter->GetOutput();
-    }
-    else
-    {
-      typename FloatImageType::SpacingType spacing = img1->GetSpacing();
-
-      double minSpacing = spacing[0];
-      for (unsigned int dim = 0; dim < FixedImageType::ImageDimension; dim++)
-        if (spacing[dim] < minSpacing)
-          minSpacing = spacing[dim];
-
-      typename BlurFilterType::Pointer blurf = BlurFilterType::New();
-      blurf->SetInput(distanceMapFilter->GetOutput());
-      blurf->SetVariance(1.5 * minSpacing);
-      blurf->Update();
-
-      distMap2 = blurf->GetOutput();
-    }
-  }
-
-  //typedef itk::LinearInterpolateImageFunction<FloatImageType, double>
-  typedef itk::BSplineInterpolateImageFunction<FloatImageType, double>
-    InterpolatorType;
-  typename InterpolatorType::Pointer distInterp2 = InterpolatorType::New();
-  distInterp2->SetInputImage(distMap2);
-  distInterp2->SetSplineOrder(3);
-
-  // Detect boundary via morphological gradient
-  typedef itk::BinaryBallStructuringElement<FixedImagePixelType, TFixedImage::ImageDimension>
-    StructElementType;
-  typedef
-    itk::MorphologicalGradientImageFilter<FixedImageType, FixedImageType,
-      StructElementType> EdgeFilterType;
+  std::vector<double> distances;
+  cache->ComputeBoundaryDistances(img1, img2, m_Label, m_DoBlurring, distances);
 
-  StructElementType structel;
-  structel.SetRadius(1);
-  structel.CreateStructuringElement();
-
-  typename EdgeFilterType::Pointer edgef = EdgeFilterType::New();
-  edgef->SetInput(img1);
-  edgef->SetKernel(structel);
-  edgef->Update();
-
-  FixedImagePointer edgeImg1 = edgef->GetOutput();
-
-  double sumD = 0;
-  double numV = 0;
-
-  typedef itk::ImageRegionConstIteratorWithIndex<FixedImageType>
-    FixedIteratorType;
-  FixedIteratorType it(edgeImg1, edgeImg1->GetLargestPossibleRegion());
-
-  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
-  {
-    FixedImageIndexType ind = it.GetIndex();
-
-    if (it.Get() == 0 || img1->GetPixel(ind) == 0)
-      continue;
-
-    FixedImagePointType p;
-    img1->TransformIndexToPhysicalPoint(ind, p);
-
-    if (!distInterp2->IsInsideBuffer(p))
-      continue;
-
-    sumD += vnl_math_abs(distInterp2->Evaluate(p));
-    numV += 1.0;
-  }
-
-  if (numV == 0)
+  if (distances.size() == 0)
     return vnl_huge_val(1.0);
 
+  double sumD = 0;
+  for (unsigned int i = 0; i < distances.size(); i++)
+    sumD += distances[i];
 
-  return sumD / numV;
+  return sumD / distances.size();
 
 }
 
@@ -144,34 +53,36 @@ AverageDistanceImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Handle special case where inputs are zeros
-  typedef itk::ImageRegionConstIteratorWithIndex<FixedImageType>
-    FixedIteratorType;
-  FixedIteratorType it(Superclass::m_FixedImage, Superclass::m_FixedImage->GetLargestPossibleRegion());
-
-  double sumFixed = 0;
-  double sumMoving = 0;
-  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  // Without a shared cache the boundaries and distance maps are only reused
+  // within this call
+  SurfaceDistanceCachePointer cache = m_SurfaceDistanceCache;
+  if (cache.IsNull())
   {
-    sumFixed += it.Get();
-    sumMoving += Superclass::m_MovingImage->GetPixel(it.GetIndex());
+    cache = SurfaceDistanceCacheType::New();
+    cache->SetNumberOfThreads(this->GetNumberOfThreads());
   }
 
-  if (sumFixed == 0 || sumMoving == 0)
+  // Handle special case where inputs are zeros
+  itk::SizeValueType numFixed =
+    cache->GetNumberOfVoxels(Superclass::m_FixedImage, m_Label);
+  itk::SizeValueType numMoving =
+    cache->GetNumberOfVoxels(Superclass::m_MovingImage, m_Label);
+
+  if (numFixed == 0 || numMoving == 0)
   {
-    if (sumFixed == sumMoving)
+    if (numFixed == numMoving)
       return 0.0;
     else
       return vnl_huge_val(1.0);
   }
 
-  double d12 = this->ComputeNonSymmetricDistance(
+  double d12 = this->ComputeNonSymmetricDistance(cache,
     Superclass::m_FixedImage, Superclass::m_MovingImage);
 
   if (vnl_math_isinf(d12))
     return vnl_huge_val(1.0);
 
-  double d21 = this->ComputeNonSymmetricDistance(
+  double d21 = this->ComputeNonSymmetricDistance(cache,
     Superclass::m_MovingImage, Superclass::m_FixedImage);
 
   if (vnl_math_isinf(d21))
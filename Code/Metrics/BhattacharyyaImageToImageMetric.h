@@ -1,6 +1,10 @@
 
 // Bhattacharyya  metric for two probability density (vector) images
 // Vectors in each pixel must sum to one and each element in [0, 1]
+//
+// Inputs must be VectorImages. The sum runs over image rows on multiple
+// threads (see ProbabilityImagePairSum), and the inputs are checked to be
+// densities in the same pass.
 
 #ifndef _BhattacharyyaImageToImageMetric_h
 #define _BhattacharyyaImageToImageMetric_h
@@ -8,6 +12,8 @@
 #include "itkImageToImageMetric.h"
 #include "itkSmartPointer.h"
 
+#include <cmath>
+
 template <class TFixedImage, class TMovingImage>
 class ITK_EXPORT BhattacharyyaImageToImageMetric :
   public itk::ImageToImageMetric<TFixedImage, TMovingImage>
@@ -32,20 +38,27 @@ public:
     itk::ImageToImageMetric);
 
   typedef typename Superclass::MeasureType MeasureType;
+  typedef typename Superclass::TransformParametersType TransformParametersType;
+  typedef typename Superclass::DerivativeType DerivativeType;
 
   void SetEpsilon(MeasureType e) { m_Epsilon = e; }
   MeasureType GetEpsilon() const { return m_Epsilon; }
 
+  /** Largest allowed difference between a voxel's component sum and one. */
+  itkSetMacro(NormalizationTolerance, double);
+  itkGetConstMacro(NormalizationTolerance, double);
+
   /**  Get the value for single valued optimizers. */
   MeasureType GetValue() const;
 
-  MeasureType GetValue(const itk::Array<double>& p) const
+  MeasureType GetValue(const TransformParametersType& p) const
   { // TODO: apply transform with nearest neighbor interpolation
     return this->GetValue(); }
 
-  MeasureType GetDerivative(const itk::Array<double>& p) const
-  { itkExceptionMacro(<< "Not implemented"); return 0; }
-  virtual void GetDerivative(const itk::Array<double>& p, itk::Array<double>& q) const
+  void GetDerivative(const TransformParametersType& p, DerivativeType& dp) const
+  { itkExceptionMacro(<< "Not implemented"); }
+
+  void GetValueAndDerivative(const TransformParametersType& p, MeasureType& v, DerivativeType& dp) const
   { itkExceptionMacro(<< "Not implemented"); }
 
 protected:
@@ -53,8 +66,25 @@ protected:
   BhattacharyyaImageToImageMetric();
   virtual ~BhattacharyyaImageToImageMetric();
 
+  // Sums sqrt(pa * pb)
+  struct KernelType
+  {
+    double Evaluate(double* pa, double* pb, unsigned int n) const
+    {
+      for (int i = 0; i < (int)n; i++)
+        pa[i] = std::sqrt(pa[i] * pb[i]);
+
+      double sum = 0;
+      for (unsigned int i = 0; i < n; i++)
+        sum += pa[i];
+      return sum;
+    }
+  };
+
   MeasureType m_Epsilon;
 
+  double m_NormalizationTolerance;
+
 // TODO: transform member, default to identity
 
 };
@@ -1,17 +1,17 @@
 
 #ifndef _BhattacharyyaImageToImageMetric_txx
+#define _BhattacharyyaImageToImageMetric_txx
 
 #include "BhattacharyyaImageToImageMetric.h"
 
-#include "itkImageRegionIterator.h"
-
-#include <cmath>
+#include "ProbabilityImagePairSum.h"
 
 template <class TFixedImage, class TMovingImage>
 BhattacharyyaImageToImageMetric<TFixedImage, TMovingImage>
 ::BhattacharyyaImageToImageMetric()
 {
-
+  m_Epsilon = 1e-8;
+  m_NormalizationTolerance = 1e-4;
 }
 
 template <class TFixedImage, class TMovingImage>
@@ -29,38 +29,24 @@ BhattacharyyaImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Define iterators
-  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
-  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
-
-  FixedIteratorType fixedIt(Superclass::m_FixedImage, Superclass::m_FixedImage->GetRequestedRegion());
-  MovingIteratorType movingIt(Superclass::m_MovingImage, Superclass::m_MovingImage->GetRequestedRegion());
-
-  typename FixedImageType::VectorLengthType numComponents =
-    Superclass::m_FixedImage->GetVectorLength();
-
-  // Get the Bhattacharyya overlap for the two pdf images
-  MeasureType bMetric = 0;
-
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
-  {
-    FixedImagePixelType pa = fixedIt.Get();
-    FixedImagePixelType pb = movingIt.Get();
-
-    for (unsigned int c = 0; c < numComponents; c++)
-    {
-      double pa_c = pa[c];
-      double pb_c = pb[c];
-      bMetric += sqrt(pa_c * pb_c);
-    }
-  
-    ++fixedIt;
-    ++movingIt;
-  }
-
-  return bMetric;
+  // Get the Bhattacharyya overlap for the two pdf images, and check that
+  // inputs are pdfs (each voxel sums to one)
+  typedef ProbabilityImagePairSum<FixedImageType, MovingImageType, KernelType>
+    SumType;
+  typename SumType::Pointer bSum = SumType::New();
+  bSum->SetFixedImage(Superclass::m_FixedImage);
+  bSum->SetMovingImage(Superclass::m_MovingImage);
+  bSum->SetKernel(KernelType());
+  bSum->SetNormalizationTolerance(m_NormalizationTolerance);
+  bSum->SetNumberOfThreads(this->GetNumberOfThreads());
+  bSum->Compute();
+
+  if (!bSum->GetFixedIsDensity())
+    itkExceptionMacro(<< "Fixed image is not a probability density image");
+  if (!bSum->GetMovingIsDensity())
+    itkExceptionMacro(<< "Moving image is not a probability density image");
+
+  return bSum->GetSum();
 }
 
 #endif
@@ -0,0 +1,78 @@
+// Counts true/false positives and negatives between two binary images
+// (nonzero is foreground), fixed image denotes truth
+//
+// The requested region is split across threads with ITK's region splitter,
+// each thread fills its own partial counts and these are summed at the end
+
+#ifndef _BinaryOverlapCounter_h
+#define _BinaryOverlapCounter_h
+
+#include "BinaryOverlapCounts.h"
+#include "ImageRegionPairSplitter.h"
+
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include <vector>
+
+template <class TFixedImage, class TMovingImage>
+class BinaryOverlapCounter: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef BinaryOverlapCounter                               Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  typedef TFixedImage FixedImageType;
+  typedef TMovingImage MovingImageType;
+
+  typedef typename FixedImageType::RegionType FixedRegionType;
+  typedef typename MovingImageType::RegionType MovingRegionType;
+
+  typedef ImageRegionPairSplitter<FixedImageType::ImageDimension> SplitterType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(BinaryOverlapCounter, itk::Object);
+
+  void SetFixedImage(const FixedImageType* img) { m_FixedImage = img; }
+  void SetMovingImage(const MovingImageType* img) { m_MovingImage = img; }
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  void Compute();
+
+  const BinaryOverlapCounts& GetCounts() const { return m_Counts; }
+
+protected:
+
+  BinaryOverlapCounter();
+  ~BinaryOverlapCounter();
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedCompute(unsigned int threadId, unsigned int numThreads);
+
+  typename FixedImageType::ConstPointer m_FixedImage;
+  typename MovingImageType::ConstPointer m_MovingImage;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  BinaryOverlapCounts m_Counts;
+
+  std::vector<BinaryOverlapCounts> m_ThreadCounts;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "BinaryOverlapCounter.txx"
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+
+#ifndef _BinaryOverlapCounter_txx
+#define _BinaryOverlapCounter_txx
+
+#include "BinaryOverlapCounter.h"
+
+#include "itkImageRegionConstIterator.h"
+
+template <class TFixedImage, class TMovingImage>
+BinaryOverlapCounter<TFixedImage, TMovingImage>
+::BinaryOverlapCounter()
+{
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+template <class TFixedImage, class TMovingImage>
+BinaryOverlapCounter<TFixedImage, TMovingImage>
+::~BinaryOverlapCounter()
+{
+
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+BinaryOverlapCounter<TFixedImage, TMovingImage>
+::Compute()
+{
+  if (m_FixedImage.IsNull() || m_MovingImage.IsNull())
+    itkExceptionMacro(<< "Need two input classification images");
+
+  // Regions of different size are walked in lockstep on a single thread
+  unsigned int numThreads = SplitterType::GetNumberOfSplits(
+    m_FixedImage->GetRequestedRegion(), m_MovingImage->GetRequestedRegion(),
+    m_NumberOfThreads);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+
+  m_ThreadCounts.clear();
+  m_ThreadCounts.resize(threader->GetNumberOfThreads());
+
+  threader->SingleMethodExecute();
+
+  // Reduce partial counts in thread order
+  m_Counts.Clear();
+  for (unsigned int t = 0; t < m_ThreadCounts.size(); t++)
+    m_Counts += m_ThreadCounts[t];
+}
+
+template <class TFixedImage, class TMovingImage>
+ITK_THREAD_RETURN_TYPE
+BinaryOverlapCounter<TFixedImage, TMovingImage>
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedCompute(info->ThreadID, info->NumberOfThreads);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+BinaryOverlapCounter<TFixedImage, TMovingImage>
+::ThreadedCompute(unsigned int threadId, unsigned int numThreads)
+{
+  FixedRegionType fixedRegion = m_FixedImage->GetRequestedRegion();
+  MovingRegionType movingRegion = m_MovingImage->GetRequestedRegion();
+
+  if (!SplitterType::GetSplit(threadId, numThreads, fixedRegion, movingRegion))
+    return;
+
+  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
+  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+
+  FixedIteratorType fixedIt(m_FixedImage, fixedRegion);
+  MovingIteratorType movingIt(m_MovingImage, movingRegion);
+
+  BinaryOverlapCounts counts;
+
+  fixedIt.GoToBegin();
+  movingIt.GoToBegin();
+  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
+  {
+    bool a = ((unsigned int)fixedIt.Get() != 0);
+    bool b = ((unsigned int)movingIt.Get() != 0);
+
+    if (a && b)
+      counts.TruePositives++;
+    else if (a)
+      counts.FalseNegatives++;
+    else if (b)
+      counts.FalsePositives++;
+    else
+      counts.TrueNegatives++;
+
+    ++fixedIt;
+    ++movingIt;
+  }
+
+  m_ThreadCounts[threadId] = counts;
+}
+
+#endif
@@ -0,0 +1,51 @@
+// Voxel counts for comparing a binary test mask against a binary truth mask
+//
+// Overlap metrics (Dice, Jaccard, sensitivity, specificity, PPV) are all
+// functions of these four numbers, so they can be computed once and shared.
+// Counts are 64 bit on every platform, volumes can exceed 4G voxels.
+
+#ifndef _BinaryOverlapCounts_h
+#define _BinaryOverlapCounts_h
+
+#include "itkIntTypes.h"
+
+struct BinaryOverlapCounts
+{
+  typedef itk::uint64_t CountType;
+
+  CountType TruePositives;
+  CountType FalsePositives;
+  CountType FalseNegatives;
+  CountType TrueNegatives;
+
+  BinaryOverlapCounts()
+  {
+    this->Clear();
+  }
+
+  void Clear()
+  {
+    TruePositives = 0;
+    FalsePositives = 0;
+    FalseNegatives = 0;
+    TrueNegatives = 0;
+  }
+
+  BinaryOverlapCounts& operator+=(const BinaryOverlapCounts& other)
+  {
+    TruePositives += other.TruePositives;
+    FalsePositives += other.FalsePositives;
+    FalseNegatives += other.FalseNegatives;
+    TrueNegatives += other.TrueNegatives;
+    return *this;
+  }
+
+  // Number of voxels in truth (A) and test (B) masks
+  CountType GetFixedCount() const { return TruePositives + FalseNegatives; }
+  CountType GetMovingCount() const { return TruePositives + FalsePositives; }
+
+  CountType GetTotalCount() const
+  { return TruePositives + FalsePositives + FalseNegatives + TrueNegatives; }
+};
+
+#endif
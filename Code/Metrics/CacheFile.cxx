@@ -0,0 +1,79 @@
+
+#include "CacheFile.h"
+
+#include "itkMutexLockHolder.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include "itksys/MD5.h"
+
+#include <cstdio>
+#include <sstream>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Numbers the temporary files of the threads of a process
+itk::SimpleFastMutexLock TemporaryFileCountLock;
+unsigned long TemporaryFileCount = 0;
+
+}
+
+std::string
+CacheFile
+::ComputeStringHash(const std::string& s)
+{
+  char hex[33];
+
+  itksysMD5* md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+  itksysMD5_Append(md5, (const unsigned char*)s.c_str(), (int)s.size());
+  itksysMD5_FinalizeHex(md5, hex);
+  itksysMD5_Delete(md5);
+
+  hex[32] = 0;
+  return std::string(hex);
+}
+
+std::string
+CacheFile
+::GetTemporaryFileName(const std::string& fn)
+{
+  unsigned long count;
+  {
+    itk::MutexLockHolder<itk::SimpleFastMutexLock> holder(
+      TemporaryFileCountLock);
+    count = TemporaryFileCount++;
+  }
+
+#ifdef _WIN32
+  long pid = (long)_getpid();
+#else
+  long pid = (long)getpid();
+#endif
+
+  std::ostringstream oss;
+  oss << fn << ".tmp" << pid << "_" << count;
+  return oss.str();
+}
+
+bool
+CacheFile
+::Replace(const std::string& tmpfn, const std::string& fn)
+{
+  if (std::rename(tmpfn.c_str(), fn.c_str()) == 0)
+    return true;
+
+  // Renaming over an existing file fails on some systems
+  std::remove(fn.c_str());
+  if (std::rename(tmpfn.c_str(), fn.c_str()) == 0)
+    return true;
+
+  std::remove(tmpfn.c_str());
+  return false;
+}
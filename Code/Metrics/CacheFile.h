@@ -0,0 +1,32 @@
+// Helpers shared by the caches kept on disk (GroundTruthCache, ResultCache)
+//
+// Cache files are named after the MD5 hash of a text key. They are written
+// under a temporary name unique to the process and the call, then renamed
+// into place, so threads and runs sharing a directory never see a partly
+// written file.
+
+#ifndef _CacheFile_h
+#define _CacheFile_h
+
+#include <string>
+
+class CacheFile
+{
+
+public:
+
+  /** MD5 of a string, as 32 hex digits. */
+  static std::string ComputeStringHash(const std::string& s);
+
+  /** Name to write the contents of a cache file under before renaming. */
+  static std::string GetTemporaryFileName(const std::string& fn);
+
+  /**
+   * Renames the temporary file to the cache file, replacing any existing
+   * one. The temporary file is removed and false returned if it fails.
+   */
+  static bool Replace(const std::string& tmpfn, const std::string& fn);
+
+};
+
+#endif
@@ -1,7 +1,8 @@
 
 #include "ClosestDistanceSurfaceToSurfaceMetric.h"
+#include "ClosestPointDistanceCalculator.h"
 
-#include <cmath>
+#include <vector>
 
 #include "vnl/vnl_math.h"
 
@@ -9,7 +10,7 @@ void
 ClosestDistanceSurfaceToSurfaceMetric
 ::SetFixedSurface(vtkPolyData* pd)
 {
-  SurfaceToSurfaceMetric::m_FixedSurface = pd;
+  Superclass::SetFixedSurface(pd);
 
   m_FixedPointLocator = vtkSmartPointer<vtkKdTreePointLocator>::New();
   m_FixedPointLocator->SetDataSet(pd);
@@ -32,25 +33,20 @@ ClosestDistanceSurfaceToSurfaceMetric
       return vnl_huge_val(1.0);
   }
 
-  double sumDist = 0;
-  for (vtkIdType i = 0; i < movingPts->GetNumberOfPoints(); i++)
-  {
-    double x[3];
-    movingPts->GetPoint(i, x);
-
-    vtkIdType fixedId = m_FixedPointLocator->FindClosestPoint(x);    
+  std::vector<double> distances;
 
-    double y[3];
-    fixedPts->GetPoint(fixedId, y);
+  ClosestPointDistanceCalculator::Pointer calc =
+    ClosestPointDistanceCalculator::New();
+  calc->SetNumberOfThreads(m_NumberOfThreads);
+  if (m_PointToTriangleDistance)
+    calc->AddQuery(movingPts, this->GetFixedTriangles(), &distances);
+  else
+    calc->AddQuery(movingPts, fixedPts, m_FixedPointLocator, &distances);
+  calc->Compute();
 
-    double dist_i = 0;
-    for (int j = 0; j < 3; j++)
-    {
-      double d = x[j] - y[j];
-      dist_i += d*d;
-    }
-    sumDist += sqrt(dist_i);
-  }
+  double sumDist = 0;
+  for (unsigned int i = 0; i < distances.size(); i++)
+    sumDist += distances[i];
 
   return sumDist / movingPts->GetNumberOfPoints();
-};
+}
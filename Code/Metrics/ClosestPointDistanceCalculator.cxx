@@ -0,0 +1,167 @@
+
+#include "ClosestPointDistanceCalculator.h"
+
+#include <cmath>
+
+ClosestPointDistanceCalculator
+::ClosestPointDistanceCalculator()
+{
+  m_TotalNumberOfPoints = 0;
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+ClosestPointDistanceCalculator
+::~ClosestPointDistanceCalculator()
+{
+
+}
+
+void
+ClosestPointDistanceCalculator
+::AddQuery(vtkPoints* pts, vtkPoints* targetPts,
+  vtkAbstractPointLocator* locator, std::vector<double>* distances)
+{
+  QueryType q;
+  q.Points = pts;
+  q.TargetPoints = targetPts;
+  q.Locator = locator;
+  q.Triangles = 0;
+  q.Distances = distances;
+
+  m_Queries.push_back(q);
+}
+
+void
+ClosestPointDistanceCalculator
+::AddQuery(vtkPoints* pts, const TriangleBVH* bvh,
+  std::vector<double>* distances)
+{
+  QueryType q;
+  q.Points = pts;
+  q.TargetPoints = 0;
+  q.Locator = 0;
+  q.Triangles = bvh;
+  q.Distances = distances;
+
+  m_Queries.push_back(q);
+}
+
+void
+ClosestPointDistanceCalculator
+::ClearQueries()
+{
+  m_Queries.clear();
+  m_QueryOffsets.clear();
+  m_TotalNumberOfPoints = 0;
+}
+
+void
+ClosestPointDistanceCalculator
+::Compute()
+{
+  m_QueryOffsets.clear();
+  m_TotalNumberOfPoints = 0;
+
+  for (unsigned int k = 0; k < m_Queries.size(); k++)
+  {
+    QueryType& q = m_Queries[k];
+
+    bool hasTarget =
+      (q.Triangles != 0) || (q.TargetPoints != 0 && q.Locator != 0);
+    if (q.Points == 0 || q.Distances == 0 || !hasTarget)
+      itkExceptionMacro(<< "Incomplete closest point query");
+
+    m_QueryOffsets.push_back(m_TotalNumberOfPoints);
+    m_TotalNumberOfPoints += q.Points->GetNumberOfPoints();
+
+    q.Distances->resize(q.Points->GetNumberOfPoints());
+
+    // Any lazy locator build happens here, not in the threads
+    if (q.Locator != 0)
+      q.Locator->BuildLocator();
+  }
+
+  if (m_TotalNumberOfPoints == 0)
+    return;
+
+  unsigned int numThreads = m_NumberOfThreads;
+  if (numThreads < 1)
+    numThreads = 1;
+  if ((vtkIdType)numThreads > m_TotalNumberOfPoints)
+    numThreads = m_TotalNumberOfPoints;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+  threader->SingleMethodExecute();
+}
+
+ITK_THREAD_RETURN_TYPE
+ClosestPointDistanceCalculator
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedCompute(info->ThreadID, info->NumberOfThreads);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void
+ClosestPointDistanceCalculator
+::ThreadedCompute(unsigned int threadId, unsigned int numThreads)
+{
+  // Contiguous slice of the combined point range
+  vtkIdType first = (m_TotalNumberOfPoints * threadId) / numThreads;
+  vtkIdType last = (m_TotalNumberOfPoints * (threadId+1)) / numThreads;
+
+  for (unsigned int k = 0; k < m_Queries.size(); k++)
+  {
+    const QueryType& q = m_Queries[k];
+
+    vtkIdType begin = m_QueryOffsets[k];
+    vtkIdType end = begin + q.Points->GetNumberOfPoints();
+
+    if (end <= first || begin >= last)
+      continue;
+
+    vtkIdType i0 = (first > begin) ? first - begin : 0;
+    vtkIdType i1 = (last < end) ? last - begin : end - begin;
+
+    std::vector<double>& distances = *q.Distances;
+
+    if (q.Triangles != 0)
+    {
+      for (vtkIdType i = i0; i < i1; i++)
+      {
+        double x[3];
+        q.Points->GetPoint(i, x);
+
+        distances[i] = q.Triangles->FindClosestDistance(x);
+      }
+      continue;
+    }
+
+    for (vtkIdType i = i0; i < i1; i++)
+    {
+      double x[3];
+      q.Points->GetPoint(i, x);
+
+      vtkIdType targetId = q.Locator->FindClosestPoint(x);
+
+      double y[3];
+      q.TargetPoints->GetPoint(targetId, y);
+
+      double dist_i = 0;
+      for (int j = 0; j < 3; j++)
+      {
+        double d = x[j] - y[j];
+        dist_i += d*d;
+      }
+
+      distances[i] = sqrt(dist_i);
+    }
+  }
+}
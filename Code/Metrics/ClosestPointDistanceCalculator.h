@@ -0,0 +1,92 @@
+// Distances from every point of one or more query point sets to the closest
+// point of a target point set, using prebuilt VTK point locators, or to the
+// closest point on a triangulated surface, using a TriangleBVH
+//
+// All queries are laid end to end and the combined range is split across
+// threads, so both directions of a symmetric metric run concurrently. Each
+// thread writes its own slice of the output vectors, which keeps the results
+// in point order and independent of the number of threads.
+//
+// Queries only read the locators and triangle hierarchies.
+
+#ifndef _ClosestPointDistanceCalculator_h
+#define _ClosestPointDistanceCalculator_h
+
+#include "TriangleBVH.h"
+
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include "vtkAbstractPointLocator.h"
+#include "vtkPoints.h"
+
+#include <vector>
+
+class ClosestPointDistanceCalculator: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef ClosestPointDistanceCalculator                     Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ClosestPointDistanceCalculator, itk::Object);
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  /**
+   * Queue distances from each point in pts to the closest of targetPts,
+   * found with locator, to be stored in distances.
+   */
+  void AddQuery(vtkPoints* pts, vtkPoints* targetPts,
+    vtkAbstractPointLocator* locator, std::vector<double>* distances);
+
+  /**
+   * Queue distances from each point in pts to the closest point on the
+   * triangles in bvh, to be stored in distances.
+   */
+  void AddQuery(vtkPoints* pts, const TriangleBVH* bvh,
+    std::vector<double>* distances);
+
+  void ClearQueries();
+
+  void Compute();
+
+protected:
+
+  ClosestPointDistanceCalculator();
+  ~ClosestPointDistanceCalculator();
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedCompute(unsigned int threadId, unsigned int numThreads);
+
+  struct QueryType
+  {
+    vtkPoints* Points;
+    vtkPoints* TargetPoints;
+    vtkAbstractPointLocator* Locator;
+    const TriangleBVH* Triangles;
+    std::vector<double>* Distances;
+  };
+
+  std::vector<QueryType> m_Queries;
+
+  // Offset of each query in the combined point range
+  std::vector<vtkIdType> m_QueryOffsets;
+
+  vtkIdType m_TotalNumberOfPoints;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+};
+
+#endif
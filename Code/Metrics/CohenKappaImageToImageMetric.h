@@ -5,11 +5,20 @@
 //
 // Label image type must be of unsigned type
 //
+// The confusion table is built in one threaded pass and only holds the
+// label pairs present (see LabelConfusionCounter). Weighted kappa treats
+// labels as ordered categories at their values and penalizes a
+// disagreement between labels a and b by |a-b| (linear) or (a-b)^2
+// (quadratic), so adding or removing a label elsewhere does not change
+// the weight between two others. Label values should therefore be
+// numbered in category order.
+//
 
 #ifndef _CohenKappaImageToImageMetric_h
 #define _CohenKappaImageToImageMetric_h
 
 #include "AbstractValidationMetric.h"
+#include "LabelConfusionCounts.h"
 
 #include "itkImageToImageMetric.h"
 
@@ -46,11 +55,20 @@ public:
   typedef typename Superclass::TransformParametersType TransformParametersType;
   typedef typename Superclass::DerivativeType DerivativeType;
 
+  typedef enum {Unweighted, LinearWeights, QuadraticWeights} WeightingType;
+
   void IgnoreBackgroundOn() { m_IgnoreBackground = true; }
   void IgnoreBackgroundOff() { m_IgnoreBackground = false; }
 
+  itkSetMacro(Weighting, WeightingType);
+  itkGetConstMacro(Weighting, WeightingType);
+
   MeasureType GetValue() const;
 
+  /** Compute kappa from a precomputed confusion table. */
+  static MeasureType ComputeValue(const LabelConfusionCounts& counts,
+    bool ignoreBackground, WeightingType weighting);
+
   MeasureType GetValue(const TransformParametersType& p) const
   { // TODO: apply transform with nearest neighbor interpolation
     return this->GetValue(); }
@@ -66,8 +84,14 @@ protected:
   CohenKappaImageToImageMetric();
   virtual ~CohenKappaImageToImageMetric();
 
+  // Weighted kappa, 1 - observed / expected disagreement
+  static MeasureType ComputeWeightedValue(const LabelConfusionCounts& counts,
+    bool ignoreBackground, WeightingType weighting);
+
   bool m_IgnoreBackground;
 
+  WeightingType m_Weighting;
+
 };
 
 #ifndef ITK_MANUAL_INSTANTIATION
@@ -4,15 +4,16 @@
 
 #include "CohenKappaImageToImageMetric.h"
 
-#include "itkImageRegionConstIterator.h"
+#include "LabelConfusionCounter.h"
 
-#include "vnl/vnl_matrix.h"
+#include <vector>
 
 template <class TFixedImage, class TMovingImage>
 CohenKappaImageToImageMetric<TFixedImage, TMovingImage>
 ::CohenKappaImageToImageMetric()
 {
   m_IgnoreBackground = false;
+  m_Weighting = Unweighted;
 }
 
 template <class TFixedImage, class TMovingImage>
@@ -30,116 +31,177 @@ CohenKappaImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Define iterators
-  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
-  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+  // Count agreements/disagreements between each pair of labels
+  typedef LabelConfusionCounter<FixedImageType, MovingImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->SetFixedImage(Superclass::m_FixedImage);
+  counter->SetMovingImage(Superclass::m_MovingImage);
+  counter->SetNumberOfThreads(this->GetNumberOfThreads());
+  counter->Compute();
 
-  FixedIteratorType fixedIt(Superclass::m_FixedImage, Superclass::m_FixedImage->GetRequestedRegion());
-  MovingIteratorType movingIt(Superclass::m_MovingImage, Superclass::m_MovingImage->GetRequestedRegion());
+  return Self::ComputeValue(counter->GetCounts(), m_IgnoreBackground, m_Weighting);
+}
+
+template <class TFixedImage, class TMovingImage>
+typename CohenKappaImageToImageMetric<TFixedImage, TMovingImage>::MeasureType
+CohenKappaImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeValue(const LabelConfusionCounts& counts,
+  bool ignoreBackground, WeightingType weighting)
+{
+  if (weighting != Unweighted)
+    return Self::ComputeWeightedValue(counts, ignoreBackground, weighting);
 
-  // Count number of labels from max value in both images
-  // also count number of samples
-  unsigned int maxLabel = 0;
-  unsigned int numSamples = 0;
+  typedef LabelConfusionCounts::CountType CountType;
 
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
+  const std::vector<LabelConfusionCounts::EntryType>& entries =
+    counts.GetEntries();
+
+  unsigned int numLabels = counts.GetNumberOfLabels();
+
+  // When ignoring background, voxels that are background in both images are
+  // not samples, and the expected agreement is taken over the foreground
+  // labels with rows and columns restricted to foreground
+  CountType numSamples = 0;
+  CountType sumAgreements = 0;
+
+  std::vector<CountType> firstCounts(numLabels, 0);
+  std::vector<CountType> secondCounts(numLabels, 0);
+
+  for (unsigned int k = 0; k < entries.size(); k++)
   {
-    unsigned int r = (unsigned int)fixedIt.Get();
-    unsigned int c = (unsigned int)movingIt.Get();
+    LabelConfusionCounts::LabelType r = counts.GetLabel(entries[k].Row);
+    LabelConfusionCounts::LabelType c = counts.GetLabel(entries[k].Column);
 
-    if (r > maxLabel)
-        maxLabel = r;
+    if (ignoreBackground && r == 0 && c == 0)
+      continue;
 
-    if (c > maxLabel)
-      maxLabel = c;
+    numSamples += entries[k].Count;
 
-    if (m_IgnoreBackground)
-    {
-      if (r != 0 || c != 0)
-        numSamples++;
-    }
-    else
-    {
-      numSamples++;
-    }
+    if (r == c)
+      sumAgreements += entries[k].Count;
 
-    ++fixedIt;
-    ++movingIt;
+    if (!ignoreBackground || c != 0)
+      firstCounts[entries[k].Row] += entries[k].Count;
+    if (!ignoreBackground || r != 0)
+      secondCounts[entries[k].Column] += entries[k].Count;
   }
 
-  unsigned int numClasses = maxLabel + 1;
-  //unsigned int numClasses = maxLabel;
-  //if (!m_IgnoreBackground)
-  //  numClasses++;
+  double sumEF = 0;
+  for (unsigned int k = 0; k < numLabels; k++)
+  {
+    if (ignoreBackground && counts.GetLabel(k) == 0)
+      continue;
+    sumEF += (double)firstCounts[k] * (double)secondCounts[k];
+  }
+  sumEF /= numSamples;
 
-  // Fill in matrix that counts agreements/disagreements
-  vnl_matrix<unsigned int> countMatrix(numClasses, numClasses, 0);
+  return (sumAgreements - sumEF) / (numSamples - sumEF);
+}
 
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
+template <class TFixedImage, class TMovingImage>
+typename CohenKappaImageToImageMetric<TFixedImage, TMovingImage>::MeasureType
+CohenKappaImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeWeightedValue(const LabelConfusionCounts& counts,
+  bool ignoreBackground, WeightingType weighting)
+{
+  const std::vector<LabelConfusionCounts::EntryType>& entries =
+    counts.GetEntries();
+
+  unsigned int numLabels = counts.GetNumberOfLabels();
+  if (numLabels < 2)
+    return 1.0;
+
+  // Labels are ordered categories at their values, so the weights do not
+  // depend on which other labels happen to be present
+  std::vector<double> values(numLabels);
+  for (unsigned int i = 0; i < numLabels; i++)
+    values[i] = (double)counts.GetLabel(i);
+
+  // Observed disagreement and marginals, without the background pair when
+  // ignoring background
+  double numSamples = 0;
+  double observed = 0;
+
+  std::vector<double> rowSums(numLabels, 0.0);
+  std::vector<double> columnSums(numLabels, 0.0);
+
+  for (unsigned int k = 0; k < entries.size(); k++)
   {
-    unsigned int r = (unsigned int)fixedIt.Get();
-    unsigned int c = (unsigned int)movingIt.Get();
+    unsigned int i = entries[k].Row;
+    unsigned int j = entries[k].Column;
 
-    if (m_IgnoreBackground)
-    {
-      if (r != 0 || c != 0)
-      {
-        //countMatrix(r-1, c-1) += 1;
-        countMatrix(r, c) += 1;
-      }
-    }
-    else
-    {
-      countMatrix(r, c) += 1;
-    }
+    if (ignoreBackground && counts.GetLabel(i) == 0 && counts.GetLabel(j) == 0)
+      continue;
+
+    double n = (double)entries[k].Count;
+    double d = (i > j) ? values[i] - values[j] : values[j] - values[i];
+    if (weighting == QuadraticWeights)
+      d *= d;
 
-    ++fixedIt;
-    ++movingIt;
+    numSamples += n;
+    observed += d * n;
+    rowSums[i] += n;
+    columnSums[j] += n;
   }
 
-  // Process the matrix
-  unsigned int sumAgreements = 0;
-  for (unsigned int k = 0; k < numClasses; k++)
-    sumAgreements += countMatrix(k, k);
+  if (numSamples == 0)
+    return 1.0;
 
-  double sumEF = 0;
-  if (m_IgnoreBackground)
+  // Expected disagreement sum_ij w(i,j) r_i c_j, from running sums over
+  // the columns so it takes time linear in the number of labels
+  double expected = 0;
+
+  if (weighting == QuadraticWeights)
   {
-    for (unsigned int k = 1; k < numClasses; k++)
+    // (a-b)^2 = a^2 - 2ab + b^2
+    double sumR = 0, sumRA = 0, sumRAA = 0;
+    double sumC = 0, sumCB = 0, sumCBB = 0;
+    for (unsigned int i = 0; i < numLabels; i++)
     {
-      unsigned int firstCount = 0;
-      for (unsigned int j = 1; j < numClasses; j++)
-        firstCount += countMatrix(k, j);
-
-      unsigned int secondCount = 0;
-      for (unsigned int j = 1; j < numClasses; j++)
-        secondCount += countMatrix(j, k);
-
-      sumEF += firstCount*secondCount;
+      double v = values[i];
+      sumR += rowSums[i];
+      sumRA += v * rowSums[i];
+      sumRAA += v * v * rowSums[i];
+      sumC += columnSums[i];
+      sumCB += v * columnSums[i];
+      sumCBB += v * v * columnSums[i];
     }
+    expected = sumRAA * sumC - 2.0 * sumRA * sumCB + sumR * sumCBB;
   }
   else
   {
-    for (unsigned int k = 0; k < numClasses; k++)
+    // |a-b| split into the columns of smaller and larger labels, which
+    // come before and after in the sorted label list
+    double totalC = 0, totalCB = 0;
+    for (unsigned int j = 0; j < numLabels; j++)
     {
-      unsigned int firstCount = 0;
-      for (unsigned int j = 0; j < numClasses; j++)
-        firstCount += countMatrix(k, j);
+      totalC += columnSums[j];
+      totalCB += values[j] * columnSums[j];
+    }
 
-      unsigned int secondCount = 0;
-      for (unsigned int j = 0; j < numClasses; j++)
-        secondCount += countMatrix(j, k);
+    double belowC = 0, belowCB = 0;
+    for (unsigned int i = 0; i < numLabels; i++)
+    {
+      double v = values[i];
+      double aboveC = totalC - belowC - columnSums[i];
+      double aboveCB = totalCB - belowCB - v * columnSums[i];
 
-      sumEF += firstCount*secondCount;
+      double dist = (v * belowC - belowCB) + (aboveCB - v * aboveC);
+      expected += rowSums[i] * dist;
+
+      belowC += columnSums[i];
+      belowCB += v * columnSums[i];
     }
   }
-  sumEF /= numSamples;
 
-  return (sumAgreements - sumEF) / (numSamples - sumEF);
+  // Weights are not normalized, their scale cancels in the ratio
+  observed /= numSamples;
+  expected /= numSamples * numSamples;
+
+  if (expected <= 0)
+    return 1.0;
+
+  return 1.0 - observed / expected;
 }
 
 #endif
@@ -1,137 +1,153 @@
 
-#include "itkKdTree.h"
-#include "itkKdTreeGenerator.h"
-#include "itkListSample.h"
-#include "itkVariableLengthVector.h"
-
 #include "vtkPoints.h"
 #include "vtkSmartPointer.h"
 #include "vtkPolyData.h"
-#include "vtkPolyDataReader.h"
-#include "vtkPolyDataWriter.h"
 #include "vtkTriangleFilter.h"
 
-#include "vtkCellData.h"
-#include "vtkDataArray.h"
-#include "vtkFloatArray.h"
-#include "vtkPointData.h"
-#include "vtkSmartPointer.h"
-
 #include "vnl/vnl_math.h"
 
 #include "CurrentsSurfaceToSurfaceMetric.h"
+#include "FastExp.h"
 
+#include <algorithm>
+#include <cmath>
 #include <exception>
 #include <stdexcept>
 
-void
-CurrentsSurfaceToSurfaceMetric
-::SetKernelWidth(double d)
+namespace
 {
-  m_KernelWidth = d;
-}
 
-double
-CurrentsSurfaceToSurfaceMetric
-::GetKernelWidth() const
+// Accumulates the kernel weighted normal products of one query triangle,
+// evaluating the exponentials a batch of neighbors at a time
+struct KernelSumVisitor
 {
-  return m_KernelWidth;
-}
+  static const unsigned int BatchSize = 64;
 
-double
-CurrentsSurfaceToSurfaceMetric
-::ComputeCurrentsNorm(vtkPolyData* polyData) const
-{
-  double var = m_KernelWidth * m_KernelWidth;
+  const double* NX;
+  const double* NY;
+  const double* NZ;
 
-  double truncDist = 3.0*m_KernelWidth;
+  double Normal[3];
+  double Variance;
+  bool UseFastExp;
 
-  vtkSmartPointer<vtkDataArray> normals = polyData->GetCellData()->GetNormals();
+  double Dots[BatchSize];
+  double Args[BatchSize];
+  unsigned int BatchCount;
 
-  // Build kd tree
-  typedef itk::VariableLengthVector<float> VectorType;
-  typedef itk::Statistics::ListSample<VectorType> SampleType;
-  typedef itk::Statistics::KdTree<SampleType> KdTreeType;
-  typedef itk::Statistics::KdTreeGenerator<SampleType> TreeGeneratorType;
+  double Sum;
+  unsigned int Count;
 
-  SampleType::Pointer kdsamples = SampleType::New();
-  kdsamples->SetMeasurementVectorSize(3);
-  kdsamples->Resize(polyData->GetNumberOfCells());
+  void Reset(double nx, double ny, double nz)
+  {
+    Normal[0] = nx;
+    Normal[1] = ny;
+    Normal[2] = nz;
+    BatchCount = 0;
+    Sum = 0;
+    Count = 0;
+  }
 
-  for (vtkIdType i = 0; i < polyData->GetNumberOfCells(); i++)
+  void operator()(unsigned int j, double d2)
   {
-    VectorType c(3);
-    c.Fill(0);
+    Dots[BatchCount] = Normal[0]*NX[j] + Normal[1]*NY[j] + Normal[2]*NZ[j];
+    Args[BatchCount] = -0.5 * d2 / Variance;
+    BatchCount++;
+    Count++;
 
-    vtkIdType nPts = 0;
-    vtkIdType* ptIds = 0;
-    polyData->GetCellPoints(i, nPts, ptIds);
+    if (BatchCount == BatchSize)
+      this->Flush();
+  }
 
-    // Always assume triangles
-    if (nPts != 3)
-      throw std::runtime_error("Non triangle cell detected");
+  // Neighbor outside the truncation radius, where the argument may be out of
+  // range for the fast exp
+  void AddFarNeighbor(unsigned int j, double d2)
+  {
+    this->Flush();
 
-    for (int p = 0; p < 3; p++)
-    {
-      double x[3];
-      polyData->GetPoint(ptIds[p], x);
+    double dotnn = Normal[0]*NX[j] + Normal[1]*NY[j] + Normal[2]*NZ[j];
+    Sum += dotnn * exp(-0.5 * d2 / Variance);
+    Count++;
+  }
 
-      for (int dim = 0; dim < 3; dim++)
-        c[dim] += x[dim];
+  // Adds the batch to the sum in the order the neighbors were visited
+  void Flush()
+  {
+    if (UseFastExp)
+    {
+      FastExp::Evaluate(Args, Args, BatchCount);
+    }
+    else
+    {
+      for (unsigned int k = 0; k < BatchCount; k++)
+        Args[k] = exp(Args[k]);
     }
 
-    c /= 3.0;
+    for (unsigned int k = 0; k < BatchCount; k++)
+      Sum += Dots[k] * Args[k];
 
-    kdsamples->SetMeasurementVector(i, c);
+    BatchCount = 0;
   }
+};
 
-  TreeGeneratorType::Pointer treeGenerator = TreeGeneratorType::New();
 
-  treeGenerator->SetSample(kdsamples);
-  treeGenerator->SetBucketSize(50);
-  treeGenerator->Update();
+// Convolves every line of a grid along one axis with a symmetric kernel,
+// values past the ends of a line are taken as zero
+void
+ConvolveGridAxis(double* data, const unsigned long size[3], unsigned int axis,
+  const std::vector<double>& weights)
+{
+  unsigned long stride = 1;
+  for (unsigned int dim = 0; dim < axis; dim++)
+    stride *= size[dim];
 
-  KdTreeType::Pointer kdtree = treeGenerator->GetOutput();
+  long length = size[axis];
+  unsigned long numLines = (size[0] * size[1] * size[2]) / length;
 
-  // Evaluate with truncation radius = truncDist = 3*sigma
-  double kdnorm = 0.0;
+  long radius = (weights.size() - 1) / 2;
 
-  for (unsigned int i = 0; i < polyData->GetNumberOfCells(); i++)
-  {
-    VectorType ci = kdsamples->GetMeasurementVector(i);
+  std::vector<double> line(length);
 
-    double ni[3];
-    normals->GetTuple(i, ni);
+  for (unsigned long n = 0; n < numLines; n++)
+  {
+    double* start = data + (n / stride) * stride * length + (n % stride);
 
-    KdTreeType::InstanceIdentifierVectorType neighbors;
-    kdtree->Search(ci, truncDist, neighbors);
+    for (long i = 0; i < length; i++)
+      line[i] = start[i*stride];
 
-    for (unsigned int j = 0; j < neighbors.size(); j++)
+    for (long i = 0; i < length; i++)
     {
-      VectorType dvec = kdsamples->GetMeasurementVector(neighbors[j]) - ci;
-
-      double nj[3];
-      normals->GetTuple(neighbors[j], nj);
+      long k0 = (i < radius) ? -i : -radius;
+      long k1 = (length - 1 - i < radius) ? length - 1 - i : radius;
 
-      double dotnn = 0;
-      for (unsigned int d = 0; d < 3; d++)
-        dotnn += ni[d] * nj[d];
+      double sum = 0;
+      for (long k = k0; k <= k1; k++)
+        sum += weights[k + radius] * line[i + k];
 
-      //kdnorm += dot3d(ni, nj) * exp(-0.5 * dvec.GetSquaredNorm() / var);
-      kdnorm += dotnn * exp(-0.5 * dvec.GetSquaredNorm() / var);
+      start[i*stride] = sum;
     }
-
   }
-  kdnorm /=
-    pow(2.0*var*vnl_math::pi, 3.0/2.0) + 1e-20;
+}
 
-  return kdnorm;
+}
+
+void
+CurrentsSurfaceToSurfaceMetric
+::SetKernelWidth(double d)
+{
+  m_KernelWidth = d;
+}
 
+double
+CurrentsSurfaceToSurfaceMetric
+::GetKernelWidth() const
+{
+  return m_KernelWidth;
 }
 
-vtkSmartPointer<vtkPolyData>
+void
 CurrentsSurfaceToSurfaceMetric
-::ComputeWeightedPDNormals(vtkPolyData* polyData) const
+::ComputeTriangleCurrents(vtkPolyData* polyData, TriangleCurrentsType& tc) const
 {
   // Make sure we only have triangles (not strips or polys)
   vtkSmartPointer<vtkTriangleFilter> trif =
@@ -143,20 +159,22 @@ CurrentsSurfaceToSurfaceMetric
 
   vtkSmartPointer<vtkPolyData> triPD = trif->GetOutput();
 
-  triPD->BuildLinks();
+  vtkIdType numCells = triPD->GetNumberOfCells();
 
-  // Compute cross product here
-  vtkSmartPointer<vtkFloatArray> newNormals = vtkFloatArray::New();
-  newNormals->SetNumberOfComponents(3);
-  newNormals->SetNumberOfTuples(triPD->GetNumberOfCells());
-  newNormals->SetName("Normals");
+  tc.CX.resize(numCells);
+  tc.CY.resize(numCells);
+  tc.CZ.resize(numCells);
+  tc.NX.resize(numCells);
+  tc.NY.resize(numCells);
+  tc.NZ.resize(numCells);
 
-  for (vtkIdType i = 0; i < triPD->GetNumberOfCells(); i++)
+  for (vtkIdType i = 0; i < numCells; i++)
   {
     vtkIdType nPts = 0;
     vtkIdType* ptIds = 0;
     triPD->GetCellPoints(i, nPts, ptIds);
 
+    // Always assume triangles
     if (nPts != 3)
       throw std::runtime_error("Non triangle cell detected");
 
@@ -167,186 +185,332 @@ CurrentsSurfaceToSurfaceMetric
     double x2[3];
     triPD->GetPoint(ptIds[2], x2);
 
+    tc.CX[i] = (x0[0] + x1[0] + x2[0]) / 3.0;
+    tc.CY[i] = (x0[1] + x1[1] + x2[1]) / 3.0;
+    tc.CZ[i] = (x0[2] + x1[2] + x2[2]) / 3.0;
+
     for (int d = 0; d < 3; d++)
     {
       x1[d] = x1[d] - x0[d];
       x2[d] = x2[d] - x0[d];
     }
 
-    //vtkScalar
-    double wnormal[3];
-    wnormal[0] = (x1[1] * x2[2] - x1[2] * x2[1]) / 2.0;
-    wnormal[1] = (x1[2] * x2[0] - x1[0] * x2[2]) / 2.0;
-    wnormal[2] = (x1[0] * x2[1] - x1[1] * x2[0]) / 2.0;
-
-    newNormals->SetTuple(i, wnormal);
+    // Normal weighted by triangle area
+    tc.NX[i] = (x1[1] * x2[2] - x1[2] * x2[1]) / 2.0;
+    tc.NY[i] = (x1[2] * x2[0] - x1[0] * x2[2]) / 2.0;
+    tc.NZ[i] = (x1[0] * x2[1] - x1[1] * x2[0]) / 2.0;
   }
-
-  triPD->GetCellData()->SetNormals(newNormals);
-
-  return triPD;
 }
 
+double
+CurrentsSurfaceToSurfaceMetric
+::ComputeKernelSum(const TriangleCurrentsType& a,
+  const TriangleCurrentsType& b, const PointKdTree* treeB,
+  bool nearestFallback) const
+{
+  unsigned int numA = a.CX.size();
+
+  if (numA == 0 || b.CX.size() == 0)
+    return 0.0;
+
+  KernelSumJobType job;
+  job.Metric = this;
+  job.A = &a;
+  job.B = &b;
+  job.TreeB = treeB;
+  job.NearestFallback = nearestFallback;
+  job.BlockSums.resize((numA + KernelSumBlockSize - 1) / KernelSumBlockSize, 0.0);
+
+  unsigned int numThreads = m_NumberOfThreads;
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numThreads > job.BlockSums.size())
+    numThreads = job.BlockSums.size();
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::KernelSumThreaderCallback, &job);
+  threader->SingleMethodExecute();
+
+  double sum = 0;
+  for (unsigned int k = 0; k < job.BlockSums.size(); k++)
+    sum += job.BlockSums[k];
+
+  return sum;
+}
 
-CurrentsSurfaceToSurfaceMetric::MeasureType
+ITK_THREAD_RETURN_TYPE
 CurrentsSurfaceToSurfaceMetric
-::GetValue() const
+::KernelSumThreaderCallback(void* arg)
 {
-  // sum_i sum_j k(c_i, c_j) <n_i, n_j>
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  KernelSumJobType* job = static_cast<KernelSumJobType*>(info->UserData);
+
+  unsigned int numA = job->A->CX.size();
+
+  // Blocks are dealt out round robin, each sum lands in its own slot
+  for (unsigned int k = info->ThreadID; k < job->BlockSums.size();
+    k += info->NumberOfThreads)
+  {
+    unsigned int first = k * KernelSumBlockSize;
+    unsigned int last = std::min(first + KernelSumBlockSize, numA);
 
-//TODO:
-  // if (m_Approximation == ParticleMesh)
-  //   return this->GetValueWithParticleMesh();
+    job->BlockSums[k] = job->Metric->ComputeBlockKernelSum(*job, first, last);
+  }
 
-  // Compute weighted normals
-  vtkSmartPointer<vtkPolyData> polyData1 =
-    this->ComputeWeightedPDNormals(this->GetMovingSurface());
-  vtkSmartPointer<vtkPolyData> polyData2 =
-    this->ComputeWeightedPDNormals(this->GetFixedSurface());
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+double
+CurrentsSurfaceToSurfaceMetric
+::ComputeBlockKernelSum(const KernelSumJobType& job,
+  unsigned int first, unsigned int last) const
+{
+  const TriangleCurrentsType& a = *job.A;
+  const TriangleCurrentsType& b = *job.B;
 
   double var = m_KernelWidth * m_KernelWidth;
 
+  // Evaluate with truncation radius = truncDist = 3*sigma
   double truncDist = 3.0*m_KernelWidth;
 
-  //unsigned int minNeighborCount = polyData1->GetNumberOfCells() / 100 + 1;
-  unsigned int minNeighborCount = 1;
+  KernelSumVisitor visitor;
+  visitor.NX = &b.NX[0];
+  visitor.NY = &b.NY[0];
+  visitor.NZ = &b.NZ[0];
+  visitor.Variance = var;
+  visitor.UseFastExp = m_FastKernelSum;
 
-  // Build kd tree
-  typedef itk::VariableLengthVector<float> VectorType;
-  typedef itk::Statistics::ListSample<VectorType> SampleType;
-  typedef itk::Statistics::KdTree<SampleType> KdTreeType;
-  typedef itk::Statistics::KdTreeGenerator<SampleType> TreeGeneratorType;
+  double sum = 0;
 
-  SampleType::Pointer kdsamples = SampleType::New();
-  kdsamples->SetMeasurementVectorSize(3);
-  kdsamples->Resize(polyData1->GetNumberOfCells());
-
-  // Compute triangle centroids
-  for (vtkIdType i = 0; i < polyData1->GetNumberOfCells(); i++)
+  for (unsigned int i = first; i < last; i++)
   {
-    VectorType c(3);
-    c.Fill(0);
+    double ci[3];
+    ci[0] = a.CX[i];
+    ci[1] = a.CY[i];
+    ci[2] = a.CZ[i];
 
-    vtkIdType nPts = 0;
-    vtkIdType* ptIds = 0;
-    polyData1->GetCellPoints(i, nPts, ptIds);
+    visitor.Reset(a.NX[i], a.NY[i], a.NZ[i]);
 
-    if (nPts != 3)
-      throw std::runtime_error("Non triangle cell detected");
+    job.TreeB->VisitPointsInRadius(ci, truncDist, visitor);
 
-    for (int p = 0; p < 3; p++)
-    {
-      double x[3];
-      polyData1->GetPoint(ptIds[p], x);
+    visitor.Flush();
 
-      for (int dim = 0; dim < 3; dim++)
-        c[dim] += x[dim];
+    if (visitor.Count == 0 && job.NearestFallback)
+    {
+      double d2 = 0;
+      unsigned int j = job.TreeB->FindClosestPoint(ci, d2);
+      visitor.AddFarNeighbor(j, d2);
     }
 
-    c /= 3.0;
-
-    kdsamples->SetMeasurementVector(i, c);
+    sum += visitor.Sum;
   }
 
-  TreeGeneratorType::Pointer treeGenerator = TreeGeneratorType::New();
+  return sum;
+}
 
-  treeGenerator->SetSample(kdsamples);
-  treeGenerator->SetBucketSize(50);
-  treeGenerator->Update();
+double
+CurrentsSurfaceToSurfaceMetric
+::ComputeCurrentsNorm(const TriangleCurrentsType& tc,
+  const PointKdTree* tree) const
+{
+  double var = m_KernelWidth * m_KernelWidth;
 
-  KdTreeType::Pointer kdtree = treeGenerator->GetOutput();
+  double kdnorm = this->ComputeKernelSum(tc, tc, tree, false);
 
-  vtkSmartPointer<vtkDataArray> normals1 =
-    polyData1->GetCellData()->GetNormals();
-  vtkSmartPointer<vtkDataArray> normals2 =
-    polyData2->GetCellData()->GetNormals();
+  kdnorm /=
+    pow(2.0*var*vnl_math::pi, 3.0/2.0) + 1e-20;
 
-  double match = 0;
+  return kdnorm;
+}
 
-  // first match term
-  for (unsigned int i = 0; i < polyData1->GetNumberOfCells(); i++)
-  {
-    VectorType ci = kdsamples->GetMeasurementVector(i);
+CurrentsSurfaceToSurfaceMetric::MeasureType
+CurrentsSurfaceToSurfaceMetric
+::GetValue() const
+{
+  // sum_i sum_j k(c_i, c_j) <n_i, n_j>
 
-    double ni[3];
-    normals1->GetTuple(i, ni);
+  // Triangle centroids and weighted normals
+  TriangleCurrentsType currents1;
+  this->ComputeTriangleCurrents(this->GetMovingSurface(), currents1);
 
-    KdTreeType::InstanceIdentifierVectorType neighbors;
-    kdtree->Search(ci, truncDist, neighbors);
-    if (neighbors.size() < minNeighborCount)
-      kdtree->Search(ci, minNeighborCount, neighbors);
+  TriangleCurrentsType currents2;
+  this->ComputeTriangleCurrents(this->GetFixedSurface(), currents2);
 
-    for (unsigned int j = 0; j < neighbors.size(); j++)
-    {
-      double nj[3];
-      normals1->GetTuple(neighbors[j], nj);
+  if (m_Approximation == ParticleMeshApproximation)
+    return this->ComputeParticleMeshValue(currents1, currents2);
 
-      double dotnn = 0;
-      for (unsigned int d = 0; d < 3; d++)
-        dotnn += ni[d] * nj[d];
+  double var = m_KernelWidth * m_KernelWidth;
 
-      VectorType dvec = ci - kdsamples->GetMeasurementVector(neighbors[j]);
-      //double d = dot3d(ni, nj) * exp(-0.5 * dvec.GetSquaredNorm() / var);
-      double d = dotnn * exp(-0.5 * dvec.GetSquaredNorm() / var);
-      d /=  pow(2.0*var*vnl_math::pi, 3.0/2.0);
+  double normalizer = pow(2.0*var*vnl_math::pi, 3.0/2.0);
 
-      match += d;
-    }
+  // Build kd trees
+  PointKdTree::Pointer tree1 = PointKdTree::New();
+  tree1->Build(currents1.CX, currents1.CY, currents1.CZ);
 
-  }
+  PointKdTree::Pointer tree2 = PointKdTree::New();
+  tree2->Build(currents2.CX, currents2.CY, currents2.CZ);
+
+  double match = 0;
+
+  // first match term, every triangle is within range of itself
+  match += this->ComputeKernelSum(currents1, currents1, tree1, true) / normalizer;
 
   // second match term
-  for (vtkIdType i = 0; i < polyData2->GetNumberOfCells(); i++)
+  match +=
+    -2.0 * this->ComputeKernelSum(currents2, currents1, tree1, true) / normalizer;
+
+  match += this->ComputeCurrentsNorm(currents2, tree2);
+
+  return match;
+}
+
+double
+CurrentsSurfaceToSurfaceMetric
+::ComputeParticleMeshValue(const TriangleCurrentsType& a,
+  const TriangleCurrentsType& b) const
+{
+  if (m_ParticleMeshResolution <= 0.0)
+    itkExceptionMacro(<< "Particle mesh resolution must be positive");
+  if (m_MaximumParticleMeshSize < 8)
+    itkExceptionMacro(<< "Particle mesh size limit below 8 grid points");
+
+  const TriangleCurrentsType* currents[2] = { &a, &b };
+
+  // Grid covers the centroids of both surfaces
+  double minPt[3];
+  double maxPt[3];
+  for (unsigned int dim = 0; dim < 3; dim++)
   {
-    VectorType c_y(3);
-    c_y.Fill(0);
+    minPt[dim] = vnl_huge_val(1.0);
+    maxPt[dim] = -vnl_huge_val(1.0);
+  }
 
-    vtkIdType nPts = 0;
-    vtkIdType* ptIds = 0;
-    polyData2->GetCellPoints(i, nPts, ptIds);
+  for (unsigned int s = 0; s < 2; s++)
+  {
+    const TriangleCurrentsType& tc = *currents[s];
+    const std::vector<double>* coords[3] = { &tc.CX, &tc.CY, &tc.CZ };
+
+    for (unsigned int dim = 0; dim < 3; dim++)
+      for (unsigned int i = 0; i < coords[dim]->size(); i++)
+      {
+        double c = (*coords[dim])[i];
+        if (c < minPt[dim])
+          minPt[dim] = c;
+        if (c > maxPt[dim])
+          maxPt[dim] = c;
+      }
+  }
 
-    if (nPts != 3)
-      throw std::runtime_error("Non triangle cell detected");
+  if (minPt[0] > maxPt[0])
+    return 0.0;
+
+  double spacing = m_KernelWidth / m_ParticleMeshResolution;
+
+  // Splats reach one grid point past the box on each axis. Nothing needs to
+  // be padded for the kernel, as the field is zero outside the grid and the
+  // convolution is only read back where the field is nonzero.
+  unsigned long size[3];
+  unsigned long numGridPoints = 0;
 
-    for (int p = 0; p < 3; p++)
+  while (true)
+  {
+    double count = 1.0;
+    for (unsigned int dim = 0; dim < 3; dim++)
     {
-      double y[3];
-      polyData2->GetPoint(ptIds[p], y);
+      size[dim] = (unsigned long)floor((maxPt[dim] - minPt[dim]) / spacing) + 2;
+      count *= size[dim];
+    }
 
-      for (int dim = 0; dim < 3; dim++)
-        c_y[dim] += y[dim];
+    if (count <= m_MaximumParticleMeshSize)
+    {
+      numGridPoints = (unsigned long)count;
+      break;
     }
 
-    c_y /= 3.0;
+    spacing *= 1.01 * pow(count / m_MaximumParticleMeshSize, 1.0/3.0);
+  }
 
-    double n_y[3];
-    normals2->GetTuple(i, n_y);
+  // Difference of the two currents, one block per normal component, with
+  // each normal spread trilinearly over the surrounding grid points
+  std::vector<double> field(3*numGridPoints, 0.0);
 
-    KdTreeType::InstanceIdentifierVectorType neighbors;
-    kdtree->Search(c_y, truncDist, neighbors);
-    if (neighbors.size() < minNeighborCount)
-      kdtree->Search(c_y, minNeighborCount, neighbors);
+  for (unsigned int s = 0; s < 2; s++)
+  {
+    const TriangleCurrentsType& tc = *currents[s];
+    double sign = (s == 0) ? 1.0 : -1.0;
 
-    for (unsigned int j = 0; j < neighbors.size(); j++)
+    for (unsigned int i = 0; i < tc.CX.size(); i++)
     {
-      double n_x[3];
-      normals1->GetTuple(neighbors[j], n_x);
+      double p[3];
+      p[0] = (tc.CX[i] - minPt[0]) / spacing;
+      p[1] = (tc.CY[i] - minPt[1]) / spacing;
+      p[2] = (tc.CZ[i] - minPt[2]) / spacing;
+
+      unsigned long base[3];
+      double frac[3];
+      for (unsigned int dim = 0; dim < 3; dim++)
+      {
+        double fl = floor(p[dim]);
+        base[dim] = (unsigned long)fl;
+        frac[dim] = p[dim] - fl;
+      }
+
+      for (unsigned int corner = 0; corner < 8; corner++)
+      {
+        double w = sign;
+        unsigned long offset = 0;
+        unsigned long stride = 1;
+        for (unsigned int dim = 0; dim < 3; dim++)
+        {
+          unsigned int bit = (corner >> dim) & 1;
+          w *= bit ? frac[dim] : 1.0 - frac[dim];
+          offset += (base[dim] + bit) * stride;
+          stride *= size[dim];
+        }
+
+        field[offset] += w * tc.NX[i];
+        field[numGridPoints + offset] += w * tc.NY[i];
+        field[2*numGridPoints + offset] += w * tc.NZ[i];
+      }
+    }
+  }
 
-      double dotnn = 0;
-      for (unsigned int d = 0; d < 3; d++)
-        dotnn += n_x[d] * n_y[d];
+  // Kernel sampled on the grid with the same truncation at 3*sigma as the
+  // direct sum, applied along each axis in turn. Splatting and reading back
+  // each blur by a tent of variance spacing^2/6 per axis, so the grid kernel
+  // is narrowed by that much and scaled to keep its integral.
+  double var = m_KernelWidth * m_KernelWidth;
 
-      VectorType dvec = kdsamples->GetMeasurementVector(neighbors[j]) - c_y;
-      //double d = dot3d(n_x, n_y) * exp(-0.5 * dvec.GetSquaredNorm() / var);
-      double d = dotnn * exp(-0.5 * dvec.GetSquaredNorm() / var);
-      d *= -2.0 / pow(2.0*var*vnl_math::pi, 3.0/2.0);
+  double gridVar = var - spacing*spacing / 3.0;
+  if (gridVar < 0.5*var)
+    gridVar = 0.5*var;
 
-      match += d;
-    }
+  double gridScale = sqrt(var / gridVar);
 
+  long radius = (long)floor(3.0*m_KernelWidth / spacing);
+
+  std::vector<double> weights(2*radius + 1);
+  for (long k = -radius; k <= radius; k++)
+  {
+    double x = k * spacing;
+    weights[k + radius] = gridScale * exp(-0.5 * x*x / gridVar);
   }
 
-  match += this->ComputeCurrentsNorm(polyData2);
+  std::vector<double> smoothed(field);
 
-  return match;
+  for (unsigned int comp = 0; comp < 3; comp++)
+    for (unsigned int axis = 0; axis < 3; axis++)
+      ConvolveGridAxis(&smoothed[comp*numGridPoints], size, axis, weights);
+
+  // sum_i sum_j k(c_i, c_j) <n_i, n_j> read back from the grid
+  double sum = 0;
+  for (unsigned long k = 0; k < field.size(); k++)
+    sum += field[k] * smoothed[k];
+
+  double normalizer = pow(2.0*var*vnl_math::pi, 3.0/2.0);
+
+  return sum / normalizer;
 }
@@ -9,10 +9,15 @@
 #ifndef _CurrentsSurfaceToSurfaceMetric_h
 #define _CurrentsSurfaceToSurfaceMetric_h
 
+#include "PointKdTree.h"
 #include "SurfaceToSurfaceMetric.h"
 
+#include "itkMultiThreader.h"
+
 #include "vtkPolyData.h"
 
+#include <vector>
+
 class CurrentsSurfaceToSurfaceMetric: public SurfaceToSurfaceMetric
 {
 public:
@@ -33,13 +38,41 @@ public:
   typedef Superclass::ParametersType ParametersType;
   typedef Superclass::DerivativeType DerivativeType;
 
-//TODO: Accomodate different approximation techniques
-  // void UseParticleMeshApproximation();
-  // void UseKdTreeApproximation();
+  // Kernel sums by truncated direct summation over a kd-tree (default), or
+  // on a particle mesh: normals are splatted onto a regular grid, convolved
+  // with the kernel one axis at a time and read back. The mesh cost depends
+  // on the extent of the surfaces in kernel widths rather than on the number
+  // of neighbors, which makes large kernel widths affordable.
+  typedef enum { KdTreeApproximation, ParticleMeshApproximation } ApproximationType;
+
+  itkSetMacro(Approximation, ApproximationType);
+  itkGetConstMacro(Approximation, ApproximationType);
+
+  void UseKdTreeApproximation()
+  { this->SetApproximation(KdTreeApproximation); }
+  void UseParticleMeshApproximation()
+  { this->SetApproximation(ParticleMeshApproximation); }
+
+  // Particle mesh grid points per kernel width (default 4), higher is more
+  // accurate
+  itkSetMacro(ParticleMeshResolution, double);
+  itkGetConstMacro(ParticleMeshResolution, double);
+
+  // Largest particle mesh in grid points (default 2^23, about 400 MB), the
+  // grid is coarsened below the requested resolution to fit
+  itkSetMacro(MaximumParticleMeshSize, unsigned long);
+  itkGetConstMacro(MaximumParticleMeshSize, unsigned long);
 
   void SetKernelWidth(double d);
   double GetKernelWidth() const;
 
+  // Evaluate the kernel with a vectorized polynomial exp rather than
+  // std::exp (default off). Either way the sums are reduced in a fixed
+  // order, but only the default mode is bit reproducible across builds.
+  itkSetMacro(FastKernelSum, bool);
+  itkGetConstMacro(FastKernelSum, bool);
+  itkBooleanMacro(FastKernelSum);
+
   virtual unsigned int GetNumberOfParameters() const
   { itkExceptionMacro(<< "Not implemented"); return 0; }
 
@@ -53,13 +86,68 @@ protected:
   CurrentsSurfaceToSurfaceMetric()
   {
     m_KernelWidth = 1.0;
+    m_FastKernelSum = false;
+    m_Approximation = KdTreeApproximation;
+    m_ParticleMeshResolution = 4.0;
+    m_MaximumParticleMeshSize = 1ul << 23;
   }
 
-  double ComputeCurrentsNorm(vtkPolyData* pd) const;
+  // Triangle centroids and area weighted normals, one array per coordinate
+  struct TriangleCurrentsType
+  {
+    std::vector<double> CX;
+    std::vector<double> CY;
+    std::vector<double> CZ;
+    std::vector<double> NX;
+    std::vector<double> NY;
+    std::vector<double> NZ;
+  };
+
+  void ComputeTriangleCurrents(vtkPolyData* polyData, TriangleCurrentsType& tc) const;
+
+  // Sum over triangles i of a and j of b, with c_j within the truncation
+  // radius of c_i, of <n_i, n_j> exp(-|c_i - c_j|^2 / (2 var)). Tree is
+  // built over b. With nearestFallback, an i without any j in range uses
+  // its closest j instead.
+  double ComputeKernelSum(const TriangleCurrentsType& a,
+    const TriangleCurrentsType& b, const PointKdTree* treeB,
+    bool nearestFallback) const;
+
+  double ComputeCurrentsNorm(const TriangleCurrentsType& tc,
+    const PointKdTree* tree) const;
+
+  // Query triangles of a are taken in blocks of this size, block sums are
+  // added in block order whatever the number of threads
+  static const unsigned int KernelSumBlockSize = 256;
+
+  struct KernelSumJobType
+  {
+    const Self* Metric;
+    const TriangleCurrentsType* A;
+    const TriangleCurrentsType* B;
+    const PointKdTree* TreeB;
+    bool NearestFallback;
+    std::vector<double> BlockSums;
+  };
+
+  static ITK_THREAD_RETURN_TYPE KernelSumThreaderCallback(void* arg);
+
+  // Kernel sum over the query triangles first to last-1 of job.A
+  double ComputeBlockKernelSum(const KernelSumJobType& job,
+    unsigned int first, unsigned int last) const;
 
-  vtkSmartPointer<vtkPolyData> ComputeWeightedPDNormals(vtkPolyData* polyData) const;
+  // Squared currents norm of the difference of a and b on a particle mesh
+  double ComputeParticleMeshValue(const TriangleCurrentsType& a,
+    const TriangleCurrentsType& b) const;
 
   double m_KernelWidth;
+
+  bool m_FastKernelSum;
+
+  ApproximationType m_Approximation;
+
+  double m_ParticleMeshResolution;
+  unsigned long m_MaximumParticleMeshSize;
 };
 
 #endif
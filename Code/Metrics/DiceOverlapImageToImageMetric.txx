@@ -4,7 +4,7 @@
 
 #include "DiceOverlapImageToImageMetric.h"
 
-#include "itkImageRegionIterator.h"
+#include "BinaryOverlapCounter.h"
 
 template <class TFixedImage, class TMovingImage>
 DiceOverlapImageToImageMetric<TFixedImage, TMovingImage>
@@ -28,45 +28,26 @@ DiceOverlapImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Define iterators
-  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
-  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+  // Get counts of true/false positives and negatives, split over threads
+  typedef BinaryOverlapCounter<FixedImageType, MovingImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->SetFixedImage(Superclass::m_FixedImage);
+  counter->SetMovingImage(Superclass::m_MovingImage);
+  counter->SetNumberOfThreads(this->GetNumberOfThreads());
+  counter->Compute();
 
-  FixedIteratorType fixedIt(Superclass::m_FixedImage, Superclass::m_FixedImage->GetRequestedRegion());
-  MovingIteratorType movingIt(Superclass::m_MovingImage, Superclass::m_MovingImage->GetRequestedRegion());
-
-  // Get intersection and individual set sizes
-  unsigned int numIntersect = 0;
-  unsigned int numA = 0;
-  unsigned int numB = 0;
-
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
-  {
-    unsigned int r = (unsigned int)fixedIt.Get();
-    unsigned int c = (unsigned int)movingIt.Get();
-
-    bool a = (r != 0);
-    bool b = (c != 0);
-      
-    if (a && b)
-      numIntersect++;
-
-    if (a)
-      numA++;
-
-    if (b)
-      numB++;
-  
-    ++fixedIt;
-    ++movingIt;
-  }
+  return Self::ComputeValue(counter->GetCounts());
+}
 
+template <class TFixedImage, class TMovingImage>
+typename DiceOverlapImageToImageMetric<TFixedImage,TMovingImage>::MeasureType
+DiceOverlapImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeValue(const BinaryOverlapCounts& counts)
+{
   // Overlap or similarity coeff is intersect / average
-  double avgSize = (numA + numB) / 2.0 + 1e-20;
+  double avgSize = (counts.GetFixedCount() + counts.GetMovingCount()) / 2.0 + 1e-20;
 
-  return (double)numIntersect / avgSize;
+  return (double)counts.TruePositives / avgSize;
 }
 
 #endif
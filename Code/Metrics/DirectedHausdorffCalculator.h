@@ -0,0 +1,298 @@
+// Exact directed Hausdorff distance between two 3D point sets, max over the
+// query points of the distance to the closest target point
+//
+// Follows Taha and Hanbury (PAMI 2015): query points are visited in a
+// shuffled order and a query stops as soon as a target point closer than the
+// current maximum turns up, since it can no longer raise the maximum. Target
+// points sit in a uniform grid searched in growing shells around the query,
+// so the close points that end most queries are found first. Once the
+// maximum is near its final value almost every query ends after a handful
+// of comparisons.
+//
+// The shuffle uses a fixed seed; the result does not depend on it.
+
+#ifndef _DirectedHausdorffCalculator_h
+#define _DirectedHausdorffCalculator_h
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+class DirectedHausdorffCalculator
+{
+public:
+
+  DirectedHausdorffCalculator()
+  {
+    m_CellSize = 1.0;
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+      m_Origin[dim] = 0.0;
+      m_GridSize[dim] = 0;
+    }
+  }
+
+  // Target points (x[i], y[i], z[i]), bucketed into about one cell per point
+  void SetTargetPoints(const std::vector<double>& x,
+    const std::vector<double>& y, const std::vector<double>& z)
+  {
+    unsigned int numPoints = x.size();
+
+    m_X.clear();
+    m_Y.clear();
+    m_Z.clear();
+    m_CellStarts.clear();
+
+    if (numPoints == 0)
+      return;
+
+    const std::vector<double>* coords[3] = { &x, &y, &z };
+
+    double minPt[3];
+    double maxPt[3];
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+      minPt[dim] = (*coords[dim])[0];
+      maxPt[dim] = (*coords[dim])[0];
+      for (unsigned int i = 1; i < numPoints; i++)
+      {
+        double c = (*coords[dim])[i];
+        if (c < minPt[dim])
+          minPt[dim] = c;
+        if (c > maxPt[dim])
+          maxPt[dim] = c;
+      }
+    }
+
+    // Boundary points lie on a surface, so size cells from the area of the
+    // box faces rather than its volume
+    double area = 0;
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+      double a = maxPt[(dim+1) % 3] - minPt[(dim+1) % 3];
+      double b = maxPt[(dim+2) % 3] - minPt[(dim+2) % 3];
+      area += a * b;
+    }
+
+    m_CellSize = std::sqrt(area / numPoints);
+    if (!(m_CellSize > 0.0))
+      m_CellSize = 1.0;
+
+    // Grow the cells if they would greatly outnumber the points
+    unsigned long numCells = 0;
+    while (true)
+    {
+      double count = 1.0;
+      for (unsigned int dim = 0; dim < 3; dim++)
+      {
+        m_Origin[dim] = minPt[dim];
+        m_GridSize[dim] =
+          (unsigned int)std::floor((maxPt[dim] - minPt[dim]) / m_CellSize) + 1;
+        count *= m_GridSize[dim];
+      }
+
+      if (count <= 8.0 * numPoints)
+      {
+        numCells = (unsigned long)count;
+        break;
+      }
+
+      m_CellSize *= 1.25;
+    }
+
+    // Counting sort of the points by cell
+    std::vector<unsigned long> cellOfPoint(numPoints);
+    m_CellStarts.assign(numCells + 1, 0);
+
+    for (unsigned int i = 0; i < numPoints; i++)
+    {
+      double p[3] = { x[i], y[i], z[i] };
+      cellOfPoint[i] = this->GetCellId(p);
+      m_CellStarts[cellOfPoint[i] + 1]++;
+    }
+
+    for (unsigned long c = 0; c < numCells; c++)
+      m_CellStarts[c + 1] += m_CellStarts[c];
+
+    std::vector<unsigned long> next(m_CellStarts.begin(), m_CellStarts.end() - 1);
+
+    m_X.resize(numPoints);
+    m_Y.resize(numPoints);
+    m_Z.resize(numPoints);
+
+    for (unsigned int i = 0; i < numPoints; i++)
+    {
+      unsigned long k = next[cellOfPoint[i]]++;
+      m_X[k] = x[i];
+      m_Y[k] = y[i];
+      m_Z[k] = z[i];
+    }
+  }
+
+  // Directed distance from the query points to the target points, infinite
+  // if there are no target points and zero if there are no query points
+  double Compute(const std::vector<double>& x, const std::vector<double>& y,
+    const std::vector<double>& z) const
+  {
+    unsigned int numQueries = x.size();
+
+    if (numQueries == 0)
+      return 0.0;
+    if (m_X.size() == 0)
+      return std::numeric_limits<double>::infinity();
+
+    // Fisher-Yates shuffle with a fixed linear congruential generator
+    std::vector<unsigned int> order(numQueries);
+    for (unsigned int i = 0; i < numQueries; i++)
+      order[i] = i;
+
+    unsigned int state = 12345;
+    for (unsigned int i = numQueries - 1; i > 0; i--)
+    {
+      state = state * 1664525u + 1013904223u;
+      unsigned int j = state % (i + 1);
+      unsigned int t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+
+    double max2 = 0;
+
+    for (unsigned int k = 0; k < numQueries; k++)
+    {
+      unsigned int i = order[k];
+      double q[3] = { x[i], y[i], z[i] };
+
+      double min2 = this->FindClosestDistance2(q, max2);
+      if (min2 > max2)
+        max2 = min2;
+    }
+
+    return std::sqrt(max2);
+  }
+
+protected:
+
+  long GetCellCoordinate(double c, unsigned int dim) const
+  {
+    long cell = (long)std::floor((c - m_Origin[dim]) / m_CellSize);
+    if (cell < 0)
+      cell = 0;
+    if (cell >= (long)m_GridSize[dim])
+      cell = m_GridSize[dim] - 1;
+    return cell;
+  }
+
+  unsigned long GetCellId(const double p[3]) const
+  {
+    return GetCellCoordinate(p[0], 0) + m_GridSize[0] *
+      (GetCellCoordinate(p[1], 1) + m_GridSize[1] * GetCellCoordinate(p[2], 2));
+  }
+
+  // Squared distance from q to the closest target point, or to any target
+  // point closer than sqrt(stop2) if one is found first
+  double FindClosestDistance2(const double q[3], double stop2) const
+  {
+    long center[3];
+    for (unsigned int dim = 0; dim < 3; dim++)
+      center[dim] = GetCellCoordinate(q[dim], dim);
+
+    double best2 = std::numeric_limits<double>::infinity();
+
+    for (long r = 0; ; r++)
+    {
+      long lo[3];
+      long hi[3];
+      for (unsigned int dim = 0; dim < 3; dim++)
+      {
+        lo[dim] = center[dim] - r;
+        hi[dim] = center[dim] + r;
+      }
+
+      // Cells on the surface of the block of radius r, clipped to the grid
+      for (long cz = lo[2]; cz <= hi[2]; cz++)
+      {
+        if (cz < 0 || cz >= (long)m_GridSize[2])
+          continue;
+        bool zFace = (cz == lo[2] || cz == hi[2]);
+
+        for (long cy = lo[1]; cy <= hi[1]; cy++)
+        {
+          if (cy < 0 || cy >= (long)m_GridSize[1])
+            continue;
+          bool yFace = zFace || (cy == lo[1] || cy == hi[1]);
+
+          // Inside rows only have the two end cells on the surface
+          long step = yFace ? 1 : hi[0] - lo[0];
+          if (step < 1)
+            step = 1;
+
+          for (long cx = lo[0]; cx <= hi[0]; cx += step)
+          {
+            if (cx < 0 || cx >= (long)m_GridSize[0])
+              continue;
+
+            unsigned long cell = cx + m_GridSize[0] * (cy + m_GridSize[1] * cz);
+
+            for (unsigned long j = m_CellStarts[cell];
+              j < m_CellStarts[cell + 1]; j++)
+            {
+              double dx = m_X[j] - q[0];
+              double dy = m_Y[j] - q[1];
+              double dz = m_Z[j] - q[2];
+              double d2 = dx*dx + dy*dy + dz*dz;
+
+              if (d2 < best2)
+              {
+                best2 = d2;
+                if (best2 < stop2)
+                  return best2;
+              }
+            }
+          }
+        }
+      }
+
+      // Distance from q to the nearest target cell not yet searched
+      bool covered = true;
+      double gap = std::numeric_limits<double>::infinity();
+      for (unsigned int dim = 0; dim < 3; dim++)
+      {
+        if (lo[dim] > 0)
+        {
+          covered = false;
+          double d = q[dim] - (m_Origin[dim] + lo[dim] * m_CellSize);
+          if (d < gap)
+            gap = d;
+        }
+        if (hi[dim] < (long)m_GridSize[dim] - 1)
+        {
+          covered = false;
+          double d = (m_Origin[dim] + (hi[dim] + 1) * m_CellSize) - q[dim];
+          if (d < gap)
+            gap = d;
+        }
+      }
+
+      if (covered)
+        return best2;
+
+      if (gap > 0 && best2 <= gap*gap)
+        return best2;
+    }
+  }
+
+  double m_CellSize;
+  double m_Origin[3];
+  unsigned int m_GridSize[3];
+
+  // Target points grouped by cell, cell c holds m_CellStarts[c] to
+  // m_CellStarts[c+1]-1
+  std::vector<double> m_X;
+  std::vector<double> m_Y;
+  std::vector<double> m_Z;
+  std::vector<unsigned long> m_CellStarts;
+
+};
+
+#endif
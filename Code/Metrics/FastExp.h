@@ -0,0 +1,72 @@
+// Exponential of arrays of doubles without calls into libm
+//
+// Range reduction by ln 2 and a degree 11 polynomial, with the power of two
+// assembled from the bits of the rounded exponent. There are no branches, so
+// the compiler can vectorize the array loop. Relative error is below 1e-14
+// for arguments in [-708, 709]; arguments outside that range are not
+// checked and give garbage.
+
+#ifndef _FastExp_h
+#define _FastExp_h
+
+#include "itkIntTypes.h"
+
+#include <cstring>
+
+namespace FastExp
+{
+
+inline double
+Evaluate(double x)
+{
+  const double log2e = 1.4426950408889634074;
+  const double ln2Hi = 6.93145751953125e-1;
+  const double ln2Lo = 1.42860682030941723212e-6;
+
+  // Adding 1.5 * 2^52 rounds to an integer held in the low mantissa bits
+  const double shifter = 6755399441055744.0;
+
+  double t = x * log2e + shifter;
+  double n = t - shifter;
+
+  // |r| <= ln(2) / 2
+  double r = (x - n*ln2Hi) - n*ln2Lo;
+
+  double p = 1.0 / 39916800.0;
+  p = p*r + 1.0 / 3628800.0;
+  p = p*r + 1.0 / 362880.0;
+  p = p*r + 1.0 / 40320.0;
+  p = p*r + 1.0 / 5040.0;
+  p = p*r + 1.0 / 720.0;
+  p = p*r + 1.0 / 120.0;
+  p = p*r + 1.0 / 24.0;
+  p = p*r + 1.0 / 6.0;
+  p = p*r + 0.5;
+  p = p*r + 1.0;
+  p = p*r + 1.0;
+
+  // 2^n, with n read back from the bits of t
+  itk::uint64_t tBits;
+  itk::uint64_t shifterBits;
+  std::memcpy(&tBits, &t, sizeof(double));
+  std::memcpy(&shifterBits, &shifter, sizeof(double));
+
+  itk::uint64_t scaleBits = (tBits - shifterBits + 1023) << 52;
+
+  double scale;
+  std::memcpy(&scale, &scaleBits, sizeof(double));
+
+  return p * scale;
+}
+
+// y[i] = exp(x[i]) for i < n, x and y may be the same array
+inline void
+Evaluate(const double* x, double* y, unsigned int n)
+{
+  for (int i = 0; i < (int)n; i++)
+    y[i] = Evaluate(x[i]);
+}
+
+}
+
+#endif
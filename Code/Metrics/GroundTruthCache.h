@@ -0,0 +1,101 @@
+// Ground truth data for the surface distance metrics kept on disk, so it is
+// computed once per ground truth image instead of once per submission
+//
+// Load looks in the cache directory for a file named after the MD5 hash of
+// the image contents (voxels, pixel type and geometry) and of the settings
+// of the SurfaceDistanceCache that change what is stored. If there is one,
+// the label inventory and the boundary and distance map of every label are
+// read into the SurfaceDistanceCache. Otherwise they are computed with
+// SurfaceDistanceCache::Precompute and written to the directory for the
+// next run. Files start with a format version and a byte order mark, and
+// files that do not match are recomputed and replaced.
+//
+// Files are written under a temporary name and renamed into place, so runs
+// sharing a directory never see a partly written file.
+
+#ifndef _GroundTruthCache_h
+#define _GroundTruthCache_h
+
+#include "SurfaceDistanceCache.h"
+
+#include "itkObject.h"
+
+#include <string>
+
+template <class TImage>
+class GroundTruthCache: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef GroundTruthCache                                   Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(GroundTruthCache, itk::Object);
+
+  typedef TImage ImageType;
+
+  typedef SurfaceDistanceCache<ImageType> SurfaceDistanceCacheType;
+
+  /** Bumped whenever the stored data changes. */
+  static const unsigned int FileVersion = 2;
+
+  void SetDirectory(const std::string& dir) { m_Directory = dir; }
+  const std::string& GetDirectory() const { return m_Directory; }
+
+  /** Cache the ground truth entries are loaded into or computed by. */
+  void SetSurfaceDistanceCache(SurfaceDistanceCacheType* cache)
+  { m_SurfaceDistanceCache = cache; }
+
+  /**
+   * Voxels beyond the label bounding box covered by the stored surfaces,
+   * see SurfaceDistanceCache::Precompute (default 8).
+   */
+  itkSetMacro(Padding, unsigned int);
+  itkGetConstMacro(Padding, unsigned int);
+
+  /**
+   * Reads the stored entries for the image, or computes and stores them.
+   * Returns true if they were read.
+   */
+  bool Load(const ImageType* img);
+
+  /** Name of the file holding the entries for the image. */
+  std::string GetFileName(const ImageType* img) const;
+
+  /** MD5 of the voxels, pixel type and geometry, as 32 hex digits. */
+  static std::string ComputeImageHash(const ImageType* img);
+
+protected:
+
+  GroundTruthCache();
+  ~GroundTruthCache();
+
+  bool Read(const ImageType* img, const std::string& fn);
+  void Write(const ImageType* img, const std::string& fn);
+
+  std::string m_Directory;
+
+  typename SurfaceDistanceCacheType::Pointer m_SurfaceDistanceCache;
+
+  unsigned int m_Padding;
+
+private:
+
+  GroundTruthCache(const Self&);     // Not implemented
+  void operator=(const Self&);       // Not implemented
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "GroundTruthCache.txx"
+#endif
+
+#endif
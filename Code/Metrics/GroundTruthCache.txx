@@ -0,0 +1,176 @@
+
+#ifndef _GroundTruthCache_txx
+#define _GroundTruthCache_txx
+
+#include "GroundTruthCache.h"
+
+#include "CacheFile.h"
+
+#include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+
+template <class TImage>
+GroundTruthCache<TImage>
+::GroundTruthCache()
+{
+  m_Padding = 8;
+}
+
+template <class TImage>
+GroundTruthCache<TImage>
+::~GroundTruthCache()
+{
+
+}
+
+template <class TImage>
+std::string
+GroundTruthCache<TImage>
+::ComputeImageHash(const ImageType* img)
+{
+  typedef typename ImageType::PixelType PixelType;
+
+  // Everything but the voxels goes in as text
+  std::ostringstream oss;
+  oss.precision(17);
+  oss << typeid(PixelType).name() << " " << sizeof(PixelType) << " "
+    << ImageType::ImageDimension << " "
+    << img->GetLargestPossibleRegion().GetIndex() << " "
+    << img->GetLargestPossibleRegion().GetSize() << " "
+    << img->GetBufferedRegion().GetIndex() << " "
+    << img->GetBufferedRegion().GetSize() << " "
+    << img->GetOrigin() << " " << img->GetSpacing() << " ";
+  for (unsigned int i = 0; i < ImageType::ImageDimension; i++)
+    for (unsigned int j = 0; j < ImageType::ImageDimension; j++)
+      oss << img->GetDirection()(i, j) << " ";
+  std::string header = oss.str();
+
+  itksysMD5* md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+  itksysMD5_Append(md5, (const unsigned char*)header.c_str(), (int)header.size());
+
+  // Appended in pieces, lengths are int
+  const unsigned char* data = (const unsigned char*)img->GetBufferPointer();
+  itk::uint64_t numBytes =
+    img->GetBufferedRegion().GetNumberOfPixels() * sizeof(PixelType);
+  const itk::uint64_t chunk = 1 << 30;
+  while (numBytes > 0)
+  {
+    itk::uint64_t n = numBytes < chunk ? numBytes : chunk;
+    itksysMD5_Append(md5, data, (int)n);
+    data += n;
+    numBytes -= n;
+  }
+
+  char hex[33];
+  itksysMD5_FinalizeHex(md5, hex);
+  itksysMD5_Delete(md5);
+
+  hex[32] = 0;
+  return std::string(hex);
+}
+
+template <class TImage>
+std::string
+GroundTruthCache<TImage>
+::GetFileName(const ImageType* img) const
+{
+  if (m_SurfaceDistanceCache.IsNull())
+    itkExceptionMacro(<< "Surface distance cache undefined");
+
+  // Settings that change what is stored are part of the key
+  std::ostringstream oss;
+  oss << Self::ComputeImageHash(img)
+    << " version " << FileVersion
+    << " connectivity " << m_SurfaceDistanceCache->GetBoundaryConnectivity()
+    << " crop " << m_SurfaceDistanceCache->GetCropToBoundingBox()
+    << " margin " << m_SurfaceDistanceCache->GetCropMargin()
+    << " padding " << m_Padding;
+
+  return m_Directory + "/" + CacheFile::ComputeStringHash(oss.str()) + ".gtc";
+}
+
+template <class TImage>
+bool
+GroundTruthCache<TImage>
+::Load(const ImageType* img)
+{
+  if (img == 0)
+    itkExceptionMacro(<< "Image undefined");
+
+  if (m_SurfaceDistanceCache.IsNull())
+    itkExceptionMacro(<< "Surface distance cache undefined");
+
+  std::string fn = this->GetFileName(img);
+
+  if (itksys::SystemTools::FileExists(fn.c_str(), true) && this->Read(img, fn))
+    return true;
+
+  m_SurfaceDistanceCache->Precompute(img, m_Padding);
+  this->Write(img, fn);
+
+  return false;
+}
+
+template <class TImage>
+bool
+GroundTruthCache<TImage>
+::Read(const ImageType* img, const std::string& fn)
+{
+  std::ifstream is(fn.c_str(), std::ios::in | std::ios::binary);
+  if (!is.is_open())
+    return false;
+
+  char magic[9];
+  itk::uint32_t version = 0;
+  itk::uint32_t byteOrder = 0;
+  is.read(magic, 9);
+  is.read((char*)&version, sizeof(version));
+  is.read((char*)&byteOrder, sizeof(byteOrder));
+
+  if (!is.good() || std::string(magic, 9) != "COVALICGT"
+      || version != FileVersion || byteOrder != 0x01020304)
+    return false;
+
+  return m_SurfaceDistanceCache->ReadImageEntries(img, is);
+}
+
+template <class TImage>
+void
+GroundTruthCache<TImage>
+::Write(const ImageType* img, const std::string& fn)
+{
+  itksys::SystemTools::MakeDirectory(m_Directory.c_str());
+
+  std::string tmpfn = CacheFile::GetTemporaryFileName(fn);
+
+  {
+    std::ofstream os(tmpfn.c_str(), std::ios::out | std::ios::binary);
+
+    itk::uint32_t version = FileVersion;
+    itk::uint32_t byteOrder = 0x01020304;
+    os.write("COVALICGT", 9);
+    os.write((const char*)&version, sizeof(version));
+    os.write((const char*)&byteOrder, sizeof(byteOrder));
+
+    m_SurfaceDistanceCache->WriteImageEntries(img, os);
+
+    os.close();
+    if (os.fail())
+    {
+      std::remove(tmpfn.c_str());
+      itkWarningMacro(<< "Cannot write ground truth cache file " << fn);
+      return;
+    }
+  }
+
+  if (!CacheFile::Replace(tmpfn, fn))
+    itkWarningMacro(<< "Cannot write ground truth cache file " << fn);
+}
+
+#endif
@@ -2,17 +2,28 @@
 // Hausdorff boundary distances, given two binary image masks
 //
 // Both fixed and moving images should have the same unsigned type
+//
+// Boundaries and distance maps come from a SurfaceDistanceCache, pass a
+// shared cache and a label to evaluate label images without recomputing them
+//
+// The maximum (percentile 1) of unblurred images on the same grid skips the
+// distance maps: an exact early break search over the boundary points gives
+// the same value, usually much faster
 // Only handles 3D images
 
 #ifndef _HausdorffDistanceImageToImageMetric_h
 #define _HausdorffDistanceImageToImageMetric_h
 
 #include "AbstractValidationMetric.h"
+#include "DirectedHausdorffCalculator.h"
+#include "SurfaceDistanceCache.h"
 
 #include "itkImageToImageMetric.h"
 
 #include "vnl/vnl_math.h"
 
+#include <vector>
+
 template <class TFixedImage, class TMovingImage>
 class HausdorffDistanceImageToImageMetric :
   public itk::ImageToImageMetric<TFixedImage, TMovingImage>, public AbstractValidationMetric
@@ -53,10 +64,26 @@ public:
   typedef typename TFixedImage::SizeType FixedImageSizeType;
   typedef typename TFixedImage::SpacingType FixedImageSpacingType;
 
+  typedef SurfaceDistanceCache<TFixedImage> SurfaceDistanceCacheType;
+  typedef typename SurfaceDistanceCacheType::Pointer SurfaceDistanceCachePointer;
+
+  // Label 0 (default) compares all nonzero voxels
+  void SetLabel(FixedImagePixelType label) { m_Label = label; }
+
+  void SetSurfaceDistanceCache(SurfaceDistanceCacheType* cache)
+  { m_SurfaceDistanceCache = cache; }
+
   void SetPercentile(double p);
 
   MeasureType GetValue() const;
 
+  /**
+   * Values at several percentiles (e.g. 0.5, 0.95, 1.0) from a single pass
+   * over the boundary distances, in the order given.
+   */
+  void GetValues(const std::vector<double>& percentiles,
+    std::vector<double>& values) const;
+
   MeasureType GetValue(const TransformParametersType& p) const
   { // TODO: apply transform with nearest neighbor interpolation
     return this->GetValue(); }
@@ -70,17 +97,40 @@ public:
   void BlurringOn() { m_DoBlurring = true; }
   void BlurringOff() { m_DoBlurring = false; }
 
+  // Early break search for the maximum (default on)
+  void EarlyBreakOn() { m_EarlyBreak = true; }
+  void EarlyBreakOff() { m_EarlyBreak = false; }
+
 protected:
 
   HausdorffDistanceImageToImageMetric();
   ~HausdorffDistanceImageToImageMetric();
 
-  double ComputeMaxDistance(const FixedImageType*, const MovingImageType*) const;
+  void ComputeMaxDistances(SurfaceDistanceCacheType* cache,
+    const FixedImageType*, const FixedImageType*,
+    const std::vector<double>& percentiles, std::vector<double>& values) const;
+
+  typedef typename SurfaceDistanceCacheType::IndexListType IndexListType;
+
+  // Physical coordinates of voxels given by index
+  static void GetPoints(const FixedImageType* img, const IndexListType& indices,
+    std::vector<double>& x, std::vector<double>& y, std::vector<double>& z);
+
+  // Exact directed Hausdorff distance from the boundary of img1 to the voxels
+  // of img2 the signed Maurer distance map measures to
+  double ComputeEarlyBreakMaxDistance(SurfaceDistanceCacheType* cache,
+    const FixedImageType* img1, const FixedImageType* img2) const;
 
 private:
 
   bool m_DoBlurring;
 
+  bool m_EarlyBreak;
+
+  FixedImagePixelType m_Label;
+
+  SurfaceDistanceCachePointer m_SurfaceDistanceCache;
+
   double m_Percentile;
 
 };
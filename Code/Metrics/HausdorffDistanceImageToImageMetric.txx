@@ -2,21 +2,12 @@
 #ifndef _HausdorffDistanceImageToImageMetric_txx
 #define _HausdorffDistanceImageToImageMetric_txx
 
-#include "itkBSplineInterpolateImageFunction.h"
-#include "itkDiscreteGaussianImageFilter.h"
-#include "itkImageRegionConstIteratorWithIndex.h"
-#include "itkLinearInterpolateImageFunction.h"
-#include "itkSignedMaurerDistanceMapImageFilter.h"
-
-#include "itkBinaryBallStructuringElement.h"
-#include "itkMorphologicalGradientImageFilter.h"
-
 #include "vnl/vnl_math.h"
 
 #include "HausdorffDistanceImageToImageMetric.h"
+#include "LabelBoundaryExtractor.h"
+#include "PercentileSelector.h"
 
-#include <algorithm>
-#include <cmath>
 #include <vector>
 
 
@@ -26,7 +17,11 @@ HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
 {
   m_DoBlurring = false;
 
+  m_EarlyBreak = true;
+
   m_Percentile = 0.95;
+
+  m_Label = 0;
 }
 
 template <class TFixedImage, class TMovingImage>
@@ -48,149 +43,184 @@ HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
 }
 
 template <class TFixedImage, class TMovingImage>
-double
+void
 HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
-::ComputeMaxDistance(
-  const TFixedImage* img1, const TMovingImage* img2) const
+::ComputeMaxDistances(SurfaceDistanceCacheType* cache,
+  const TFixedImage* img1, const TFixedImage* img2,
+  const std::vector<double>& percentiles, std::vector<double>& values) const
 {
-  typedef itk::Image<float, FixedImageType::ImageDimension> FloatImageType;
-
-  typedef itk::SignedMaurerDistanceMapImageFilter<
-    FixedImageType, FloatImageType> DistanceMapFilterType;
-
-  typedef itk::DiscreteGaussianImageFilter<
-    FloatImageType, FloatImageType> BlurFilterType;
+  std::vector<double> distances;
+  cache->ComputeBoundaryDistances(img1, img2, m_Label, m_DoBlurring, distances);
 
-  // Compute distance transform
-  typename FloatImageType::Pointer distMap2;
+  if (distances.size() == 0)
   {
-    typename DistanceMapFilterType::Pointer distanceMapFilter =
-      DistanceMapFilterType::New();
-
-    distanceMapFilter->InsideIsPositiveOff();
-    distanceMapFilter->SetInput(img2);
-    distanceMapFilter->SquaredDistanceOff();
-    distanceMapFilter->UseImageSpacingOn();
+    values.assign(percentiles.size(), vnl_huge_val(1.0));
+    return;
+  }
 
-    distanceMapFilter->Update();
+  PercentileSelector::Select(distances, percentiles, values);
+}
 
-    if (!m_DoBlurring)
-    {
-      distMap2 = distanceMapFilter->GetOutput();
-    }
-    else
-    {
-      typename FloatImageType::SpacingType spacing = img1->GetSpacing();
+template <class TFixedImage, class TMovingImage>
+void
+HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
+::GetPoints(const FixedImageType* img, const IndexListType& indices,
+  std::vector<double>& x, std::vector<double>& y, std::vector<double>& z)
+{
+  x.resize(indices.size());
+  y.resize(indices.size());
+  z.resize(indices.size());
 
-      double minSpacing = spacing[0];
-      for (unsigned int dim = 0; dim < FixedImageType::ImageDimension; dim++)
-        if (spacing[dim] < minSpacing)
-          minSpacing = spacing[dim];
+  for (unsigned int i = 0; i < indices.size(); i++)
+  {
+    FixedImagePointType p;
+    img->TransformIndexToPhysicalPoint(indices[i], p);
 
-      typename BlurFilterType::Pointer blurf = BlurFilterType::New();
-      blurf->SetInput(distanceMapFilter->GetOutput());
-      blurf->SetVariance(1.5 * minSpacing);
-      blurf->Update();
+    double c[3] = { 0.0, 0.0, 0.0 };
+    for (unsigned int dim = 0; dim < FixedImageType::ImageDimension && dim < 3; dim++)
+      c[dim] = p[dim];
 
-      distMap2 = blurf->GetOutput();
-    }
+    x[i] = c[0];
+    y[i] = c[1];
+    z[i] = c[2];
   }
+}
 
-  //typedef itk::LinearInterpolateImageFunction<FloatImageType, double>
-  typedef itk::BSplineInterpolateImageFunction<FloatImageType, double>
-    InterpolatorType;
-  typename InterpolatorType::Pointer distInterp2 = InterpolatorType::New();
-  distInterp2->SetInputImage(distMap2);
-  distInterp2->SetSplineOrder(3);
-
-  // Detect boundary via morphological gradient
-  typedef itk::BinaryBallStructuringElement<FixedImagePixelType, TFixedImage::ImageDimension>
-    StructElementType;
-  typedef
-    itk::MorphologicalGradientImageFilter<FixedImageType, FixedImageType,
-      StructElementType> EdgeFilterType;
-
-  StructElementType structel;
-  structel.SetRadius(1);
-  structel.CreateStructuringElement();
-
-  typename EdgeFilterType::Pointer edgef = EdgeFilterType::New();
-  edgef->SetInput(img1);
-  edgef->SetKernel(structel);
-  edgef->Update();
-
-  FixedImagePointer edgeImg1 = edgef->GetOutput();
+template <class TFixedImage, class TMovingImage>
+double
+HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeEarlyBreakMaxDistance(SurfaceDistanceCacheType* cache,
+  const FixedImageType* img1, const FixedImageType* img2) const
+{
+  typedef LabelBoundaryExtractor<FixedImageType> BoundaryExtractorType;
 
-  std::vector<double> distances;
+  // The signed Maurer map measures to the label voxels that have a
+  // background neighbor in any direction, the 26 connected inner contour,
+  // which the cache only holds if that is its boundary connectivity
+  unsigned int contourConnectivity =
+    BoundaryExtractorType::GetNumberOfNeighbors(FixedImageType::ImageDimension);
 
-  typedef itk::ImageRegionConstIteratorWithIndex<FixedImageType>
-    FixedIteratorType;
-  FixedIteratorType it(edgeImg1, edgeImg1->GetLargestPossibleRegion());
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
 
-  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  if (cache->GetBoundaryConnectivity() == contourConnectivity)
   {
-    FixedImageIndexType ind = it.GetIndex();
-
-    if (it.Get() == 0 || img1->GetPixel(ind) == 0)
-      continue;
-
-     FixedImagePointType p;
-     img1->TransformIndexToPhysicalPoint(ind, p);
+    GetPoints(img2, cache->GetBoundaryIndices(img2, m_Label), x, y, z);
+  }
+  else
+  {
+    // Every boundary voxel lies in the bounding box of the label
+    typename BoundaryExtractorType::Pointer extractor =
+      BoundaryExtractorType::New();
+    extractor->SetConnectivity(contourConnectivity);
 
-    if (!distInterp2->IsInsideBuffer(p))
-      continue;
+    IndexListType contour;
+    extractor->Compute(
+      img2, m_Label, cache->GetBoundingBox(img2, m_Label), contour);
 
-    distances.push_back(vnl_math_abs(distInterp2->Evaluate(p)));
+    GetPoints(img2, contour, x, y, z);
   }
 
-  if (distances.size() == 0)
-    return vnl_huge_val(1.0);
+  DirectedHausdorffCalculator calculator;
+  calculator.SetTargetPoints(x, y, z);
 
-  std::sort(distances.begin(), distances.end());
+  GetPoints(img1, cache->GetBoundaryIndices(img1, m_Label), x, y, z);
 
-  return distances[(int)(m_Percentile*(distances.size() - 1))];
+  return calculator.Compute(x, y, z);
 }
 
 template <class TFixedImage, class TMovingImage>
 typename HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>::MeasureType
 HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
 ::GetValue() const
+{
+  std::vector<double> percentiles(1, m_Percentile);
+  std::vector<double> values;
+  this->GetValues(percentiles, values);
+
+  return values[0];
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+HausdorffDistanceImageToImageMetric<TFixedImage, TMovingImage>
+::GetValues(const std::vector<double>& percentiles,
+  std::vector<double>& values) const
 {
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Handle special case where inputs are zeros
-  typedef itk::ImageRegionConstIteratorWithIndex<FixedImageType>
-    FixedIteratorType;
-  FixedIteratorType it(Superclass::m_FixedImage, Superclass::m_FixedImage->GetLargestPossibleRegion());
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+    if (percentiles[i] < 0.0 || percentiles[i] > 1.0)
+      itkExceptionMacro(<< "Percentile needs to be in [0, 1]");
 
-  double sumFixed = 0;
-  double sumMoving = 0;
-  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  // Without a shared cache the boundaries and distance maps are only reused
+  // within this call
+  SurfaceDistanceCachePointer cache = m_SurfaceDistanceCache;
+  if (cache.IsNull())
   {
-    sumFixed += it.Get();
-    sumMoving += Superclass::m_MovingImage->GetPixel(it.GetIndex());
+    cache = SurfaceDistanceCacheType::New();
+    cache->SetNumberOfThreads(this->GetNumberOfThreads());
   }
 
-  if (sumFixed == 0 || sumMoving == 0)
+  // Handle special case where inputs are zeros
+  itk::SizeValueType numFixed =
+    cache->GetNumberOfVoxels(Superclass::m_FixedImage, m_Label);
+  itk::SizeValueType numMoving =
+    cache->GetNumberOfVoxels(Superclass::m_MovingImage, m_Label);
+
+  if (numFixed == 0 || numMoving == 0)
   {
-    if (sumFixed == sumMoving)
-      return 0.0;
+    if (numFixed == numMoving)
+      values.assign(percentiles.size(), 0.0);
     else
-      return vnl_huge_val(1.0);
+      values.assign(percentiles.size(), vnl_huge_val(1.0));
+    return;
   }
 
-  // Compute max distances at specified percentile
-  double d12 = this->ComputeMaxDistance(
-    Superclass::m_FixedImage, Superclass::m_MovingImage);
-  double d21 = this->ComputeMaxDistance(
-    Superclass::m_MovingImage, Superclass::m_FixedImage);
+  const FixedImageType* fixedImg = Superclass::m_FixedImage;
+  const FixedImageType* movingImg = Superclass::m_MovingImage;
 
-  if (d12 > d21)
-    return d12;
-  else
-    return d21;
+  bool maxOnly = true;
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+    if (percentiles[i] != 1.0)
+      maxOnly = false;
+
+  // Boundary voxels of images on one grid are distance map voxel centers, so
+  // the search over the boundary points gives the map value exactly
+  bool sameGrid =
+    fixedImg->GetLargestPossibleRegion() == movingImg->GetLargestPossibleRegion()
+    && fixedImg->GetOrigin() == movingImg->GetOrigin()
+    && fixedImg->GetSpacing() == movingImg->GetSpacing()
+    && fixedImg->GetDirection() == movingImg->GetDirection();
+
+  if (maxOnly && m_EarlyBreak && !m_DoBlurring && sameGrid)
+  {
+    double h12 = this->ComputeEarlyBreakMaxDistance(cache, fixedImg, movingImg);
+    double h21 = this->ComputeEarlyBreakMaxDistance(cache, movingImg, fixedImg);
 
+    values.assign(percentiles.size(), (h12 > h21) ? h12 : h21);
+    return;
+  }
+
+  // Compute max distances at specified percentiles
+  std::vector<double> d12;
+  this->ComputeMaxDistances(cache,
+    Superclass::m_FixedImage, Superclass::m_MovingImage, percentiles, d12);
+
+  std::vector<double> d21;
+  this->ComputeMaxDistances(cache,
+    Superclass::m_MovingImage, Superclass::m_FixedImage, percentiles, d21);
+
+  values.resize(percentiles.size());
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+  {
+    if (d12[i] > d21[i])
+      values[i] = d12[i];
+    else
+      values[i] = d21[i];
+  }
 }
 
 #endif
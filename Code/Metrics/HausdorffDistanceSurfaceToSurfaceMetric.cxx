@@ -1,8 +1,8 @@
 
 #include "HausdorffDistanceSurfaceToSurfaceMetric.h"
+#include "ClosestPointDistanceCalculator.h"
+#include "PercentileSelector.h"
 
-#include <algorithm>
-#include <cmath>
 #include <vector>
 
 #include "vnl/vnl_math.h"
@@ -11,7 +11,7 @@ void
 HausdorffDistanceSurfaceToSurfaceMetric
 ::SetFixedSurface(vtkPolyData* pd)
 {
-  SurfaceToSurfaceMetric::m_FixedSurface = pd;
+  Superclass::SetFixedSurface(pd);
 
   m_FixedPointLocator = vtkSmartPointer<vtkKdTreePointLocator>::New();
   m_FixedPointLocator->SetDataSet(pd);
@@ -22,7 +22,7 @@ void
 HausdorffDistanceSurfaceToSurfaceMetric
 ::SetMovingSurface(vtkPolyData* pd)
 {
-  SurfaceToSurfaceMetric::m_MovingSurface = pd;
+  Superclass::SetMovingSurface(pd);
 
   m_MovingPointLocator = vtkSmartPointer<vtkKdTreePointLocator>::New();
   m_MovingPointLocator->SetDataSet(pd);
@@ -43,6 +43,22 @@ HausdorffDistanceSurfaceToSurfaceMetric::MeasureType
 HausdorffDistanceSurfaceToSurfaceMetric
 ::GetValue() const
 {
+  std::vector<double> percentiles(1, m_Percentile);
+  std::vector<double> values;
+  this->GetValues(percentiles, values);
+
+  return values[0];
+}
+
+void
+HausdorffDistanceSurfaceToSurfaceMetric
+::GetValues(const std::vector<double>& percentiles,
+  std::vector<double>& values) const
+{
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+    if (percentiles[i] < 0.0 || percentiles[i] > 1.0)
+      itkExceptionMacro("Percentile needs to be in [0,1]");
+
   vtkPoints* fixedPts = this->GetFixedSurface()->GetPoints();
 
   vtkPoints* movingPts = this->GetMovingSurface()->GetPoints();
@@ -50,57 +66,39 @@ HausdorffDistanceSurfaceToSurfaceMetric
   if (movingPts->GetNumberOfPoints() == 0 || fixedPts->GetNumberOfPoints() == 0)
   {
     if (movingPts->GetNumberOfPoints() == fixedPts->GetNumberOfPoints())
-      return 0;
+      values.assign(percentiles.size(), 0.0);
     else
-      return vnl_huge_val(1.0);
+      values.assign(percentiles.size(), vnl_huge_val(1.0));
+    return;
   }
 
+  // Both directions are queried together
   std::vector<double> distances1;
-  for (vtkIdType i = 0; i < movingPts->GetNumberOfPoints(); i++)
-  {
-    double x[3];
-    movingPts->GetPoint(i, x);
-
-    vtkIdType fixedId = m_FixedPointLocator->FindClosestPoint(x);    
-
-    double y[3];
-    fixedPts->GetPoint(fixedId, y);
-
-    double dist_i = 0;
-    for (int j = 0; j < 3; j++)
-    {
-      double d = x[j] - y[j];
-      dist_i += d*d;
-    }
-    dist_i = sqrt(dist_i);
+  std::vector<double> distances2;
 
-    distances1.push_back(dist_i);
+  ClosestPointDistanceCalculator::Pointer calc =
+    ClosestPointDistanceCalculator::New();
+  calc->SetNumberOfThreads(m_NumberOfThreads);
+  if (m_PointToTriangleDistance)
+  {
+    calc->AddQuery(movingPts, this->GetFixedTriangles(), &distances1);
+    calc->AddQuery(fixedPts, this->GetMovingTriangles(), &distances2);
   }
-
-  std::vector<double> distances2;
-  for (vtkIdType i = 0; i < fixedPts->GetNumberOfPoints(); i++)
+  else
   {
-    double x[3];
-    fixedPts->GetPoint(i, x);
-
-    vtkIdType movingId = m_MovingPointLocator->FindClosestPoint(x);    
-
-    double y[3];
-    movingPts->GetPoint(movingId, y);
-
-    double dist_i = 0;
-    for (int j = 0; j < 3; j++)
-    {
-      double d = x[j] - y[j];
-      dist_i += d*d;
-    }
-    dist_i = sqrt(dist_i);
-
-    distances2.push_back(dist_i);
+    calc->AddQuery(movingPts, fixedPts, m_FixedPointLocator, &distances1);
+    calc->AddQuery(fixedPts, movingPts, m_MovingPointLocator, &distances2);
   }
+  calc->Compute();
 
-  double H1 = distances1[(int)(m_Percentile*(distances1.size()-1))];
-  double H2 = distances2[(int)(m_Percentile*(distances2.size()-1))];
+  // Percentiles of the sorted distances, found by selection
+  std::vector<double> H1;
+  PercentileSelector::Select(distances1, percentiles, H1);
 
-  return (H1 > H2) ? H1 : H2;
-};
+  std::vector<double> H2;
+  PercentileSelector::Select(distances2, percentiles, H2);
+
+  values.resize(percentiles.size());
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+    values[i] = (H1[i] > H2[i]) ? H1[i] : H2[i];
+}
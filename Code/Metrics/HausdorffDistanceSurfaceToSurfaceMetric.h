@@ -10,6 +10,8 @@
 #include "vtkKdTreePointLocator.h"
 #include "vtkSmartPointer.h"
 
+#include <vector>
+
 class HausdorffDistanceSurfaceToSurfaceMetric: public SurfaceToSurfaceMetric
 {
 public:
@@ -40,6 +42,10 @@ public:
 
   virtual MeasureType GetValue() const;
 
+  // Values at several percentiles from one pass over the closest distances
+  void GetValues(const std::vector<double>& percentiles,
+    std::vector<double>& values) const;
+
   virtual MeasureType GetValue(const ParametersType& p) const
   { itkExceptionMacro(<< "Not implemented"); return 0; }
 
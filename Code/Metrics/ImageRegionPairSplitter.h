@@ -0,0 +1,63 @@
+// Splits a pair of equally sized fixed/moving regions into matching pieces
+// for multithreaded voxel comparisons
+//
+// The fixed region is divided with ITK's slowest-dimension splitter and the
+// moving region follows it, offset by the difference in start indices.
+// Regions of different size have no voxel correspondence to split on and
+// are returned whole as a single piece.
+
+#ifndef _ImageRegionPairSplitter_h
+#define _ImageRegionPairSplitter_h
+
+#include "itkImageRegion.h"
+#include "itkImageRegionSplitterSlowDimension.h"
+
+template <unsigned int VDimension>
+class ImageRegionPairSplitter
+{
+public:
+
+  typedef itk::ImageRegion<VDimension> RegionType;
+
+  static unsigned int GetNumberOfSplits(
+    const RegionType& fixedRegion, const RegionType& movingRegion,
+    unsigned int requestedNumber)
+  {
+    if (requestedNumber <= 1 || fixedRegion.GetSize() != movingRegion.GetSize())
+      return 1;
+
+    itk::ImageRegionSplitterSlowDimension::Pointer splitter =
+      itk::ImageRegionSplitterSlowDimension::New();
+    return splitter->GetNumberOfSplits(fixedRegion, requestedNumber);
+  }
+
+  // Replaces the two regions with piece i of numPieces, returns false if
+  // there is no such piece
+  static bool GetSplit(
+    unsigned int i, unsigned int numPieces,
+    RegionType& fixedRegion, RegionType& movingRegion)
+  {
+    if (numPieces <= 1 || fixedRegion.GetSize() != movingRegion.GetSize())
+      return (i == 0);
+
+    itk::ImageRegionSplitterSlowDimension::Pointer splitter =
+      itk::ImageRegionSplitterSlowDimension::New();
+
+    RegionType fixedSplit = fixedRegion;
+    if (i >= splitter->GetSplit(i, numPieces, fixedSplit))
+      return false;
+
+    typename RegionType::IndexType movingIndex = movingRegion.GetIndex();
+    for (unsigned int dim = 0; dim < VDimension; dim++)
+      movingIndex[dim] += fixedSplit.GetIndex()[dim] - fixedRegion.GetIndex()[dim];
+
+    movingRegion.SetIndex(movingIndex);
+    movingRegion.SetSize(fixedSplit.GetSize());
+    fixedRegion = fixedSplit;
+
+    return true;
+  }
+
+};
+
+#endif
@@ -4,7 +4,7 @@
 
 #include "JaccardOverlapImageToImageMetric.h"
 
-#include "itkImageRegionIterator.h"
+#include "BinaryOverlapCounter.h"
 
 template <class TFixedImage, class TMovingImage>
 JaccardOverlapImageToImageMetric<TFixedImage, TMovingImage>
@@ -28,38 +28,26 @@ JaccardOverlapImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Define iterators
-  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
-  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+  // Get counts of true/false positives and negatives, split over threads
+  typedef BinaryOverlapCounter<FixedImageType, MovingImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->SetFixedImage(Superclass::m_FixedImage);
+  counter->SetMovingImage(Superclass::m_MovingImage);
+  counter->SetNumberOfThreads(this->GetNumberOfThreads());
+  counter->Compute();
 
-  FixedIteratorType fixedIt(Superclass::m_FixedImage, Superclass::m_FixedImage->GetRequestedRegion());
-  MovingIteratorType movingIt(Superclass::m_MovingImage, Superclass::m_MovingImage->GetRequestedRegion());
-
-  // Get intersection and individual set sizes
-  unsigned int numIntersect = 0;
-  unsigned int numUnion = 0;
-
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
-  {
-    unsigned int r = (unsigned int)fixedIt.Get();
-    unsigned int c = (unsigned int)movingIt.Get();
-
-    bool a = (r != 0);
-    bool b = (c != 0);
-      
-    if (a && b)
-      numIntersect++;
-
-    if (a || b)
-      numUnion++;
+  return Self::ComputeValue(counter->GetCounts());
+}
 
-    ++fixedIt;
-    ++movingIt;
-  }
+template <class TFixedImage, class TMovingImage>
+typename JaccardOverlapImageToImageMetric<TFixedImage,TMovingImage>::MeasureType
+JaccardOverlapImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeValue(const BinaryOverlapCounts& counts)
+{
+  double numUnion =
+    counts.TruePositives + counts.FalsePositives + counts.FalseNegatives;
 
-  return (double)numIntersect / (numUnion + 1e-20);
+  return (double)counts.TruePositives / (numUnion + 1e-20);
 }
 
 #endif
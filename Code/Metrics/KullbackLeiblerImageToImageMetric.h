@@ -4,6 +4,11 @@
 // 
 // Fixed image is taken to be the reference ground truth
 //
+// Inputs must be VectorImages. The sum runs over image rows on multiple
+// threads (see ProbabilityImagePairSum), with one vectorized logarithm of
+// the ratio per component, and the inputs are checked to be densities in
+// the same pass.
+//
 // Reference:
 // Peter Lorenzen, Marcel Prastawa, Brad Davis, Guido Gerig, Elizabeth Bullitt,
 // and Sarang Joshi, Multi-Modal Image Set Registration and Atlas Formation,
@@ -12,6 +17,8 @@
 #ifndef _KullbackLeiblerImageToImageMetric_h
 #define _KullbackLeiblerImageToImageMetric_h
 
+#include "FastLog.h"
+
 #include "itkImageToImageMetric.h"
 #include "itkSmartPointer.h"
 
@@ -39,20 +46,27 @@ public:
     itk::ImageToImageMetric);
 
   typedef typename Superclass::MeasureType MeasureType;
+  typedef typename Superclass::TransformParametersType TransformParametersType;
+  typedef typename Superclass::DerivativeType DerivativeType;
 
   void SetEpsilon(MeasureType e) { m_Epsilon = e; }
   MeasureType GetEpsilon() const { return m_Epsilon; }
 
+  /** Largest allowed difference between a voxel's component sum and one. */
+  itkSetMacro(NormalizationTolerance, double);
+  itkGetConstMacro(NormalizationTolerance, double);
+
   /**  Get the value for single valued optimizers. */
   MeasureType GetValue() const;
 
-  MeasureType GetValue(const itk::Array<double>& p) const
+  MeasureType GetValue(const TransformParametersType& p) const
   { // TODO: apply transform with nearest neighbor interpolation
     return this->GetValue(); }
 
-  MeasureType GetDerivative(const itk::Array<double>& p) const
-  { itkExceptionMacro(<< "Not implemented"); return 0; }
-  virtual void GetDerivative(const itk::Array<double>& p, itk::Array<double>& q) const
+  void GetDerivative(const TransformParametersType& p, DerivativeType& dp) const
+  { itkExceptionMacro(<< "Not implemented"); }
+
+  void GetValueAndDerivative(const TransformParametersType& p, MeasureType& v, DerivativeType& dp) const
   { itkExceptionMacro(<< "Not implemented"); }
 
 protected:
@@ -60,8 +74,34 @@ protected:
   KullbackLeiblerImageToImageMetric();
   virtual ~KullbackLeiblerImageToImageMetric();
 
+  // Clamps both densities to epsilon and sums pa * log(pa / pb)
+  struct KernelType
+  {
+    double Epsilon;
+
+    double Evaluate(double* pa, double* pb, unsigned int n) const
+    {
+      for (int i = 0; i < (int)n; i++)
+      {
+        double a = (pa[i] < Epsilon) ? Epsilon : pa[i];
+        double b = (pb[i] < Epsilon) ? Epsilon : pb[i];
+        pa[i] = a;
+        pb[i] = a / b;
+      }
+
+      FastLog::Evaluate(pb, pb, n);
+
+      double sum = 0;
+      for (unsigned int i = 0; i < n; i++)
+        sum += pa[i] * pb[i];
+      return sum;
+    }
+  };
+
   MeasureType m_Epsilon;
 
+  double m_NormalizationTolerance;
+
 // TODO: transform member, default to identity
 
 };
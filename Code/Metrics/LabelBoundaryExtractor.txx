@@ -0,0 +1,109 @@
+
+#ifndef _LabelBoundaryExtractor_txx
+#define _LabelBoundaryExtractor_txx
+
+#include "LabelBoundaryExtractor.h"
+
+#include "itkConstShapedNeighborhoodIterator.h"
+
+template <class TImage>
+LabelBoundaryExtractor<TImage>
+::LabelBoundaryExtractor()
+{
+  m_Connectivity = GetNumberOfNeighbors(2);
+}
+
+template <class TImage>
+LabelBoundaryExtractor<TImage>
+::~LabelBoundaryExtractor()
+{
+
+}
+
+template <class TImage>
+unsigned int
+LabelBoundaryExtractor<TImage>
+::GetNumberOfNeighbors(unsigned int maxChangedAxes)
+{
+  // Sum over k changed axes of (dim choose k) * 2^k
+  unsigned int count = 0;
+  unsigned int choose = 1;
+  for (unsigned int k = 1;
+    k <= maxChangedAxes && k <= ImageType::ImageDimension; k++)
+  {
+    choose = choose * (ImageType::ImageDimension - k + 1) / k;
+    count += choose << k;
+  }
+
+  return count;
+}
+
+template <class TImage>
+void
+LabelBoundaryExtractor<TImage>
+::Compute(const ImageType* img, PixelType label, const RegionType& region,
+  IndexListType& boundary) const
+{
+  if (img == 0)
+    itkExceptionMacro(<< "Image undefined");
+
+  unsigned int maxChangedAxes = 0;
+  for (unsigned int k = 1; k <= ImageType::ImageDimension; k++)
+    if (GetNumberOfNeighbors(k) == m_Connectivity)
+      maxChangedAxes = k;
+
+  if (maxChangedAxes == 0)
+    itkExceptionMacro(<< "Unsupported connectivity " << m_Connectivity);
+
+  boundary.clear();
+
+  RegionType scanRegion = region;
+  if (!scanRegion.Crop(img->GetBufferedRegion()))
+    return;
+
+  // Neighbors outside the image repeat the nearest voxel inside, which is
+  // itself or another neighbor, so they never add a boundary voxel
+  typedef itk::ConstShapedNeighborhoodIterator<ImageType> IteratorType;
+
+  typename IteratorType::RadiusType radius;
+  radius.Fill(1);
+
+  IteratorType it(radius, img, scanRegion);
+
+  for (unsigned int n = 0; n < it.Size(); n++)
+  {
+    typename IteratorType::OffsetType offset = it.GetOffset(n);
+
+    unsigned int changedAxes = 0;
+    for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+      if (offset[dim] != 0)
+        changedAxes++;
+
+    if (changedAxes > 0 && changedAxes <= maxChangedAxes)
+      it.ActivateOffset(offset);
+  }
+
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    PixelType v = it.GetCenterPixel();
+
+    bool inside = (label == 0) ? (v != 0) : (v == label);
+    if (!inside)
+      continue;
+
+    typename IteratorType::ConstIterator ci;
+    for (ci = it.Begin(); ci != it.End(); ++ci)
+    {
+      PixelType w = ci.Get();
+
+      bool neighborInside = (label == 0) ? (w != 0) : (w == label);
+      if (!neighborInside)
+      {
+        boundary.push_back(it.GetIndex());
+        break;
+      }
+    }
+  }
+}
+
+#endif
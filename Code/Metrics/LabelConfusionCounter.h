@@ -0,0 +1,115 @@
+// Builds the confusion table between two label images in one pass, fixed
+// image denotes truth
+//
+// The requested region is split across threads as in BinaryOverlapCounter.
+// Each thread counts label pairs in its own table: pairs of small labels go
+// to a dense array, others to a map, which is only searched when the pair
+// differs from the previous voxel. When both images hold unsigned char the
+// dense array covers every pair and the map is never used. The tables are
+// merged in thread order. Non-positive values are counted as label 0.
+//
+// With AccumulateOn, each Compute adds the pairs in the current requested
+// regions to those of earlier calls, for images read in slabs. Reset clears
+// the table.
+
+#ifndef _LabelConfusionCounter_h
+#define _LabelConfusionCounter_h
+
+#include "ImageRegionPairSplitter.h"
+#include "LabelConfusionCounts.h"
+#include "LabelPixelTraits.h"
+
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include <vector>
+
+template <class TFixedImage, class TMovingImage>
+class LabelConfusionCounter: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef LabelConfusionCounter                              Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  typedef TFixedImage FixedImageType;
+  typedef TMovingImage MovingImageType;
+
+  typedef typename FixedImageType::RegionType FixedRegionType;
+  typedef typename MovingImageType::RegionType MovingRegionType;
+
+  typedef typename FixedImageType::PixelType FixedPixelType;
+  typedef typename MovingImageType::PixelType MovingPixelType;
+
+  typedef ImageRegionPairSplitter<FixedImageType::ImageDimension> SplitterType;
+
+  typedef LabelConfusionCounts::CountType CountType;
+  typedef LabelConfusionCounts::LabelType LabelType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(LabelConfusionCounter, itk::Object);
+
+  void SetFixedImage(const FixedImageType* img) { m_FixedImage = img; }
+  void SetMovingImage(const MovingImageType* img) { m_MovingImage = img; }
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  itkSetMacro(Accumulate, bool);
+  itkGetConstMacro(Accumulate, bool);
+  itkBooleanMacro(Accumulate);
+
+  void Compute();
+
+  void Reset();
+
+  const LabelConfusionCounts& GetCounts() const { return m_Counts; }
+
+protected:
+
+  LabelConfusionCounter();
+  ~LabelConfusionCounter();
+
+  // Pairs with both labels below this are counted in the dense array
+  static const LabelType DenseLabelLimit =
+    (LabelPixelTraits<FixedPixelType>::NumberOfValues == 256 &&
+     LabelPixelTraits<MovingPixelType>::NumberOfValues == 256) ? 256 : 16;
+
+  struct ThreadTableType
+  {
+    std::vector<CountType> DenseCounts;
+    LabelConfusionCounts::PairCountMapType SparseCounts;
+  };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedCompute(unsigned int threadId, unsigned int numThreads);
+
+  typename FixedImageType::ConstPointer m_FixedImage;
+  typename MovingImageType::ConstPointer m_MovingImage;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  bool m_Accumulate;
+
+  // Pairs counted since the last reset
+  LabelConfusionCounts::PairCountMapType m_PairCounts;
+
+  LabelConfusionCounts m_Counts;
+
+  std::vector<ThreadTableType> m_ThreadTables;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "LabelConfusionCounter.txx"
+#endif
+
+#endif
@@ -0,0 +1,156 @@
+
+#ifndef _LabelConfusionCounter_txx
+#define _LabelConfusionCounter_txx
+
+#include "LabelConfusionCounter.h"
+
+#include "itkImageRegionConstIterator.h"
+
+template <class TFixedImage, class TMovingImage>
+LabelConfusionCounter<TFixedImage, TMovingImage>
+::LabelConfusionCounter()
+{
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  m_Accumulate = false;
+}
+
+template <class TFixedImage, class TMovingImage>
+LabelConfusionCounter<TFixedImage, TMovingImage>
+::~LabelConfusionCounter()
+{
+
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+LabelConfusionCounter<TFixedImage, TMovingImage>
+::Reset()
+{
+  m_PairCounts.clear();
+  m_Counts.Clear();
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+LabelConfusionCounter<TFixedImage, TMovingImage>
+::Compute()
+{
+  if (m_FixedImage.IsNull() || m_MovingImage.IsNull())
+    itkExceptionMacro(<< "Need two input classification images");
+
+  // Regions of different size are walked in lockstep on a single thread
+  unsigned int numThreads = SplitterType::GetNumberOfSplits(
+    m_FixedImage->GetRequestedRegion(), m_MovingImage->GetRequestedRegion(),
+    m_NumberOfThreads);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+
+  m_ThreadTables.clear();
+  m_ThreadTables.resize(threader->GetNumberOfThreads());
+
+  threader->SingleMethodExecute();
+
+  if (!m_Accumulate)
+    this->Reset();
+
+  // Merge the per-thread tables in thread order
+  LabelConfusionCounts::PairCountMapType& pairs = m_PairCounts;
+
+  for (unsigned int t = 0; t < m_ThreadTables.size(); t++)
+  {
+    const ThreadTableType& table = m_ThreadTables[t];
+
+    for (unsigned int k = 0; k < table.DenseCounts.size(); k++)
+    {
+      if (table.DenseCounts[k] == 0)
+        continue;
+
+      LabelConfusionCounts::LabelPairType key(k / DenseLabelLimit, k % DenseLabelLimit);
+      pairs[key] += table.DenseCounts[k];
+    }
+
+    LabelConfusionCounts::PairCountMapType::const_iterator it;
+    for (it = table.SparseCounts.begin(); it != table.SparseCounts.end(); ++it)
+      pairs[it->first] += it->second;
+  }
+
+  m_ThreadTables.clear();
+
+  m_Counts.SetPairCounts(pairs);
+}
+
+template <class TFixedImage, class TMovingImage>
+ITK_THREAD_RETURN_TYPE
+LabelConfusionCounter<TFixedImage, TMovingImage>
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedCompute(info->ThreadID, info->NumberOfThreads);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TFixedImage, class TMovingImage>
+void
+LabelConfusionCounter<TFixedImage, TMovingImage>
+::ThreadedCompute(unsigned int threadId, unsigned int numThreads)
+{
+  ThreadTableType& table = m_ThreadTables[threadId];
+  table.DenseCounts.assign(DenseLabelLimit * DenseLabelLimit, 0);
+  table.SparseCounts.clear();
+
+  FixedRegionType fixedRegion = m_FixedImage->GetRequestedRegion();
+  MovingRegionType movingRegion = m_MovingImage->GetRequestedRegion();
+
+  if (!SplitterType::GetSplit(threadId, numThreads, fixedRegion, movingRegion))
+    return;
+
+  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
+  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+
+  FixedIteratorType fixedIt(m_FixedImage, fixedRegion);
+  MovingIteratorType movingIt(m_MovingImage, movingRegion);
+
+  CountType* dense = &table.DenseCounts[0];
+
+  // Map entry of the last sparse pair seen
+  CountType* lastCount = 0;
+  LabelConfusionCounts::LabelPairType lastPair(0, 0);
+
+  fixedIt.GoToBegin();
+  movingIt.GoToBegin();
+  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
+  {
+    // Non-positive values are background, as in the overlap calculator
+    LabelType r = 0;
+    LabelType c = 0;
+    if (fixedIt.Get() > 0)
+      r = (LabelType)fixedIt.Get();
+    if (movingIt.Get() > 0)
+      c = (LabelType)movingIt.Get();
+
+    if (r < DenseLabelLimit && c < DenseLabelLimit)
+    {
+      dense[r * DenseLabelLimit + c]++;
+    }
+    else
+    {
+      if (lastCount == 0 || r != lastPair.first || c != lastPair.second)
+      {
+        lastPair = LabelConfusionCounts::LabelPairType(r, c);
+        lastCount = &table.SparseCounts[lastPair];
+      }
+      (*lastCount)++;
+    }
+
+    ++fixedIt;
+    ++movingIt;
+  }
+}
+
+#endif
@@ -0,0 +1,156 @@
+// Confusion table between two label images, holding only the label pairs
+// that occur
+//
+// Labels are compacted to the sorted list of values present in either
+// image, and the table keeps one entry per (fixed, moving) pair with a
+// nonzero count. Memory and work scale with the labels present, not with
+// the largest label value. Kappa and its weighted variants are functions of
+// this table, and so are the overlap counts of each label against the rest.
+
+#ifndef _LabelConfusionCounts_h
+#define _LabelConfusionCounts_h
+
+#include "BinaryOverlapCounts.h"
+
+#include "itkIntTypes.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+class LabelConfusionCounts
+{
+public:
+
+  typedef itk::uint64_t CountType;
+  typedef unsigned long LabelType;
+
+  typedef std::pair<LabelType, LabelType> LabelPairType;
+  typedef std::map<LabelPairType, CountType> PairCountMapType;
+
+  // Count of voxels with fixed label Labels[Row] and moving label
+  // Labels[Column]
+  struct EntryType
+  {
+    unsigned int Row;
+    unsigned int Column;
+    CountType Count;
+  };
+
+  LabelConfusionCounts()
+  {
+    this->Clear();
+  }
+
+  void Clear()
+  {
+    m_Labels.clear();
+    m_Entries.clear();
+    m_RowSums.clear();
+    m_ColumnSums.clear();
+    m_TotalCount = 0;
+  }
+
+  // Rebuild from counts keyed by (fixed label, moving label)
+  void SetPairCounts(const PairCountMapType& pairs)
+  {
+    this->Clear();
+
+    PairCountMapType::const_iterator it;
+    for (it = pairs.begin(); it != pairs.end(); ++it)
+    {
+      m_Labels.push_back(it->first.first);
+      m_Labels.push_back(it->first.second);
+    }
+
+    std::sort(m_Labels.begin(), m_Labels.end());
+    m_Labels.erase(std::unique(m_Labels.begin(), m_Labels.end()), m_Labels.end());
+
+    m_RowSums.assign(m_Labels.size(), 0);
+    m_ColumnSums.assign(m_Labels.size(), 0);
+
+    // The map is ordered by fixed then moving label, so entries come out in
+    // row major order
+    for (it = pairs.begin(); it != pairs.end(); ++it)
+    {
+      if (it->second == 0)
+        continue;
+
+      EntryType entry;
+      entry.Row = this->GetLabelIndex(it->first.first);
+      entry.Column = this->GetLabelIndex(it->first.second);
+      entry.Count = it->second;
+      m_Entries.push_back(entry);
+
+      m_RowSums[entry.Row] += entry.Count;
+      m_ColumnSums[entry.Column] += entry.Count;
+      m_TotalCount += entry.Count;
+    }
+  }
+
+  /** Labels present in either image, in increasing order. */
+  unsigned int GetNumberOfLabels() const { return m_Labels.size(); }
+  LabelType GetLabel(unsigned int i) const { return m_Labels[i]; }
+
+  /** Index of the label in the label list, or GetNumberOfLabels() if absent. */
+  unsigned int GetLabelIndex(LabelType label) const
+  {
+    std::vector<LabelType>::const_iterator it =
+      std::lower_bound(m_Labels.begin(), m_Labels.end(), label);
+    if (it == m_Labels.end() || *it != label)
+      return m_Labels.size();
+    return it - m_Labels.begin();
+  }
+
+  /** Nonzero cells of the table, in row major order. */
+  const std::vector<EntryType>& GetEntries() const { return m_Entries; }
+
+  /** Voxels with fixed label i and with moving label i. */
+  CountType GetRowSum(unsigned int i) const { return m_RowSums[i]; }
+  CountType GetColumnSum(unsigned int i) const { return m_ColumnSums[i]; }
+
+  CountType GetTotalCount() const { return m_TotalCount; }
+
+  /**
+   * Overlap counts of the binary masks of one label, as counted by
+   * BinaryOverlapCounter on the thresholded images. A label in neither
+   * image has every voxel a true negative.
+   */
+  BinaryOverlapCounts GetOverlapCounts(LabelType label) const
+  {
+    BinaryOverlapCounts counts;
+
+    unsigned int i = this->GetLabelIndex(label);
+    if (i < m_Labels.size())
+    {
+      for (unsigned int k = 0; k < m_Entries.size(); k++)
+        if (m_Entries[k].Row == i && m_Entries[k].Column == i)
+        {
+          counts.TruePositives = m_Entries[k].Count;
+          break;
+        }
+
+      counts.FalseNegatives = m_RowSums[i] - counts.TruePositives;
+      counts.FalsePositives = m_ColumnSums[i] - counts.TruePositives;
+    }
+
+    counts.TrueNegatives = m_TotalCount - counts.TruePositives
+      - counts.FalseNegatives - counts.FalsePositives;
+
+    return counts;
+  }
+
+protected:
+
+  std::vector<LabelType> m_Labels;
+  std::vector<EntryType> m_Entries;
+
+  std::vector<CountType> m_RowSums;
+  std::vector<CountType> m_ColumnSums;
+
+  CountType m_TotalCount;
+
+};
+
+#endif
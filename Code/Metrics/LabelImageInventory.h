@@ -0,0 +1,127 @@
+// Labels present in an image with their voxel counts and bounding boxes,
+// gathered in one multithreaded pass
+//
+// Every nonzero value is a label. As in SurfaceDistanceCache, label 0 stands
+// for all nonzero voxels together. Each thread scans a slab of the image
+// into its own table and the tables are merged in thread order.
+//
+// Write and Read save and restore the inventory in binary form, in the
+// native byte order, for ground truth kept in a GroundTruthCache.
+
+#ifndef _LabelImageInventory_h
+#define _LabelImageInventory_h
+
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+template <class TImage>
+class LabelImageInventory: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef LabelImageInventory                                Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(LabelImageInventory, itk::Object);
+
+  typedef TImage ImageType;
+  typedef typename ImageType::ConstPointer ImageConstPointer;
+  typedef typename ImageType::IndexType IndexType;
+  typedef typename ImageType::PixelType PixelType;
+  typedef typename ImageType::RegionType RegionType;
+
+  typedef std::vector<PixelType> LabelListType;
+
+  void SetImage(const ImageType* img);
+  const ImageType* GetImage() const { return m_Image; }
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  void Update();
+
+  /** Nonzero labels present in the image, in increasing order. */
+  const LabelListType& GetLabels() const { return m_Labels; }
+
+  bool HasLabel(PixelType label) const;
+
+  /** Number of distinct values in the image, background included. */
+  unsigned int GetNumberOfDistinctValues() const;
+
+  itk::SizeValueType GetNumberOfVoxels(PixelType label) const;
+
+  /** Bounding box of the label, empty if the label is absent. */
+  RegionType GetBoundingBox(PixelType label) const;
+
+  void Write(std::ostream& os) const;
+
+  /**
+   * Restores an inventory written for the image set, in place of Update.
+   * Returns false if the stream ends early.
+   */
+  bool Read(std::istream& is);
+
+protected:
+
+  LabelImageInventory();
+  ~LabelImageInventory();
+
+  struct LabelInfoType
+  {
+    itk::SizeValueType NumberOfVoxels;
+    IndexType MinIndex;
+    IndexType MaxIndex;
+  };
+
+  typedef std::map<PixelType, LabelInfoType> LabelInfoMapType;
+
+  struct ThreadTableType
+  {
+    LabelInfoMapType Labels;
+    itk::SizeValueType NumberOfBackgroundVoxels;
+  };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedUpdate(unsigned int threadId, unsigned int numThreads);
+
+  static void AddVoxels(LabelInfoType& info, const LabelInfoType& other);
+
+  // Field by field as fixed size integers, independent of struct layout
+  static void WriteLabelInfo(std::ostream& os, const LabelInfoType& info);
+  static void ReadLabelInfo(std::istream& is, LabelInfoType& info);
+
+  ImageConstPointer m_Image;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  std::vector<ThreadTableType> m_ThreadTables;
+
+  LabelInfoMapType m_LabelInfos;
+  LabelListType m_Labels;
+
+  // All nonzero voxels together, reported for label 0
+  LabelInfoType m_NonzeroInfo;
+
+  itk::SizeValueType m_NumberOfBackgroundVoxels;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "LabelImageInventory.txx"
+#endif
+
+#endif
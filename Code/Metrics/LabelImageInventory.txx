@@ -0,0 +1,357 @@
+
+#ifndef _LabelImageInventory_txx
+#define _LabelImageInventory_txx
+
+#include "LabelImageInventory.h"
+
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionSplitterSlowDimension.h"
+
+template <class TImage>
+LabelImageInventory<TImage>
+::LabelImageInventory()
+{
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  m_NonzeroInfo.NumberOfVoxels = 0;
+  m_NumberOfBackgroundVoxels = 0;
+}
+
+template <class TImage>
+LabelImageInventory<TImage>
+::~LabelImageInventory()
+{
+
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::SetImage(const ImageType* img)
+{
+  m_Image = img;
+  this->Modified();
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::AddVoxels(LabelInfoType& info, const LabelInfoType& other)
+{
+  if (other.NumberOfVoxels == 0)
+    return;
+
+  if (info.NumberOfVoxels == 0)
+  {
+    info = other;
+    return;
+  }
+
+  info.NumberOfVoxels += other.NumberOfVoxels;
+
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+  {
+    if (other.MinIndex[dim] < info.MinIndex[dim])
+      info.MinIndex[dim] = other.MinIndex[dim];
+    if (other.MaxIndex[dim] > info.MaxIndex[dim])
+      info.MaxIndex[dim] = other.MaxIndex[dim];
+  }
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::Update()
+{
+  if (m_Image.IsNull())
+    itkExceptionMacro(<< "Image undefined");
+
+  itk::ImageRegionSplitterSlowDimension::Pointer splitter =
+    itk::ImageRegionSplitterSlowDimension::New();
+
+  unsigned int numThreads = m_NumberOfThreads;
+  if (numThreads < 1)
+    numThreads = 1;
+  numThreads = splitter->GetNumberOfSplits(
+    m_Image->GetLargestPossibleRegion(), numThreads);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+
+  m_ThreadTables.clear();
+  m_ThreadTables.resize(threader->GetNumberOfThreads());
+
+  threader->SingleMethodExecute();
+
+  // Merge the per-thread tables
+  m_LabelInfos.clear();
+  m_Labels.clear();
+  m_NonzeroInfo.NumberOfVoxels = 0;
+  m_NumberOfBackgroundVoxels = 0;
+
+  for (unsigned int t = 0; t < m_ThreadTables.size(); t++)
+  {
+    const ThreadTableType& table = m_ThreadTables[t];
+
+    typename LabelInfoMapType::const_iterator it;
+    for (it = table.Labels.begin(); it != table.Labels.end(); ++it)
+    {
+      typename LabelInfoMapType::iterator mit = m_LabelInfos.find(it->first);
+      if (mit == m_LabelInfos.end())
+        m_LabelInfos.insert(*it);
+      else
+        AddVoxels(mit->second, it->second);
+
+      AddVoxels(m_NonzeroInfo, it->second);
+    }
+
+    m_NumberOfBackgroundVoxels += table.NumberOfBackgroundVoxels;
+  }
+
+  m_ThreadTables.clear();
+
+  typename LabelInfoMapType::const_iterator it;
+  for (it = m_LabelInfos.begin(); it != m_LabelInfos.end(); ++it)
+    m_Labels.push_back(it->first);
+}
+
+template <class TImage>
+ITK_THREAD_RETURN_TYPE
+LabelImageInventory<TImage>
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedUpdate(info->ThreadID, info->NumberOfThreads);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::ThreadedUpdate(unsigned int threadId, unsigned int numThreads)
+{
+  ThreadTableType& table = m_ThreadTables[threadId];
+  table.Labels.clear();
+  table.NumberOfBackgroundVoxels = 0;
+
+  RegionType region = m_Image->GetLargestPossibleRegion();
+
+  itk::ImageRegionSplitterSlowDimension::Pointer splitter =
+    itk::ImageRegionSplitterSlowDimension::New();
+  if (threadId >= splitter->GetSplit(threadId, numThreads, region))
+    return;
+
+  typedef itk::ImageRegionConstIteratorWithIndex<ImageType> IteratorType;
+  IteratorType it(m_Image, region);
+
+  // Neighboring voxels mostly share a label, so the map is only searched
+  // when the label changes
+  LabelInfoType* current = 0;
+  PixelType currentLabel = 0;
+
+  itk::SizeValueType numBackground = 0;
+
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    PixelType v = it.Get();
+
+    if (v == 0)
+    {
+      numBackground++;
+      continue;
+    }
+
+    IndexType ind = it.GetIndex();
+
+    if (current == 0 || v != currentLabel)
+    {
+      typename LabelInfoMapType::iterator mit = table.Labels.find(v);
+      if (mit == table.Labels.end())
+      {
+        LabelInfoType info;
+        info.NumberOfVoxels = 0;
+        info.MinIndex = ind;
+        info.MaxIndex = ind;
+        mit = table.Labels.insert(std::make_pair(v, info)).first;
+      }
+
+      current = &mit->second;
+      currentLabel = v;
+    }
+
+    current->NumberOfVoxels++;
+
+    for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    {
+      if (ind[dim] < current->MinIndex[dim])
+        current->MinIndex[dim] = ind[dim];
+      if (ind[dim] > current->MaxIndex[dim])
+        current->MaxIndex[dim] = ind[dim];
+    }
+  }
+
+  table.NumberOfBackgroundVoxels = numBackground;
+}
+
+template <class TImage>
+bool
+LabelImageInventory<TImage>
+::HasLabel(PixelType label) const
+{
+  return this->GetNumberOfVoxels(label) > 0;
+}
+
+template <class TImage>
+unsigned int
+LabelImageInventory<TImage>
+::GetNumberOfDistinctValues() const
+{
+  unsigned int count = m_Labels.size();
+  if (m_NumberOfBackgroundVoxels > 0)
+    count++;
+  return count;
+}
+
+template <class TImage>
+itk::SizeValueType
+LabelImageInventory<TImage>
+::GetNumberOfVoxels(PixelType label) const
+{
+  if (label == 0)
+    return m_NonzeroInfo.NumberOfVoxels;
+
+  typename LabelInfoMapType::const_iterator it = m_LabelInfos.find(label);
+  if (it == m_LabelInfos.end())
+    return 0;
+
+  return it->second.NumberOfVoxels;
+}
+
+template <class TImage>
+typename LabelImageInventory<TImage>::RegionType
+LabelImageInventory<TImage>
+::GetBoundingBox(PixelType label) const
+{
+  const LabelInfoType* info = &m_NonzeroInfo;
+  if (label != 0)
+  {
+    typename LabelInfoMapType::const_iterator it = m_LabelInfos.find(label);
+    if (it == m_LabelInfos.end())
+      return RegionType();
+    info = &it->second;
+  }
+
+  RegionType bbox;
+  if (info->NumberOfVoxels == 0)
+    return bbox;
+
+  typename RegionType::SizeType size;
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    size[dim] = info->MaxIndex[dim] - info->MinIndex[dim] + 1;
+
+  bbox.SetIndex(info->MinIndex);
+  bbox.SetSize(size);
+
+  return bbox;
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::WriteLabelInfo(std::ostream& os, const LabelInfoType& info)
+{
+  itk::uint64_t numVoxels = info.NumberOfVoxels;
+  os.write((const char*)&numVoxels, sizeof(numVoxels));
+
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+  {
+    itk::int64_t minIndex = info.MinIndex[dim];
+    itk::int64_t maxIndex = info.MaxIndex[dim];
+    os.write((const char*)&minIndex, sizeof(minIndex));
+    os.write((const char*)&maxIndex, sizeof(maxIndex));
+  }
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::ReadLabelInfo(std::istream& is, LabelInfoType& info)
+{
+  itk::uint64_t numVoxels = 0;
+  is.read((char*)&numVoxels, sizeof(numVoxels));
+  info.NumberOfVoxels = numVoxels;
+
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+  {
+    itk::int64_t minIndex = 0;
+    itk::int64_t maxIndex = 0;
+    is.read((char*)&minIndex, sizeof(minIndex));
+    is.read((char*)&maxIndex, sizeof(maxIndex));
+    info.MinIndex[dim] = minIndex;
+    info.MaxIndex[dim] = maxIndex;
+  }
+}
+
+template <class TImage>
+void
+LabelImageInventory<TImage>
+::Write(std::ostream& os) const
+{
+  itk::uint64_t numLabels = m_LabelInfos.size();
+  os.write((const char*)&numLabels, sizeof(numLabels));
+  itk::uint64_t numBackground = m_NumberOfBackgroundVoxels;
+  os.write((const char*)&numBackground, sizeof(numBackground));
+  Self::WriteLabelInfo(os, m_NonzeroInfo);
+
+  typename LabelInfoMapType::const_iterator it;
+  for (it = m_LabelInfos.begin(); it != m_LabelInfos.end(); ++it)
+  {
+    os.write((const char*)&it->first, sizeof(PixelType));
+    Self::WriteLabelInfo(os, it->second);
+  }
+}
+
+template <class TImage>
+bool
+LabelImageInventory<TImage>
+::Read(std::istream& is)
+{
+  m_LabelInfos.clear();
+  m_Labels.clear();
+
+  itk::uint64_t numLabels = 0;
+  is.read((char*)&numLabels, sizeof(numLabels));
+  itk::uint64_t numBackground = 0;
+  is.read((char*)&numBackground, sizeof(numBackground));
+  m_NumberOfBackgroundVoxels = numBackground;
+  Self::ReadLabelInfo(is, m_NonzeroInfo);
+
+  for (itk::uint64_t i = 0; i < numLabels && is.good(); i++)
+  {
+    PixelType label;
+    LabelInfoType info;
+    is.read((char*)&label, sizeof(PixelType));
+    Self::ReadLabelInfo(is, info);
+
+    m_LabelInfos.insert(std::make_pair(label, info));
+    m_Labels.push_back(label);
+  }
+
+  if (!is.good())
+  {
+    m_LabelInfos.clear();
+    m_Labels.clear();
+    m_NonzeroInfo.NumberOfVoxels = 0;
+    m_NumberOfBackgroundVoxels = 0;
+    return false;
+  }
+
+  return true;
+}
+
+#endif
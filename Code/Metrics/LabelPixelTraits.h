@@ -0,0 +1,25 @@
+// Compile time facts about label pixel types, used by the label counters to
+// pick fixed size tables
+//
+// For pixel types with few enough values, a table indexed by value covers
+// every label, so the counting loops need no bounds checks, resizing or map
+// lookups. That is the case for unsigned char, the type most label images
+// are stored in.
+
+#ifndef _LabelPixelTraits_h
+#define _LabelPixelTraits_h
+
+template <class TPixel>
+struct LabelPixelTraits
+{
+  // Number of values when a table indexed by value is small, 0 otherwise
+  static const unsigned int NumberOfValues = 0;
+};
+
+template <>
+struct LabelPixelTraits<unsigned char>
+{
+  static const unsigned int NumberOfValues = 256;
+};
+
+#endif
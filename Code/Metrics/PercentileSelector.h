@@ -0,0 +1,69 @@
+// Percentiles of a list of distances by selection instead of a full sort
+//
+// Percentile p is the value at rank (int)(p*(n-1)) in ascending order, as
+// the Hausdorff metrics have always used. Each rank is found with
+// std::nth_element, in increasing order of rank so that every selection
+// only partitions what is left above the previous one. Several percentiles
+// (e.g. 0.5, 0.95 and 1.0) therefore cost about as much as one.
+
+#ifndef _PercentileSelector_h
+#define _PercentileSelector_h
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+class PercentileSelector
+{
+public:
+
+  // Values are reordered, percentiles must be in [0, 1] and values nonempty
+  static double Select(std::vector<double>& values, double p)
+  {
+    std::vector<double> percentiles(1, p);
+    std::vector<double> results;
+    Select(values, percentiles, results);
+    return results[0];
+  }
+
+  // Results are returned in the order percentiles were given
+  static void Select(
+    std::vector<double>& values, const std::vector<double>& percentiles,
+    std::vector<double>& results)
+  {
+    results.assign(percentiles.size(), 0.0);
+
+    if (values.size() == 0)
+      return;
+
+    // (rank, position in results) pairs, increasing rank
+    std::vector< std::pair<size_t, size_t> > ranks;
+    for (size_t i = 0; i < percentiles.size(); i++)
+    {
+      size_t r = (size_t)(percentiles[i]*(values.size() - 1));
+      ranks.push_back(std::make_pair(r, i));
+    }
+    std::sort(ranks.begin(), ranks.end());
+
+    std::vector<double>::iterator first = values.begin();
+    for (size_t k = 0; k < ranks.size(); k++)
+    {
+      std::vector<double>::iterator nth = values.begin() + ranks[k].first;
+
+      if (nth >= first)
+      {
+        if (nth + 1 == values.end())
+          std::iter_swap(nth, std::max_element(first, values.end()));
+        else
+          std::nth_element(first, nth, values.end());
+
+        first = nth + 1;
+      }
+
+      results[ranks[k].second] = *nth;
+    }
+  }
+
+};
+
+#endif
@@ -0,0 +1,212 @@
+
+#include "PointKdTree.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// Orders point ids by one coordinate
+struct CoordinateLess
+{
+  const std::vector<double>* Coordinates;
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    return (*Coordinates)[a] < (*Coordinates)[b];
+  }
+};
+
+}
+
+PointKdTree
+::PointKdTree()
+{
+
+}
+
+PointKdTree
+::~PointKdTree()
+{
+
+}
+
+void
+PointKdTree
+::Build(const std::vector<double>& x, const std::vector<double>& y,
+  const std::vector<double>& z)
+{
+  if (x.size() != y.size() || x.size() != z.size())
+    itkExceptionMacro(<< "Coordinate arrays differ in size");
+
+  m_Nodes.clear();
+  m_X.clear();
+  m_Y.clear();
+  m_Z.clear();
+  m_Ids.clear();
+
+  unsigned int numPoints = x.size();
+  if (numPoints == 0)
+    return;
+
+  std::vector<unsigned int> order(numPoints);
+  for (unsigned int i = 0; i < numPoints; i++)
+    order[i] = i;
+
+  m_Nodes.reserve(2*numPoints / LeafSize + 1);
+  m_Nodes.resize(1);
+
+  this->BuildNode(0, 0, numPoints, order, x, y, z);
+
+  m_X.resize(numPoints);
+  m_Y.resize(numPoints);
+  m_Z.resize(numPoints);
+  m_Ids = order;
+
+  for (unsigned int i = 0; i < numPoints; i++)
+  {
+    m_X[i] = x[order[i]];
+    m_Y[i] = y[order[i]];
+    m_Z[i] = z[order[i]];
+  }
+}
+
+void
+PointKdTree
+::BuildNode(unsigned int nodeId, unsigned int first, unsigned int count,
+  std::vector<unsigned int>& order, const std::vector<double>& x,
+  const std::vector<double>& y, const std::vector<double>& z)
+{
+  const std::vector<double>* coords[3] = { &x, &y, &z };
+
+  NodeType node;
+
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    node.Min[dim] = vnl_huge_val(1.0);
+    node.Max[dim] = -vnl_huge_val(1.0);
+  }
+
+  for (unsigned int i = first; i < first + count; i++)
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+      double c = (*coords[dim])[order[i]];
+      if (c < node.Min[dim])
+        node.Min[dim] = c;
+      if (c > node.Max[dim])
+        node.Max[dim] = c;
+    }
+
+  if (count <= LeafSize)
+  {
+    node.First = first;
+    node.Count = count;
+    m_Nodes[nodeId] = node;
+    return;
+  }
+
+  // Split at the median along the longest axis
+  unsigned int axis = 0;
+  for (unsigned int dim = 1; dim < 3; dim++)
+    if ((node.Max[dim] - node.Min[dim]) > (node.Max[axis] - node.Min[axis]))
+      axis = dim;
+
+  unsigned int half = count / 2;
+
+  CoordinateLess less;
+  less.Coordinates = coords[axis];
+
+  std::nth_element(
+    order.begin() + first, order.begin() + first + half,
+    order.begin() + first + count, less);
+
+  unsigned int left = m_Nodes.size();
+  m_Nodes.resize(left + 2);
+
+  node.First = left;
+  node.Count = 0;
+  m_Nodes[nodeId] = node;
+
+  this->BuildNode(left, first, half, order, x, y, z);
+  this->BuildNode(left + 1, first + half, count - half, order, x, y, z);
+}
+
+double
+PointKdTree
+::BoxDistance2(const NodeType& node, const double q[3]) const
+{
+  double d2 = 0;
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    double d = 0;
+    if (q[dim] < node.Min[dim])
+      d = node.Min[dim] - q[dim];
+    else if (q[dim] > node.Max[dim])
+      d = q[dim] - node.Max[dim];
+    d2 += d*d;
+  }
+  return d2;
+}
+
+unsigned int
+PointKdTree
+::FindClosestPoint(const double q[3], double& dist2) const
+{
+  if (m_Nodes.size() == 0)
+    itkExceptionMacro(<< "Empty tree");
+
+  double best2 = vnl_huge_val(1.0);
+  unsigned int bestIndex = 0;
+
+  unsigned int stack[StackSize];
+  unsigned int top = 0;
+
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const NodeType& node = m_Nodes[stack[--top]];
+
+    if (this->BoxDistance2(node, q) >= best2)
+      continue;
+
+    if (node.Count > 0)
+    {
+      for (unsigned int i = node.First; i < node.First + node.Count; i++)
+      {
+        double dx = m_X[i] - q[0];
+        double dy = m_Y[i] - q[1];
+        double dz = m_Z[i] - q[2];
+        double d2 = dx*dx + dy*dy + dz*dz;
+
+        if (d2 < best2)
+        {
+          best2 = d2;
+          bestIndex = i;
+        }
+      }
+      continue;
+    }
+
+    // Push the farther child first so the nearer one is visited first
+    double dLeft = this->BoxDistance2(m_Nodes[node.First], q);
+    double dRight = this->BoxDistance2(m_Nodes[node.First + 1], q);
+
+    if (dLeft < dRight)
+    {
+      stack[top++] = node.First + 1;
+      stack[top++] = node.First;
+    }
+    else
+    {
+      stack[top++] = node.First;
+      stack[top++] = node.First + 1;
+    }
+  }
+
+  dist2 = best2;
+
+  return m_Ids[bestIndex];
+}
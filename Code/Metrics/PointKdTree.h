@@ -0,0 +1,136 @@
+// Static kd-tree over 3D points stored as one array per coordinate
+//
+// Points are reordered so every leaf covers a contiguous range of the
+// coordinate arrays, nodes live in one flat array and hold the bounding box
+// of their points. Radius queries hand each point found to a visitor
+// together with its squared distance, so no neighbor lists are allocated.
+// Queries only read the tree and may run concurrently.
+
+#ifndef _PointKdTree_h
+#define _PointKdTree_h
+
+#include "itkObject.h"
+
+#include <vector>
+
+class PointKdTree: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef PointKdTree                                        Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(PointKdTree, itk::Object);
+
+  /** Build over the points (x[i], y[i], z[i]). */
+  void Build(const std::vector<double>& x, const std::vector<double>& y,
+    const std::vector<double>& z);
+
+  unsigned int GetNumberOfPoints() const { return m_Ids.size(); }
+
+  /**
+   * Calls visitor(id, d2) for every point within radius of q, where id is
+   * the index the point was given to Build with and d2 its squared distance.
+   */
+  template <class TVisitor>
+  void VisitPointsInRadius(const double q[3], double radius,
+    TVisitor& visitor) const;
+
+  /** Index of the point closest to q, its squared distance in dist2. */
+  unsigned int FindClosestPoint(const double q[3], double& dist2) const;
+
+protected:
+
+  PointKdTree();
+  ~PointKdTree();
+
+  struct NodeType
+  {
+    double Min[3];
+    double Max[3];
+
+    // Leaves hold Count points from First, internal nodes have Count == 0
+    // and children at First and First+1
+    unsigned int First;
+    unsigned int Count;
+  };
+
+  // Points per leaf
+  static const unsigned int LeafSize = 16;
+
+  // Traversal stack size, tree depth is about log2 of the point count
+  static const unsigned int StackSize = 128;
+
+  void BuildNode(unsigned int nodeId, unsigned int first, unsigned int count,
+    std::vector<unsigned int>& order, const std::vector<double>& x,
+    const std::vector<double>& y, const std::vector<double>& z);
+
+  double BoxDistance2(const NodeType& node, const double q[3]) const;
+
+  std::vector<NodeType> m_Nodes;
+
+  // Coordinates in tree order and the original index of each point
+  std::vector<double> m_X;
+  std::vector<double> m_Y;
+  std::vector<double> m_Z;
+  std::vector<unsigned int> m_Ids;
+
+};
+
+template <class TVisitor>
+void
+PointKdTree
+::VisitPointsInRadius(const double q[3], double radius,
+  TVisitor& visitor) const
+{
+  if (m_Nodes.size() == 0)
+    return;
+
+  double r2 = radius * radius;
+
+  unsigned int stack[StackSize];
+  unsigned int top = 0;
+
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const NodeType& node = m_Nodes[stack[--top]];
+
+    if (this->BoxDistance2(node, q) > r2)
+      continue;
+
+    if (node.Count == 0)
+    {
+      stack[top++] = node.First;
+      stack[top++] = node.First + 1;
+      continue;
+    }
+
+    const double* px = &m_X[node.First];
+    const double* py = &m_Y[node.First];
+    const double* pz = &m_Z[node.First];
+    const unsigned int* ids = &m_Ids[node.First];
+
+    for (unsigned int i = 0; i < node.Count; i++)
+    {
+      double dx = px[i] - q[0];
+      double dy = py[i] - q[1];
+      double dz = pz[i] - q[2];
+      double d2 = dx*dx + dy*dy + dz*dz;
+
+      if (d2 <= r2)
+        visitor(ids[i], d2);
+    }
+  }
+}
+
+#endif
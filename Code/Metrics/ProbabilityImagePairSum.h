@@ -0,0 +1,116 @@
+// Sum of a per-component kernel over two probability density (vector)
+// images, shared by the Kullback-Leibler and Bhattacharyya metrics
+//
+// The requested region is split across threads with ImageRegionPairSplitter.
+// Each thread walks its piece one image row at a time: the components of the
+// row, which are contiguous in a VectorImage buffer, are copied into two
+// double arrays and handed to the kernel, which returns their contribution
+// to the sum. Per-voxel sums are checked against one in the same pass.
+// Partial sums are added in thread order.
+//
+// The kernel is a copyable object with a method
+//   double Evaluate(double* a, double* b, unsigned int n) const
+// that may overwrite both arrays.
+
+#ifndef _ProbabilityImagePairSum_h
+#define _ProbabilityImagePairSum_h
+
+#include "ImageRegionPairSplitter.h"
+
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include <vector>
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+class ProbabilityImagePairSum: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef ProbabilityImagePairSum                            Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  typedef TFixedImage FixedImageType;
+  typedef TMovingImage MovingImageType;
+  typedef TKernel KernelType;
+
+  typedef typename FixedImageType::RegionType FixedRegionType;
+  typedef typename MovingImageType::RegionType MovingRegionType;
+
+  typedef ImageRegionPairSplitter<FixedImageType::ImageDimension> SplitterType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ProbabilityImagePairSum, itk::Object);
+
+  void SetFixedImage(const FixedImageType* img) { m_FixedImage = img; }
+  void SetMovingImage(const MovingImageType* img) { m_MovingImage = img; }
+
+  void SetKernel(const KernelType& kernel) { m_Kernel = kernel; }
+  const KernelType& GetKernel() const { return m_Kernel; }
+
+  /** Largest allowed difference between a voxel's component sum and one. */
+  itkSetMacro(NormalizationTolerance, double);
+  itkGetConstMacro(NormalizationTolerance, double);
+
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  void Compute();
+
+  double GetSum() const { return m_Sum; }
+
+  /** Whether every voxel of the image is a probability density. */
+  bool GetFixedIsDensity() const { return m_FixedIsDensity; }
+  bool GetMovingIsDensity() const { return m_MovingIsDensity; }
+
+protected:
+
+  ProbabilityImagePairSum();
+  ~ProbabilityImagePairSum();
+
+  struct ThreadResultType
+  {
+    double Sum;
+    bool FixedIsDensity;
+    bool MovingIsDensity;
+  };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void* arg);
+
+  void ThreadedCompute(unsigned int threadId, unsigned int numThreads);
+
+  // Copies numPixels pixels of vector length numComponents starting at the
+  // buffer offset into values and checks that each pixel sums to one
+  template <class TImage>
+  bool CopyRow(const TImage* img, itk::OffsetValueType offset,
+    unsigned int numPixels, unsigned int numComponents, double* values) const;
+
+  typename FixedImageType::ConstPointer m_FixedImage;
+  typename MovingImageType::ConstPointer m_MovingImage;
+
+  KernelType m_Kernel;
+
+  double m_NormalizationTolerance;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  double m_Sum;
+  bool m_FixedIsDensity;
+  bool m_MovingIsDensity;
+
+  std::vector<ThreadResultType> m_ThreadResults;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "ProbabilityImagePairSum.txx"
+#endif
+
+#endif
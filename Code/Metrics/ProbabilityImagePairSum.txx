@@ -0,0 +1,193 @@
+
+#ifndef _ProbabilityImagePairSum_txx
+#define _ProbabilityImagePairSum_txx
+
+#include "ProbabilityImagePairSum.h"
+
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+#include <cmath>
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+ProbabilityImagePairSum<TFixedImage, TMovingImage, TKernel>
+::ProbabilityImagePairSum()
+{
+  m_NormalizationTolerance = 1e-4;
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  m_Sum = 0;
+  m_FixedIsDensity = true;
+  m_MovingIsDensity = true;
+}
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+ProbabilityImagePairSum<TFixedImage, TMovingImage, TKernel>
+::~ProbabilityImagePairSum()
+{
+
+}
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+void
+ProbabilityImagePairSum<TFixedImage, TMovingImage, TKernel>
+::Compute()
+{
+  if (m_FixedImage.IsNull() || m_MovingImage.IsNull())
+    itkExceptionMacro(<< "Need two input probability density images");
+
+  if (m_FixedImage->GetVectorLength() != m_MovingImage->GetVectorLength())
+    itkExceptionMacro(<< "Probability density images have different numbers of components");
+
+  // Regions of different size are walked in lockstep on a single thread
+  unsigned int numThreads = SplitterType::GetNumberOfSplits(
+    m_FixedImage->GetRequestedRegion(), m_MovingImage->GetRequestedRegion(),
+    m_NumberOfThreads);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(Self::ThreaderCallback, this);
+
+  m_ThreadResults.clear();
+  m_ThreadResults.resize(threader->GetNumberOfThreads());
+
+  threader->SingleMethodExecute();
+
+  // Reduce partial sums in thread order
+  m_Sum = 0;
+  m_FixedIsDensity = true;
+  m_MovingIsDensity = true;
+
+  for (unsigned int t = 0; t < m_ThreadResults.size(); t++)
+  {
+    m_Sum += m_ThreadResults[t].Sum;
+    m_FixedIsDensity = m_FixedIsDensity && m_ThreadResults[t].FixedIsDensity;
+    m_MovingIsDensity = m_MovingIsDensity && m_ThreadResults[t].MovingIsDensity;
+  }
+
+  m_ThreadResults.clear();
+}
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+ITK_THREAD_RETURN_TYPE
+ProbabilityImagePairSum<TFixedImage, TMovingImage, TKernel>
+::ThreaderCallback(void* arg)
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType* info = static_cast<ThreadInfoType*>(arg);
+
+  Self* self = static_cast<Self*>(info->UserData);
+  self->ThreadedCompute(info->ThreadID, info->NumberOfThreads);
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+template <class TImage>
+bool
+ProbabilityImagePairSum<TFixedImage, TMovingImage, TKernel>
+::CopyRow(const TImage* img, itk::OffsetValueType offset,
+  unsigned int numPixels, unsigned int numComponents, double* values) const
+{
+  const typename TImage::InternalPixelType* src =
+    img->GetBufferPointer() + offset * numComponents;
+
+  unsigned int numValues = numPixels * numComponents;
+  for (unsigned int i = 0; i < numValues; i++)
+    values[i] = src[i];
+
+  bool isDensity = true;
+  for (unsigned int p = 0; p < numPixels; p++)
+  {
+    const double* pixel = values + p * numComponents;
+
+    double sum = 0;
+    for (unsigned int c = 0; c < numComponents; c++)
+      sum += pixel[c];
+
+    if (std::fabs(sum - 1.0) > m_NormalizationTolerance)
+      isDensity = false;
+  }
+
+  return isDensity;
+}
+
+template <class TFixedImage, class TMovingImage, class TKernel>
+void
+ProbabilityImagePairSum<TFixedImage, TMovingImage, TKernel>
+::ThreadedCompute(unsigned int threadId, unsigned int numThreads)
+{
+  ThreadResultType& result = m_ThreadResults[threadId];
+  result.Sum = 0;
+  result.FixedIsDensity = true;
+  result.MovingIsDensity = true;
+
+  FixedRegionType fixedRegion = m_FixedImage->GetRequestedRegion();
+  MovingRegionType movingRegion = m_MovingImage->GetRequestedRegion();
+
+  if (!SplitterType::GetSplit(threadId, numThreads, fixedRegion, movingRegion))
+    return;
+
+  unsigned int numComponents = m_FixedImage->GetVectorLength();
+
+  // Regions of different size are compared pixel by pixel in raster order,
+  // otherwise row by row
+  bool sameSize = (fixedRegion.GetSize() == movingRegion.GetSize());
+
+  unsigned int rowLength = 1;
+  FixedRegionType rowStarts = fixedRegion;
+  if (sameSize)
+  {
+    rowLength = fixedRegion.GetSize()[0];
+    typename FixedRegionType::SizeType size = fixedRegion.GetSize();
+    size[0] = 1;
+    rowStarts.SetSize(size);
+  }
+
+  std::vector<double> fixedValues(rowLength * numComponents);
+  std::vector<double> movingValues(rowLength * numComponents);
+
+  KernelType kernel = m_Kernel;
+
+  typedef itk::ImageRegionConstIteratorWithIndex<FixedImageType> FixedIteratorType;
+  typedef itk::ImageRegionConstIteratorWithIndex<MovingImageType> MovingIteratorType;
+
+  FixedIteratorType fixedIt(m_FixedImage, rowStarts);
+  MovingIteratorType movingIt(m_MovingImage, movingRegion);
+
+  fixedIt.GoToBegin();
+  movingIt.GoToBegin();
+  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
+  {
+    typename FixedImageType::IndexType fixedIndex = fixedIt.GetIndex();
+
+    typename MovingImageType::IndexType movingIndex;
+    if (sameSize)
+    {
+      for (unsigned int dim = 0; dim < FixedImageType::ImageDimension; dim++)
+        movingIndex[dim] = fixedIndex[dim]
+          - fixedRegion.GetIndex()[dim] + movingRegion.GetIndex()[dim];
+    }
+    else
+    {
+      movingIndex = movingIt.GetIndex();
+      ++movingIt;
+    }
+
+    if (!this->CopyRow(m_FixedImage.GetPointer(),
+        m_FixedImage->ComputeOffset(fixedIndex),
+        rowLength, numComponents, &fixedValues[0]))
+      result.FixedIsDensity = false;
+
+    if (!this->CopyRow(m_MovingImage.GetPointer(),
+        m_MovingImage->ComputeOffset(movingIndex),
+        rowLength, numComponents, &movingValues[0]))
+      result.MovingIsDensity = false;
+
+    result.Sum += kernel.Evaluate(
+      &fixedValues[0], &movingValues[0], rowLength * numComponents);
+
+    ++fixedIt;
+  }
+}
+
+#endif
@@ -7,6 +7,7 @@
 #define _SensitivityImageToImageMetric_h
 
 #include "AbstractValidationMetric.h"
+#include "BinaryOverlapCounts.h"
 
 #include "itkImageToImageMetric.h"
 #include "itkSmartPointer.h"
@@ -47,6 +48,9 @@ public:
   /**  Get the value for single valued optimizers. */
   MeasureType GetValue() const;
 
+  /** Compute the metric from precomputed truth/test overlap counts. */
+  static MeasureType ComputeValue(const BinaryOverlapCounts& counts);
+
   MeasureType GetValue(const TransformParametersType& p) const
   { // TODO: apply transform with nearest neighbor interpolation
     return this->GetValue(); }
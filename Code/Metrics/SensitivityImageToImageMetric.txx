@@ -4,7 +4,7 @@
 
 #include "SensitivityImageToImageMetric.h"
 
-#include "itkImageRegionIterator.h"
+#include "BinaryOverlapCounter.h"
 
 template <class TFixedImage, class TMovingImage>
 SensitivityImageToImageMetric<TFixedImage, TMovingImage>
@@ -28,38 +28,24 @@ SensitivityImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Define iterators
-  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
-  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+  // Get counts of true/false positives and negatives, split over threads
+  typedef BinaryOverlapCounter<FixedImageType, MovingImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->SetFixedImage(Superclass::m_FixedImage);
+  counter->SetMovingImage(Superclass::m_MovingImage);
+  counter->SetNumberOfThreads(this->GetNumberOfThreads());
+  counter->Compute();
 
-  FixedIteratorType fixedIt(Superclass::m_FixedImage, Superclass::m_FixedImage->GetRequestedRegion());
-  MovingIteratorType movingIt(Superclass::m_MovingImage, Superclass::m_MovingImage->GetRequestedRegion());
-
-  // Get count of true negatives and false positives
-  unsigned int numTruePositives = 0;
-  unsigned int numFalseNegatives = 0;
-
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
-  {
-    unsigned int r = (unsigned int)fixedIt.Get();
-    unsigned int c = (unsigned int)movingIt.Get();
-
-    bool a = (r != 0);
-    bool b = (c != 0);
-      
-    if (a && b)
-      numTruePositives++;
-
-    if (a && !b)
-      numFalseNegatives++;
-
-    ++fixedIt;
-    ++movingIt;
-  }
+  return Self::ComputeValue(counter->GetCounts());
+}
 
-  return numTruePositives / (numTruePositives + numFalseNegatives + 1e-20);
+template <class TFixedImage, class TMovingImage>
+typename SensitivityImageToImageMetric<TFixedImage,TMovingImage>::MeasureType
+SensitivityImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeValue(const BinaryOverlapCounts& counts)
+{
+  return counts.TruePositives /
+    (counts.TruePositives + counts.FalseNegatives + 1e-20);
 }
 
 #endif
@@ -4,7 +4,7 @@
 
 #include "SpecificityImageToImageMetric.h"
 
-#include "itkImageRegionIterator.h"
+#include "BinaryOverlapCounter.h"
 
 template <class TFixedImage, class TMovingImage>
 SpecificityImageToImageMetric<TFixedImage, TMovingImage>
@@ -28,38 +28,24 @@ SpecificityImageToImageMetric<TFixedImage, TMovingImage>
   if (Superclass::m_FixedImage.IsNull() || Superclass::m_MovingImage.IsNull())
     itkExceptionMacro(<< "Need two input classification images");
 
-  // Define iterators
-  typedef itk::ImageRegionConstIterator<FixedImageType> FixedIteratorType;
-  typedef itk::ImageRegionConstIterator<MovingImageType> MovingIteratorType;
+  // Get counts of true/false positives and negatives, split over threads
+  typedef BinaryOverlapCounter<FixedImageType, MovingImageType> CounterType;
+  typename CounterType::Pointer counter = CounterType::New();
+  counter->SetFixedImage(Superclass::m_FixedImage);
+  counter->SetMovingImage(Superclass::m_MovingImage);
+  counter->SetNumberOfThreads(this->GetNumberOfThreads());
+  counter->Compute();
 
-  FixedIteratorType fixedIt(Superclass::m_FixedImage, Superclass::m_FixedImage->GetRequestedRegion());
-  MovingIteratorType movingIt(Superclass::m_MovingImage, Superclass::m_MovingImage->GetRequestedRegion());
-
-  // Get count of true negatives and false positives
-  unsigned int numTrueNegatives = 0;
-  unsigned int numFalsePositives = 0;
-
-  fixedIt.GoToBegin();
-  movingIt.GoToBegin();
-  while (!fixedIt.IsAtEnd() && !movingIt.IsAtEnd())
-  {
-    unsigned int r = (unsigned int)fixedIt.Get();
-    unsigned int c = (unsigned int)movingIt.Get();
-
-    bool a = (r != 0);
-    bool b = (c != 0);
-      
-    if (!a && !b)
-      numTrueNegatives++;
-
-    if (!a && b)
-      numFalsePositives++;
-
-    ++fixedIt;
-    ++movingIt;
-  }
+  return Self::ComputeValue(counter->GetCounts());
+}
 
-  return numTrueNegatives / (numTrueNegatives + numFalsePositives + 1e-20);
+template <class TFixedImage, class TMovingImage>
+typename SpecificityImageToImageMetric<TFixedImage,TMovingImage>::MeasureType
+SpecificityImageToImageMetric<TFixedImage, TMovingImage>
+::ComputeValue(const BinaryOverlapCounts& counts)
+{
+  return counts.TrueNegatives /
+    (counts.TrueNegatives + counts.FalsePositives + 1e-20);
 }
 
 #endif
@@ -0,0 +1,265 @@
+// Shared boundary and distance map data for the image surface distance
+// metrics (Hausdorff and average distance)
+//
+// Entries are keyed by image and label: label 0 selects every nonzero voxel,
+// which is how binary mask inputs are handled, any other label selects the
+// voxels equal to it. For each entry the cache computes, once and on demand,
+// the voxel count, the inner boundary voxel list and the signed Maurer
+// distance map, with boundary voxels listed straight from the image by a
+// LabelBoundaryExtractor. Metrics given the same cache object then share
+// this work instead of recomputing it. Distances are read from the map
+// directly at voxel centers, so no spline coefficients are computed for
+// images on the same grid.
+//
+// With CropToBoundingBoxOn, the distance map and boundary of a pair are only
+// computed over the union bounding box of the label in both images, padded by
+// CropMargin voxels (at least one, plus the blur kernel radius when blurring).
+// All voxels of the label lie in the box, so distances at the boundary voxels
+// are the same as on the full volume. Pairs without matching geometry, boxes
+// covering most of the volume and query points outside the box fall back to
+// the full volume.
+//
+// Voxel counts and bounding boxes of all labels in an image come from a
+// single LabelImageInventory pass, kept until the image changes or the cache
+// is cleared.
+//
+// Precompute fills in the inventory and the surface of every label of an
+// image ahead of time, and WriteImageEntries and ReadImageEntries save and
+// restore them, so the ground truth side of a pair can be loaded from disk
+// rather than recomputed for each submission (see GroundTruthCache).
+//
+// Entries hold a reference to their image and are recomputed if the image
+// is modified. Not thread safe; use one cache per thread.
+
+#ifndef _SurfaceDistanceCache_h
+#define _SurfaceDistanceCache_h
+
+#include "LabelImageInventory.h"
+
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+template <class TImage>
+class SurfaceDistanceCache: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef SurfaceDistanceCache                               Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SurfaceDistanceCache, itk::Object);
+
+  typedef TImage ImageType;
+  typedef typename ImageType::ConstPointer ImageConstPointer;
+  typedef typename ImageType::IndexType IndexType;
+  typedef typename ImageType::PixelType PixelType;
+  typedef typename ImageType::PointType PointType;
+  typedef typename ImageType::RegionType RegionType;
+
+  typedef itk::Image<float, ImageType::ImageDimension> DistanceImageType;
+  typedef typename DistanceImageType::Pointer DistanceImagePointer;
+
+  typedef itk::BSplineInterpolateImageFunction<DistanceImageType, double>
+    InterpolatorType;
+  typedef typename InterpolatorType::Pointer InterpolatorPointer;
+  typedef typename InterpolatorType::ContinuousIndexType ContinuousIndexType;
+
+  typedef std::vector<IndexType> IndexListType;
+
+  typedef LabelImageInventory<ImageType> InventoryType;
+
+  itkSetMacro(CropToBoundingBox, bool);
+  itkGetConstMacro(CropToBoundingBox, bool);
+  itkBooleanMacro(CropToBoundingBox);
+
+  itkSetMacro(CropMargin, unsigned int);
+  itkGetConstMacro(CropMargin, unsigned int);
+
+  /**
+   * Distances at boundary voxels that fall between voxel centers of the
+   * other image are interpolated with a cubic B-spline fitted to a window
+   * around them (default on), or read from the nearest voxel when off.
+   * Voxel centers are always read directly.
+   */
+  itkSetMacro(SubvoxelDistances, bool);
+  itkGetConstMacro(SubvoxelDistances, bool);
+  itkBooleanMacro(SubvoxelDistances);
+
+  /**
+   * Neighbors checked when finding boundary voxels: 6, 18 (default) or 26
+   * in 3D, see LabelBoundaryExtractor. Changing it clears the cache.
+   */
+  void SetBoundaryConnectivity(unsigned int connectivity);
+  itkGetConstMacro(BoundaryConnectivity, unsigned int);
+
+  /** Threads used when taking the label inventory of an image. */
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  /** Labels present in the image with their counts and bounding boxes. */
+  const InventoryType* GetLabelImageInventory(const ImageType* img);
+
+  /** Number of voxels that belong to the label. */
+  itk::SizeValueType GetNumberOfVoxels(const ImageType* img, PixelType label);
+
+  /** Bounding box of the label, empty if the label is absent. */
+  const RegionType& GetBoundingBox(const ImageType* img, PixelType label);
+
+  /**
+   * Inner boundary voxels of the label, taken from the surface if one is
+   * held, otherwise extracted over the bounding box without computing a
+   * distance map.
+   */
+  const IndexListType& GetBoundaryIndices(const ImageType* img, PixelType label);
+
+  /**
+   * Signed distance map to the label surface over the full volume,
+   * optionally blurred.
+   */
+  const DistanceImageType* GetDistanceMap(
+    const ImageType* img, PixelType label, bool blurred);
+
+  /**
+   * Unsigned distances from each boundary voxel of the label in fromImg to
+   * the label surface in toImg. Boundary voxels that map outside toImg are
+   * skipped.
+   */
+  void ComputeBoundaryDistances(
+    const ImageType* fromImg, const ImageType* toImg, PixelType label,
+    bool blurred, std::vector<double>& distances);
+
+  /**
+   * Computes the boundary and distance map of every label in the image,
+   * over the region pairs are cropped to when the label in the other image
+   * lies within padding voxels of its bounding box here. Other pairs
+   * recompute the surface over a larger region as usual.
+   */
+  void Precompute(const ImageType* img, unsigned int padding);
+
+  /**
+   * Writes the inventory and label surfaces computed for the image, in
+   * binary form and the native byte order. Blurred maps are not written.
+   */
+  void WriteImageEntries(const ImageType* img, std::ostream& os);
+
+  /**
+   * Restores entries written by WriteImageEntries for an image with the
+   * same contents and geometry, in place of any held for it. Returns false,
+   * with no entries added, if the stream ends early.
+   */
+  bool ReadImageEntries(const ImageType* img, std::istream& is);
+
+  /** Drop all entries for a label, in every image. */
+  void ReleaseLabel(PixelType label);
+
+  /** Drop all entries. */
+  void Clear();
+
+protected:
+
+  SurfaceDistanceCache();
+  ~SurfaceDistanceCache();
+
+  struct EntryType
+  {
+    ImageConstPointer Image;
+    unsigned long ImageMTime;
+
+    bool HasNumberOfVoxels;
+    itk::SizeValueType NumberOfVoxels;
+    RegionType BoundingBox;
+
+    bool HasBoundary;
+    IndexListType BoundaryIndices;
+
+    bool HasSurface;
+    RegionType SurfaceRegion;
+    DistanceImagePointer DistanceMap;
+    DistanceImagePointer BlurredDistanceMap;
+  };
+
+  typedef std::pair<const ImageType*, PixelType> KeyType;
+  typedef std::map<KeyType, EntryType> EntryMapType;
+
+  struct InventoryEntryType
+  {
+    ImageConstPointer Image;
+    unsigned long ImageMTime;
+    typename InventoryType::Pointer Inventory;
+  };
+
+  typedef std::map<const ImageType*, InventoryEntryType> InventoryMapType;
+
+  EntryType& GetEntry(const ImageType* img, PixelType label);
+
+  void ComputeNumberOfVoxels(EntryType& entry, PixelType label);
+
+  EntryType& GetSurfaceEntry(
+    const ImageType* img, PixelType label, const RegionType& region);
+
+  const DistanceImageType* GetDistanceImage(EntryType& entry, bool blurred);
+
+  void ComputeSurface(EntryType& entry, PixelType label, const RegionType& region);
+
+  // Region to compute a pair over, the full volume unless cropping applies
+  RegionType GetPairRegion(
+    const ImageType* fromImg, const ImageType* toImg, PixelType label,
+    bool blurred);
+
+  // Returns false if a boundary voxel maps inside toImg but outside the
+  // region the distance map was computed over
+  bool ComputeBoundaryDistances(
+    const ImageType* fromImg, const ImageType* toImg, PixelType label,
+    bool blurred, const RegionType& region, std::vector<double>& distances);
+
+  // Cubic B-spline values of distMap at the points, with coefficients only
+  // computed over the box around them
+  void InterpolateDistances(const DistanceImageType* distMap,
+    const std::vector<ContinuousIndexType>& points, std::vector<double>& values);
+
+  // Voxels added around the interpolation box, the influence of the window
+  // edge decays by about 0.27 per voxel
+  static const unsigned int SplineWindowPadding = 12;
+
+  static void WriteRegion(std::ostream& os, const RegionType& region);
+  static void ReadRegion(std::istream& is, RegionType& region);
+
+  static double GetBlurVariance(const typename ImageType::SpacingType& spacing);
+
+  static unsigned int GetBlurRadius(const typename ImageType::SpacingType& spacing);
+
+  bool m_CropToBoundingBox;
+  unsigned int m_CropMargin;
+
+  bool m_SubvoxelDistances;
+
+  unsigned int m_BoundaryConnectivity;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  EntryMapType m_Entries;
+
+  InventoryMapType m_Inventories;
+
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "SurfaceDistanceCache.txx"
+#endif
+
+#endif
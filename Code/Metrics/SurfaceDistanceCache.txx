@@ -0,0 +1,806 @@
+
+#ifndef _SurfaceDistanceCache_txx
+#define _SurfaceDistanceCache_txx
+
+#include "LabelBoundaryExtractor.h"
+#include "SurfaceDistanceCache.h"
+
+#include "itkBinaryThresholdImageFilter.h"
+#include "itkDiscreteGaussianImageFilter.h"
+#include "itkExtractImageFilter.h"
+#include "itkMath.h"
+#include "itkSignedMaurerDistanceMapImageFilter.h"
+
+#include "vnl/vnl_math.h"
+
+#include <cmath>
+
+template <class TImage>
+SurfaceDistanceCache<TImage>
+::SurfaceDistanceCache()
+{
+  m_CropToBoundingBox = false;
+  m_CropMargin = 2;
+  m_SubvoxelDistances = true;
+  m_BoundaryConnectivity =
+    LabelBoundaryExtractor<ImageType>::GetNumberOfNeighbors(2);
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+template <class TImage>
+SurfaceDistanceCache<TImage>
+::~SurfaceDistanceCache()
+{
+
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::SetBoundaryConnectivity(unsigned int connectivity)
+{
+  if (connectivity == m_BoundaryConnectivity)
+    return;
+
+  // Boundaries computed so far used the old connectivity
+  m_BoundaryConnectivity = connectivity;
+  this->Clear();
+  this->Modified();
+}
+
+template <class TImage>
+double
+SurfaceDistanceCache<TImage>
+::GetBlurVariance(const typename ImageType::SpacingType& spacing)
+{
+  double minSpacing = spacing[0];
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    if (spacing[dim] < minSpacing)
+      minSpacing = spacing[dim];
+
+  return 1.5 * minSpacing;
+}
+
+template <class TImage>
+unsigned int
+SurfaceDistanceCache<TImage>
+::GetBlurRadius(const typename ImageType::SpacingType& spacing)
+{
+  // Four standard deviations, bounded by the default maximum kernel width
+  // of DiscreteGaussianImageFilter
+  double variance = GetBlurVariance(spacing);
+
+  unsigned int radius = 0;
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+  {
+    unsigned int r = (unsigned int)
+      std::ceil(4.0 * std::sqrt(variance) / spacing[dim]);
+    if (r > radius)
+      radius = r;
+  }
+
+  if (radius > 16)
+    radius = 16;
+
+  return radius;
+}
+
+template <class TImage>
+typename SurfaceDistanceCache<TImage>::EntryType&
+SurfaceDistanceCache<TImage>
+::GetEntry(const ImageType* img, PixelType label)
+{
+  if (img == 0)
+    itkExceptionMacro(<< "Image undefined");
+
+  KeyType key(img, label);
+
+  typename EntryMapType::iterator it = m_Entries.find(key);
+
+  // Stale if the image changed since the entry was computed
+  if (it != m_Entries.end() && it->second.ImageMTime != img->GetMTime())
+  {
+    m_Entries.erase(it);
+    it = m_Entries.end();
+  }
+
+  if (it == m_Entries.end())
+  {
+    EntryType entry;
+    entry.Image = img;
+    entry.ImageMTime = img->GetMTime();
+    entry.HasNumberOfVoxels = false;
+    entry.NumberOfVoxels = 0;
+    entry.HasBoundary = false;
+    entry.HasSurface = false;
+
+    it = m_Entries.insert(std::make_pair(key, entry)).first;
+  }
+
+  return it->second;
+}
+
+template <class TImage>
+const typename SurfaceDistanceCache<TImage>::InventoryType*
+SurfaceDistanceCache<TImage>
+::GetLabelImageInventory(const ImageType* img)
+{
+  if (img == 0)
+    itkExceptionMacro(<< "Image undefined");
+
+  typename InventoryMapType::iterator it = m_Inventories.find(img);
+
+  if (it != m_Inventories.end() && it->second.ImageMTime != img->GetMTime())
+  {
+    m_Inventories.erase(it);
+    it = m_Inventories.end();
+  }
+
+  if (it == m_Inventories.end())
+  {
+    InventoryEntryType entry;
+    entry.Image = img;
+    entry.ImageMTime = img->GetMTime();
+    entry.Inventory = InventoryType::New();
+    entry.Inventory->SetImage(img);
+    entry.Inventory->SetNumberOfThreads(m_NumberOfThreads);
+    entry.Inventory->Update();
+
+    it = m_Inventories.insert(std::make_pair(img, entry)).first;
+  }
+
+  return it->second.Inventory;
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::ComputeNumberOfVoxels(EntryType& entry, PixelType label)
+{
+  // One pass over the image gives the counts and boxes of every label
+  const InventoryType* inventory = this->GetLabelImageInventory(entry.Image);
+
+  entry.NumberOfVoxels = inventory->GetNumberOfVoxels(label);
+  entry.BoundingBox = inventory->GetBoundingBox(label);
+  entry.HasNumberOfVoxels = true;
+}
+
+template <class TImage>
+itk::SizeValueType
+SurfaceDistanceCache<TImage>
+::GetNumberOfVoxels(const ImageType* img, PixelType label)
+{
+  EntryType& entry = this->GetEntry(img, label);
+
+  if (!entry.HasNumberOfVoxels)
+    this->ComputeNumberOfVoxels(entry, label);
+
+  return entry.NumberOfVoxels;
+}
+
+template <class TImage>
+const typename SurfaceDistanceCache<TImage>::RegionType&
+SurfaceDistanceCache<TImage>
+::GetBoundingBox(const ImageType* img, PixelType label)
+{
+  EntryType& entry = this->GetEntry(img, label);
+
+  if (!entry.HasNumberOfVoxels)
+    this->ComputeNumberOfVoxels(entry, label);
+
+  return entry.BoundingBox;
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::ComputeSurface(EntryType& entry, PixelType label, const RegionType& region)
+{
+  // Restrict to the requested region, keeping the original index space
+  ImageConstPointer input = entry.Image;
+  if (region != entry.Image->GetLargestPossibleRegion())
+  {
+    typedef itk::ExtractImageFilter<ImageType, ImageType> ExtractFilterType;
+    typename ExtractFilterType::Pointer extractf = ExtractFilterType::New();
+    extractf->SetInput(entry.Image);
+    extractf->SetExtractionRegion(region);
+    extractf->SetDirectionCollapseToSubmatrix();
+    extractf->SetNumberOfThreads(m_NumberOfThreads);
+    extractf->Update();
+
+    input = extractf->GetOutput();
+  }
+
+  // Binary mask for the label, nonzero voxels are used as is
+  ImageConstPointer mask = input;
+  if (label != 0)
+  {
+    typedef itk::BinaryThresholdImageFilter<ImageType, ImageType>
+      ThresholdFilterType;
+    typename ThresholdFilterType::Pointer thresf = ThresholdFilterType::New();
+    thresf->SetInput(input);
+    thresf->SetLowerThreshold(label);
+    thresf->SetUpperThreshold(label);
+    thresf->SetInsideValue(1);
+    thresf->SetOutsideValue(0);
+    thresf->SetNumberOfThreads(m_NumberOfThreads);
+    thresf->Update();
+
+    mask = thresf->GetOutput();
+  }
+
+  // Compute distance transform
+  typedef itk::SignedMaurerDistanceMapImageFilter<
+    ImageType, DistanceImageType> DistanceMapFilterType;
+
+  typename DistanceMapFilterType::Pointer distanceMapFilter =
+    DistanceMapFilterType::New();
+
+  distanceMapFilter->InsideIsPositiveOff();
+  distanceMapFilter->SetInput(mask);
+  distanceMapFilter->SquaredDistanceOff();
+  distanceMapFilter->UseImageSpacingOn();
+  distanceMapFilter->SetNumberOfThreads(m_NumberOfThreads);
+
+  distanceMapFilter->Update();
+
+  entry.DistanceMap = distanceMapFilter->GetOutput();
+  entry.BlurredDistanceMap = 0;
+
+  // Inner boundary, read from the image itself over the same region
+  typedef LabelBoundaryExtractor<ImageType> BoundaryExtractorType;
+  typename BoundaryExtractorType::Pointer boundaryExtractor =
+    BoundaryExtractorType::New();
+  boundaryExtractor->SetConnectivity(m_BoundaryConnectivity);
+  boundaryExtractor->Compute(entry.Image, label, region, entry.BoundaryIndices);
+  entry.HasBoundary = true;
+
+  entry.SurfaceRegion = region;
+  entry.HasSurface = true;
+}
+
+template <class TImage>
+typename SurfaceDistanceCache<TImage>::EntryType&
+SurfaceDistanceCache<TImage>
+::GetSurfaceEntry(const ImageType* img, PixelType label, const RegionType& region)
+{
+  EntryType& entry = this->GetEntry(img, label);
+
+  if (!entry.HasSurface || !entry.SurfaceRegion.IsInside(region))
+    this->ComputeSurface(entry, label, region);
+
+  return entry;
+}
+
+template <class TImage>
+const typename SurfaceDistanceCache<TImage>::DistanceImageType*
+SurfaceDistanceCache<TImage>
+::GetDistanceImage(EntryType& entry, bool blurred)
+{
+  if (!blurred)
+    return entry.DistanceMap;
+
+  if (entry.BlurredDistanceMap.IsNull())
+  {
+    typedef itk::DiscreteGaussianImageFilter<
+      DistanceImageType, DistanceImageType> BlurFilterType;
+
+    typename BlurFilterType::Pointer blurf = BlurFilterType::New();
+    blurf->SetInput(entry.DistanceMap);
+    blurf->SetVariance(GetBlurVariance(entry.DistanceMap->GetSpacing()));
+    blurf->SetNumberOfThreads(m_NumberOfThreads);
+    blurf->Update();
+
+    entry.BlurredDistanceMap = blurf->GetOutput();
+  }
+
+  return entry.BlurredDistanceMap;
+}
+
+template <class TImage>
+const typename SurfaceDistanceCache<TImage>::IndexListType&
+SurfaceDistanceCache<TImage>
+::GetBoundaryIndices(const ImageType* img, PixelType label)
+{
+  EntryType& entry = this->GetEntry(img, label);
+
+  // Surfaces are computed with background around the label, so the
+  // boundary of any surface held is that of the full volume
+  if (!entry.HasBoundary)
+  {
+    entry.BoundaryIndices.clear();
+
+    RegionType box = this->GetBoundingBox(img, label);
+    if (box.GetNumberOfPixels() > 0)
+    {
+      box.PadByRadius(1);
+      box.Crop(img->GetLargestPossibleRegion());
+
+      typedef LabelBoundaryExtractor<ImageType> BoundaryExtractorType;
+      typename BoundaryExtractorType::Pointer boundaryExtractor =
+        BoundaryExtractorType::New();
+      boundaryExtractor->SetConnectivity(m_BoundaryConnectivity);
+      boundaryExtractor->Compute(img, label, box, entry.BoundaryIndices);
+    }
+
+    entry.HasBoundary = true;
+  }
+
+  return entry.BoundaryIndices;
+}
+
+template <class TImage>
+const typename SurfaceDistanceCache<TImage>::DistanceImageType*
+SurfaceDistanceCache<TImage>
+::GetDistanceMap(const ImageType* img, PixelType label, bool blurred)
+{
+  EntryType& entry =
+    this->GetSurfaceEntry(img, label, img->GetLargestPossibleRegion());
+
+  return this->GetDistanceImage(entry, blurred);
+}
+
+template <class TImage>
+typename SurfaceDistanceCache<TImage>::RegionType
+SurfaceDistanceCache<TImage>
+::GetPairRegion(
+  const ImageType* fromImg, const ImageType* toImg, PixelType label,
+  bool blurred)
+{
+  RegionType fullRegion = toImg->GetLargestPossibleRegion();
+
+  if (!m_CropToBoundingBox)
+    return fullRegion;
+
+  // Boxes are only comparable if both images share the index space
+  if (fromImg->GetLargestPossibleRegion() != fullRegion
+      || fromImg->GetOrigin() != toImg->GetOrigin()
+      || fromImg->GetSpacing() != toImg->GetSpacing()
+      || fromImg->GetDirection() != toImg->GetDirection())
+    return fullRegion;
+
+  const RegionType& fromBox = this->GetBoundingBox(fromImg, label);
+  const RegionType& toBox = this->GetBoundingBox(toImg, label);
+
+  RegionType box;
+  if (fromBox.GetNumberOfPixels() == 0)
+  {
+    box = toBox;
+  }
+  else if (toBox.GetNumberOfPixels() == 0)
+  {
+    box = fromBox;
+  }
+  else
+  {
+    IndexType index;
+    typename RegionType::SizeType size;
+    for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    {
+      itk::IndexValueType first = fromBox.GetIndex(dim);
+      if (toBox.GetIndex(dim) < first)
+        first = toBox.GetIndex(dim);
+
+      itk::IndexValueType last = fromBox.GetUpperIndex()[dim];
+      if (toBox.GetUpperIndex()[dim] > last)
+        last = toBox.GetUpperIndex()[dim];
+
+      index[dim] = first;
+      size[dim] = last - first + 1;
+    }
+    box.SetIndex(index);
+    box.SetSize(size);
+  }
+
+  if (box.GetNumberOfPixels() == 0)
+    return fullRegion;
+
+  // One voxel of background around the label keeps the distance transform
+  // and boundary the same as on the full volume
+  unsigned int margin = m_CropMargin;
+  if (margin < 1)
+    margin = 1;
+
+  if (blurred)
+    margin += GetBlurRadius(toImg->GetSpacing());
+
+  box.PadByRadius(margin);
+  box.Crop(fullRegion);
+
+  // Not worth extracting a copy
+  if (2 * box.GetNumberOfPixels() > fullRegion.GetNumberOfPixels())
+    return fullRegion;
+
+  return box;
+}
+
+template <class TImage>
+bool
+SurfaceDistanceCache<TImage>
+::ComputeBoundaryDistances(
+  const ImageType* fromImg, const ImageType* toImg, PixelType label,
+  bool blurred, const RegionType& region, std::vector<double>& distances)
+{
+  // A cropped region is only used when both images share the index space
+  bool isCropped = (region != toImg->GetLargestPossibleRegion());
+
+  RegionType fromRegion = fromImg->GetLargestPossibleRegion();
+  if (isCropped)
+    fromRegion = region;
+
+  // Map references stay valid as further entries are inserted
+  EntryType& fromEntry = this->GetSurfaceEntry(fromImg, label, fromRegion);
+  EntryType& toEntry = this->GetSurfaceEntry(toImg, label, region);
+
+  const DistanceImageType* distMap = this->GetDistanceImage(toEntry, blurred);
+
+  const RegionType& mapRegion = distMap->GetBufferedRegion();
+
+  isCropped = (toEntry.SurfaceRegion != toImg->GetLargestPossibleRegion());
+
+  const IndexListType& boundary = fromEntry.BoundaryIndices;
+
+  distances.clear();
+  distances.reserve(boundary.size());
+
+  // Points that fall between voxel centers of the distance map
+  std::vector<unsigned int> offGridSlots;
+  std::vector<ContinuousIndexType> offGridPoints;
+
+  for (unsigned int i = 0; i < boundary.size(); i++)
+  {
+    PointType p;
+    fromImg->TransformIndexToPhysicalPoint(boundary[i], p);
+
+    ContinuousIndexType cind;
+    distMap->TransformPhysicalPointToContinuousIndex(p, cind);
+
+    IndexType nearest;
+    bool onGrid = true;
+    for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    {
+      nearest[dim] = itk::Math::Round<itk::IndexValueType>(cind[dim]);
+      if (vnl_math_abs(cind[dim] - nearest[dim]) > 1e-3)
+        onGrid = false;
+    }
+
+    if (!mapRegion.IsInside(nearest))
+    {
+      IndexType ind;
+      if (isCropped && toImg->TransformPhysicalPointToIndex(p, ind))
+        return false;
+      continue;
+    }
+
+    // Exact on voxel centers, which is where the boundary voxels of images
+    // sharing a grid land
+    if (onGrid || !m_SubvoxelDistances)
+    {
+      distances.push_back(vnl_math_abs(distMap->GetPixel(nearest)));
+      continue;
+    }
+
+    offGridSlots.push_back(distances.size());
+    offGridPoints.push_back(cind);
+    distances.push_back(0.0);
+  }
+
+  if (offGridPoints.size() > 0)
+  {
+    std::vector<double> offGridDistances;
+    this->InterpolateDistances(distMap, offGridPoints, offGridDistances);
+
+    for (unsigned int k = 0; k < offGridSlots.size(); k++)
+      distances[offGridSlots[k]] = vnl_math_abs(offGridDistances[k]);
+  }
+
+  return true;
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::InterpolateDistances(const DistanceImageType* distMap,
+  const std::vector<ContinuousIndexType>& points, std::vector<double>& values)
+{
+  const RegionType& mapRegion = distMap->GetBufferedRegion();
+
+  // Spline coefficients are only computed over the box around the points,
+  // padded so the mirrored window edge has no visible effect
+  IndexType minIndex;
+  IndexType maxIndex;
+  for (unsigned int k = 0; k < points.size(); k++)
+    for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    {
+      itk::IndexValueType first =
+        itk::Math::Floor<itk::IndexValueType>(points[k][dim]) - 1;
+      itk::IndexValueType last = first + 3;
+
+      if (k == 0 || first < minIndex[dim])
+        minIndex[dim] = first;
+      if (k == 0 || last > maxIndex[dim])
+        maxIndex[dim] = last;
+    }
+
+  typename RegionType::SizeType size;
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+    size[dim] = maxIndex[dim] - minIndex[dim] + 1;
+
+  RegionType window(minIndex, size);
+  window.PadByRadius(SplineWindowPadding);
+  window.Crop(mapRegion);
+
+  typename DistanceImageType::ConstPointer windowMap = distMap;
+  if (window != mapRegion)
+  {
+    typedef itk::ExtractImageFilter<DistanceImageType, DistanceImageType>
+      ExtractFilterType;
+    typename ExtractFilterType::Pointer extractf = ExtractFilterType::New();
+    extractf->SetInput(distMap);
+    extractf->SetExtractionRegion(window);
+    extractf->SetDirectionCollapseToSubmatrix();
+    extractf->SetNumberOfThreads(m_NumberOfThreads);
+    extractf->Update();
+
+    windowMap = extractf->GetOutput();
+  }
+
+  InterpolatorPointer interp = InterpolatorType::New();
+  interp->SetSplineOrder(3);
+  interp->SetInputImage(windowMap);
+
+  values.resize(points.size());
+  for (unsigned int k = 0; k < points.size(); k++)
+    values[k] = interp->EvaluateAtContinuousIndex(points[k]);
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::ComputeBoundaryDistances(
+  const ImageType* fromImg, const ImageType* toImg, PixelType label,
+  bool blurred, std::vector<double>& distances)
+{
+  RegionType region = this->GetPairRegion(fromImg, toImg, label, blurred);
+
+  if (this->ComputeBoundaryDistances(
+        fromImg, toImg, label, blurred, region, distances))
+    return;
+
+  // Some boundary voxels fall outside the box, redo on the full volume
+  this->ComputeBoundaryDistances(
+    fromImg, toImg, label, blurred, toImg->GetLargestPossibleRegion(), distances);
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::Precompute(const ImageType* img, unsigned int padding)
+{
+  const InventoryType* inventory = this->GetLabelImageInventory(img);
+
+  RegionType fullRegion = img->GetLargestPossibleRegion();
+
+  for (unsigned int i = 0; i < inventory->GetLabels().size(); i++)
+  {
+    PixelType label = inventory->GetLabels()[i];
+
+    // The box GetPairRegion pads when the other label lies inside this
+    // one's, grown by the padding to cover other labels close by
+    RegionType region = fullRegion;
+    if (m_CropToBoundingBox)
+    {
+      unsigned int margin = m_CropMargin;
+      if (margin < 1)
+        margin = 1;
+
+      RegionType box = this->GetBoundingBox(img, label);
+      box.PadByRadius(margin + padding);
+      box.Crop(fullRegion);
+
+      if (2 * box.GetNumberOfPixels() <= fullRegion.GetNumberOfPixels())
+        region = box;
+    }
+
+    this->GetSurfaceEntry(img, label, region);
+  }
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::WriteRegion(std::ostream& os, const RegionType& region)
+{
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+  {
+    itk::int64_t index = region.GetIndex(dim);
+    itk::uint64_t size = region.GetSize(dim);
+    os.write((const char*)&index, sizeof(index));
+    os.write((const char*)&size, sizeof(size));
+  }
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::ReadRegion(std::istream& is, RegionType& region)
+{
+  for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+  {
+    itk::int64_t index = 0;
+    itk::uint64_t size = 0;
+    is.read((char*)&index, sizeof(index));
+    is.read((char*)&size, sizeof(size));
+    region.SetIndex(dim, index);
+    region.SetSize(dim, size);
+  }
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::WriteImageEntries(const ImageType* img, std::ostream& os)
+{
+  this->GetLabelImageInventory(img)->Write(os);
+
+  std::vector<const EntryType*> entries;
+  std::vector<PixelType> labels;
+
+  typename EntryMapType::const_iterator it;
+  for (it = m_Entries.begin(); it != m_Entries.end(); ++it)
+  {
+    if (it->first.first != img || !it->second.HasSurface
+        || it->second.ImageMTime != img->GetMTime())
+      continue;
+
+    labels.push_back(it->first.second);
+    entries.push_back(&it->second);
+  }
+
+  itk::uint64_t numEntries = entries.size();
+  os.write((const char*)&numEntries, sizeof(numEntries));
+
+  for (unsigned int i = 0; i < entries.size(); i++)
+  {
+    const EntryType& entry = *entries[i];
+
+    os.write((const char*)&labels[i], sizeof(PixelType));
+
+    WriteRegion(os, entry.SurfaceRegion);
+
+    itk::uint64_t numBoundary = entry.BoundaryIndices.size();
+    os.write((const char*)&numBoundary, sizeof(numBoundary));
+    for (unsigned int k = 0; k < entry.BoundaryIndices.size(); k++)
+      for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+      {
+        itk::int64_t v = entry.BoundaryIndices[k][dim];
+        os.write((const char*)&v, sizeof(v));
+      }
+
+    const RegionType& mapRegion = entry.DistanceMap->GetBufferedRegion();
+    WriteRegion(os, mapRegion);
+    os.write((const char*)entry.DistanceMap->GetBufferPointer(),
+      mapRegion.GetNumberOfPixels() * sizeof(float));
+  }
+}
+
+template <class TImage>
+bool
+SurfaceDistanceCache<TImage>
+::ReadImageEntries(const ImageType* img, std::istream& is)
+{
+  if (img == 0)
+    itkExceptionMacro(<< "Image undefined");
+
+  RegionType fullRegion = img->GetLargestPossibleRegion();
+
+  InventoryEntryType inventoryEntry;
+  inventoryEntry.Image = img;
+  inventoryEntry.ImageMTime = img->GetMTime();
+  inventoryEntry.Inventory = InventoryType::New();
+  inventoryEntry.Inventory->SetImage(img);
+  inventoryEntry.Inventory->SetNumberOfThreads(m_NumberOfThreads);
+  if (!inventoryEntry.Inventory->Read(is))
+    return false;
+
+  itk::uint64_t numEntries = 0;
+  is.read((char*)&numEntries, sizeof(numEntries));
+
+  std::vector< std::pair<PixelType, EntryType> > entries;
+
+  for (itk::uint64_t i = 0; i < numEntries && is.good(); i++)
+  {
+    PixelType label;
+    is.read((char*)&label, sizeof(PixelType));
+
+    EntryType entry;
+    entry.Image = img;
+    entry.ImageMTime = img->GetMTime();
+    entry.HasNumberOfVoxels = false;
+    entry.NumberOfVoxels = 0;
+    entry.HasBoundary = true;
+    entry.HasSurface = true;
+
+    ReadRegion(is, entry.SurfaceRegion);
+
+    itk::uint64_t numBoundary = 0;
+    is.read((char*)&numBoundary, sizeof(numBoundary));
+    if (!is.good() || !fullRegion.IsInside(entry.SurfaceRegion)
+        || numBoundary > entry.SurfaceRegion.GetNumberOfPixels())
+      return false;
+
+    entry.BoundaryIndices.resize(numBoundary);
+    for (itk::uint64_t k = 0; k < numBoundary; k++)
+      for (unsigned int dim = 0; dim < ImageType::ImageDimension; dim++)
+      {
+        itk::int64_t v = 0;
+        is.read((char*)&v, sizeof(v));
+        entry.BoundaryIndices[k][dim] = v;
+      }
+
+    // Same index space and geometry as the image, as computed
+    RegionType mapRegion;
+    ReadRegion(is, mapRegion);
+    if (!is.good() || !fullRegion.IsInside(mapRegion))
+      return false;
+
+    entry.DistanceMap = DistanceImageType::New();
+    entry.DistanceMap->SetRegions(mapRegion);
+    entry.DistanceMap->SetOrigin(img->GetOrigin());
+    entry.DistanceMap->SetSpacing(img->GetSpacing());
+    entry.DistanceMap->SetDirection(img->GetDirection());
+    entry.DistanceMap->Allocate();
+    is.read((char*)entry.DistanceMap->GetBufferPointer(),
+      mapRegion.GetNumberOfPixels() * sizeof(float));
+
+    entries.push_back(std::make_pair(label, entry));
+  }
+
+  if (!is.good())
+    return false;
+
+  // Replace whatever was held for the image
+  typename EntryMapType::iterator eit = m_Entries.begin();
+  while (eit != m_Entries.end())
+  {
+    if (eit->first.first == img)
+      m_Entries.erase(eit++);
+    else
+      ++eit;
+  }
+
+  m_Inventories.erase(img);
+  m_Inventories.insert(std::make_pair(img, inventoryEntry));
+
+  for (unsigned int i = 0; i < entries.size(); i++)
+    m_Entries.insert(
+      std::make_pair(KeyType(img, entries[i].first), entries[i].second));
+
+  return true;
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::ReleaseLabel(PixelType label)
+{
+  typename EntryMapType::iterator it = m_Entries.begin();
+  while (it != m_Entries.end())
+  {
+    if (it->first.second == label)
+      m_Entries.erase(it++);
+    else
+      ++it;
+  }
+}
+
+template <class TImage>
+void
+SurfaceDistanceCache<TImage>
+::Clear()
+{
+  m_Entries.clear();
+  m_Inventories.clear();
+}
+
+#endif
@@ -1,11 +1,22 @@
 
 #include "SurfaceToSurfaceMetric.h"
 
+#include "itkMultiThreader.h"
+
+SurfaceToSurfaceMetric
+::SurfaceToSurfaceMetric()
+{
+  m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  m_PointToTriangleDistance = false;
+}
+
 void
 SurfaceToSurfaceMetric
 ::SetFixedSurface(vtkPolyData* pd)
 {
   m_FixedSurface = pd;
+  m_FixedTriangles = 0;
 }
 
 vtkPolyData*
@@ -20,6 +31,7 @@ SurfaceToSurfaceMetric
 ::SetMovingSurface(vtkPolyData* pd)
 {
   m_MovingSurface = pd;
+  m_MovingTriangles = 0;
 }
 
 vtkPolyData*
@@ -28,3 +40,27 @@ SurfaceToSurfaceMetric
 {
   return m_MovingSurface;
 }
+
+const TriangleBVH*
+SurfaceToSurfaceMetric
+::GetFixedTriangles() const
+{
+  if (m_FixedTriangles.IsNull())
+  {
+    m_FixedTriangles = TriangleBVH::New();
+    m_FixedTriangles->Build(m_FixedSurface);
+  }
+  return m_FixedTriangles;
+}
+
+const TriangleBVH*
+SurfaceToSurfaceMetric
+::GetMovingTriangles() const
+{
+  if (m_MovingTriangles.IsNull())
+  {
+    m_MovingTriangles = TriangleBVH::New();
+    m_MovingTriangles->Build(m_MovingSurface);
+  }
+  return m_MovingTriangles;
+}
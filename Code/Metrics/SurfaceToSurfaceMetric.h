@@ -1,8 +1,12 @@
 #ifndef _SurfaceToSurfaceMetric_h
 #define _SurfaceToSurfaceMetric_h
 
+#include "itkIntTypes.h"
+#include "itkMacro.h"
 #include "itkSingleValuedCostFunction.h"
 
+#include "TriangleBVH.h"
+
 #include "vtkPolyData.h"
 #include "vtkSmartPointer.h"
 
@@ -28,6 +32,16 @@ public:
   virtual void SetMovingSurface(vtkPolyData* pd);
   vtkPolyData* GetMovingSurface() const;
 
+  // Threads used for point queries, defaults to the ITK global default
+  itkSetMacro(NumberOfThreads, itk::ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, itk::ThreadIdType);
+
+  // Measure from each vertex to the closest point on the triangles of the
+  // other surface, rather than to its closest vertex (default off)
+  itkSetMacro(PointToTriangleDistance, bool);
+  itkGetConstMacro(PointToTriangleDistance, bool);
+  itkBooleanMacro(PointToTriangleDistance);
+
 // TODO:
   //void SetTransformParameters(p);
 
@@ -43,8 +57,21 @@ public:
 
 protected:
 
+  SurfaceToSurfaceMetric();
+
   vtkSmartPointer<vtkPolyData> m_FixedSurface;
   vtkSmartPointer<vtkPolyData> m_MovingSurface;
+
+  // Triangle hierarchies, built on first use
+  const TriangleBVH* GetFixedTriangles() const;
+  const TriangleBVH* GetMovingTriangles() const;
+
+  itk::ThreadIdType m_NumberOfThreads;
+
+  bool m_PointToTriangleDistance;
+
+  mutable TriangleBVH::Pointer m_FixedTriangles;
+  mutable TriangleBVH::Pointer m_MovingTriangles;
 };
 
 #endif
@@ -0,0 +1,414 @@
+
+#include "TriangleBVH.h"
+
+#include "vtkCellArray.h"
+#include "vtkPoints.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Triangles per leaf
+static const unsigned int TriangleBVHLeafSize = 4;
+
+// Traversal stack size, tree depth is about log2 of the triangle count
+static const unsigned int TriangleBVHStackSize = 128;
+
+namespace
+{
+
+// Orders triangle ids by centroid coordinate along one axis
+struct CentroidLess
+{
+  const std::vector<double>* Centroids;
+  unsigned int Axis;
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    return (*Centroids)[3*a + Axis] < (*Centroids)[3*b + Axis];
+  }
+};
+
+}
+
+TriangleBVH
+::TriangleBVH()
+{
+
+}
+
+TriangleBVH
+::~TriangleBVH()
+{
+
+}
+
+void
+TriangleBVH
+::Build(vtkPolyData* pd)
+{
+  m_Nodes.clear();
+  m_TriangleVertices.clear();
+
+  if (pd == 0)
+    itkExceptionMacro(<< "Surface undefined");
+
+  vtkPoints* pts = pd->GetPoints();
+
+  // Gather triangles as vertex id triples
+  std::vector<vtkIdType> triIds;
+
+  vtkIdType npts = 0;
+  vtkIdType* ids = 0;
+
+  vtkCellArray* polys = pd->GetPolys();
+  if (polys != 0)
+  {
+    polys->InitTraversal();
+    while (polys->GetNextCell(npts, ids))
+    {
+      for (vtkIdType k = 2; k < npts; k++)
+      {
+        triIds.push_back(ids[0]);
+        triIds.push_back(ids[k-1]);
+        triIds.push_back(ids[k]);
+      }
+    }
+  }
+
+  vtkCellArray* strips = pd->GetStrips();
+  if (strips != 0)
+  {
+    strips->InitTraversal();
+    while (strips->GetNextCell(npts, ids))
+    {
+      for (vtkIdType k = 2; k < npts; k++)
+      {
+        triIds.push_back(ids[k-2]);
+        triIds.push_back(ids[k-1]);
+        triIds.push_back(ids[k]);
+      }
+    }
+  }
+
+  unsigned int numTriangles = triIds.size() / 3;
+
+  if (numTriangles == 0 || pts == 0)
+    itkExceptionMacro(<< "Surface has no triangles");
+
+  std::vector<double> vertices(9*numTriangles);
+  std::vector<double> centroids(3*numTriangles);
+
+  for (unsigned int t = 0; t < numTriangles; t++)
+  {
+    for (unsigned int v = 0; v < 3; v++)
+      pts->GetPoint(triIds[3*t + v], &vertices[9*t + 3*v]);
+
+    for (unsigned int dim = 0; dim < 3; dim++)
+      centroids[3*t + dim] =
+        (vertices[9*t + dim] + vertices[9*t + 3 + dim] + vertices[9*t + 6 + dim]) / 3.0;
+  }
+
+  std::vector<unsigned int> order(numTriangles);
+  for (unsigned int t = 0; t < numTriangles; t++)
+    order[t] = t;
+
+  m_Nodes.reserve(2*numTriangles / TriangleBVHLeafSize + 1);
+  m_Nodes.resize(1);
+
+  this->BuildNode(0, 0, numTriangles, order, centroids, vertices);
+
+  // Store triangles in leaf order so leaves read contiguous memory
+  m_TriangleVertices.resize(9*numTriangles);
+  for (unsigned int i = 0; i < numTriangles; i++)
+    std::copy(
+      vertices.begin() + 9*order[i], vertices.begin() + 9*order[i] + 9,
+      m_TriangleVertices.begin() + 9*i);
+}
+
+void
+TriangleBVH
+::BuildNode(unsigned int nodeId, unsigned int first, unsigned int count,
+  std::vector<unsigned int>& order, const std::vector<double>& centroids,
+  const std::vector<double>& vertices)
+{
+  NodeType node;
+
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    node.Min[dim] = vnl_huge_val(1.0);
+    node.Max[dim] = -vnl_huge_val(1.0);
+  }
+
+  for (unsigned int i = first; i < first + count; i++)
+  {
+    const double* tri = &vertices[9*order[i]];
+    for (unsigned int v = 0; v < 3; v++)
+      for (unsigned int dim = 0; dim < 3; dim++)
+      {
+        double c = tri[3*v + dim];
+        if (c < node.Min[dim])
+          node.Min[dim] = c;
+        if (c > node.Max[dim])
+          node.Max[dim] = c;
+      }
+  }
+
+  if (count <= TriangleBVHLeafSize)
+  {
+    node.First = first;
+    node.Count = count;
+    m_Nodes[nodeId] = node;
+    return;
+  }
+
+  // Split at the median centroid along the longest axis
+  unsigned int axis = 0;
+  for (unsigned int dim = 1; dim < 3; dim++)
+    if ((node.Max[dim] - node.Min[dim]) > (node.Max[axis] - node.Min[axis]))
+      axis = dim;
+
+  unsigned int half = count / 2;
+
+  CentroidLess less;
+  less.Centroids = &centroids;
+  less.Axis = axis;
+
+  std::nth_element(
+    order.begin() + first, order.begin() + first + half,
+    order.begin() + first + count, less);
+
+  unsigned int left = m_Nodes.size();
+  m_Nodes.resize(left + 2);
+
+  node.First = left;
+  node.Count = 0;
+  m_Nodes[nodeId] = node;
+
+  this->BuildNode(left, first, half, order, centroids, vertices);
+  this->BuildNode(left + 1, first + half, count - half, order, centroids, vertices);
+}
+
+double
+TriangleBVH
+::BoxDistance2(const NodeType& node, const double x[3])
+{
+  double d2 = 0;
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    double d = 0;
+    if (x[dim] < node.Min[dim])
+      d = node.Min[dim] - x[dim];
+    else if (x[dim] > node.Max[dim])
+      d = x[dim] - node.Max[dim];
+    d2 += d*d;
+  }
+  return d2;
+}
+
+double
+TriangleBVH
+::SegmentDistance2(const double* a, const double* b, const double x[3])
+{
+  double ab[3], ap[3];
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    ab[dim] = b[dim] - a[dim];
+    ap[dim] = x[dim] - a[dim];
+  }
+
+  double len2 = ab[0]*ab[0] + ab[1]*ab[1] + ab[2]*ab[2];
+
+  // Coincident end points leave the distance to a
+  double t = 0;
+  if (len2 > 0)
+  {
+    t = (ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2]) / len2;
+    if (t < 0)
+      t = 0;
+    else if (t > 1)
+      t = 1;
+  }
+
+  double dist2 = 0;
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    double d = ap[dim] - t*ab[dim];
+    dist2 += d*d;
+  }
+
+  return dist2;
+}
+
+double
+TriangleBVH
+::TriangleDistance2(const double* tri, const double x[3])
+{
+  // Closest point by Voronoi region of the triangle, see Ericson,
+  // Real-Time Collision Detection, 5.1.5
+  const double* a = tri;
+  const double* b = tri + 3;
+  const double* c = tri + 6;
+
+  double ab[3], ac[3], ap[3];
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    ab[dim] = b[dim] - a[dim];
+    ac[dim] = c[dim] - a[dim];
+    ap[dim] = x[dim] - a[dim];
+  }
+
+  // Triangles of (nearly) zero area, with coincident or collinear vertices,
+  // divide zero by zero below; the closest point is then on an edge
+  double n[3];
+  n[0] = ab[1]*ac[2] - ab[2]*ac[1];
+  n[1] = ab[2]*ac[0] - ab[0]*ac[2];
+  n[2] = ab[0]*ac[1] - ab[1]*ac[0];
+
+  double area2 = n[0]*n[0] + n[1]*n[1] + n[2]*n[2];
+  double ab2 = ab[0]*ab[0] + ab[1]*ab[1] + ab[2]*ab[2];
+  double ac2 = ac[0]*ac[0] + ac[1]*ac[1] + ac[2]*ac[2];
+  if (!(area2 > 1e-12 * ab2 * ac2))
+  {
+    double dist2 = SegmentDistance2(a, b, x);
+    double d2ac = SegmentDistance2(a, c, x);
+    double d2bc = SegmentDistance2(b, c, x);
+    if (d2ac < dist2)
+      dist2 = d2ac;
+    if (d2bc < dist2)
+      dist2 = d2bc;
+    return dist2;
+  }
+
+  double q[3];
+
+  double d1 = ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2];
+  double d2 = ac[0]*ap[0] + ac[1]*ap[1] + ac[2]*ap[2];
+
+  double bp[3], cp[3];
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    bp[dim] = x[dim] - b[dim];
+    cp[dim] = x[dim] - c[dim];
+  }
+
+  double d3 = ab[0]*bp[0] + ab[1]*bp[1] + ab[2]*bp[2];
+  double d4 = ac[0]*bp[0] + ac[1]*bp[1] + ac[2]*bp[2];
+
+  double d5 = ab[0]*cp[0] + ab[1]*cp[1] + ab[2]*cp[2];
+  double d6 = ac[0]*cp[0] + ac[1]*cp[1] + ac[2]*cp[2];
+
+  double vc = d1*d4 - d3*d2;
+  double vb = d5*d2 - d1*d6;
+  double va = d3*d6 - d5*d4;
+
+  if (d1 <= 0 && d2 <= 0)
+  {
+    // Vertex a
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = a[dim];
+  }
+  else if (d3 >= 0 && d4 <= d3)
+  {
+    // Vertex b
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = b[dim];
+  }
+  else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+  {
+    // Edge ab
+    double v = d1 / (d1 - d3);
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = a[dim] + v*ab[dim];
+  }
+  else if (d6 >= 0 && d5 <= d6)
+  {
+    // Vertex c
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = c[dim];
+  }
+  else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+  {
+    // Edge ac
+    double w = d2 / (d2 - d6);
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = a[dim] + w*ac[dim];
+  }
+  else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+  {
+    // Edge bc
+    double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = b[dim] + w*(c[dim] - b[dim]);
+  }
+  else
+  {
+    // Face interior
+    double denom = 1.0 / (va + vb + vc);
+    double v = vb * denom;
+    double w = vc * denom;
+    for (unsigned int dim = 0; dim < 3; dim++)
+      q[dim] = a[dim] + v*ab[dim] + w*ac[dim];
+  }
+
+  double dist2 = 0;
+  for (unsigned int dim = 0; dim < 3; dim++)
+  {
+    double d = x[dim] - q[dim];
+    dist2 += d*d;
+  }
+
+  return dist2;
+}
+
+double
+TriangleBVH
+::FindClosestDistance(const double x[3]) const
+{
+  if (m_Nodes.size() == 0)
+    itkExceptionMacro(<< "Triangle hierarchy not built");
+
+  double best2 = vnl_huge_val(1.0);
+
+  unsigned int stack[TriangleBVHStackSize];
+  unsigned int top = 0;
+
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const NodeType& node = m_Nodes[stack[--top]];
+
+    if (BoxDistance2(node, x) >= best2)
+      continue;
+
+    if (node.Count > 0)
+    {
+      for (unsigned int i = node.First; i < node.First + node.Count; i++)
+      {
+        double d2 = TriangleDistance2(&m_TriangleVertices[9*i], x);
+        if (d2 < best2)
+          best2 = d2;
+      }
+      continue;
+    }
+
+    // Push the farther child first so the nearer one is visited first
+    double dLeft = BoxDistance2(m_Nodes[node.First], x);
+    double dRight = BoxDistance2(m_Nodes[node.First + 1], x);
+
+    if (dLeft < dRight)
+    {
+      stack[top++] = node.First + 1;
+      stack[top++] = node.First;
+    }
+    else
+    {
+      stack[top++] = node.First;
+      stack[top++] = node.First + 1;
+    }
+  }
+
+  return sqrt(best2);
+}
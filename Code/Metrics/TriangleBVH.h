@@ -0,0 +1,80 @@
+// Bounding volume hierarchy over the triangles of a surface, for exact
+// point-to-surface distance queries
+//
+// Polygons are fan triangulated and triangle strips split into triangles.
+// The tree is built by median splits of the triangle centroids along the
+// longest axis, with axis aligned boxes and a few triangles per leaf.
+// Queries descend the nearer child first and prune boxes farther than the
+// best distance so far; they do not allocate and may run concurrently once
+// the tree is built.
+
+#ifndef _TriangleBVH_h
+#define _TriangleBVH_h
+
+#include "itkObject.h"
+
+#include "vtkPolyData.h"
+
+#include <vector>
+
+class TriangleBVH: public itk::Object
+{
+
+public:
+
+  /** Standard class typedefs. */
+  typedef TriangleBVH                                        Self;
+  typedef itk::Object                                        Superclass;
+  typedef itk::SmartPointer<Self>                            Pointer;
+  typedef itk::SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(TriangleBVH, itk::Object);
+
+  /** Collect the triangles of pd and build the tree. */
+  void Build(vtkPolyData* pd);
+
+  unsigned int GetNumberOfTriangles() const
+  { return m_TriangleVertices.size() / 9; }
+
+  /** Distance from x to the closest point on any triangle. */
+  double FindClosestDistance(const double x[3]) const;
+
+protected:
+
+  TriangleBVH();
+  ~TriangleBVH();
+
+  struct NodeType
+  {
+    double Min[3];
+    double Max[3];
+
+    // Leaves hold Count triangles from First, internal nodes have
+    // Count == 0 and children at First and First+1
+    unsigned int First;
+    unsigned int Count;
+  };
+
+  void BuildNode(unsigned int nodeId, unsigned int first, unsigned int count,
+    std::vector<unsigned int>& order, const std::vector<double>& centroids,
+    const std::vector<double>& vertices);
+
+  static double BoxDistance2(const NodeType& node, const double x[3]);
+
+  static double TriangleDistance2(const double* tri, const double x[3]);
+
+  static double SegmentDistance2(
+    const double* a, const double* b, const double x[3]);
+
+  std::vector<NodeType> m_Nodes;
+
+  // Three vertices per triangle, in leaf order
+  std::vector<double> m_TriangleVertices;
+
+};
+
+#endif
@@ -0,0 +1,151 @@
+
+// Compares vertex-to-vertex and point-to-triangle surface distances on two
+// concentric spheres, whose true surface distance is the difference of radii
+//
+// Usage: benchmarkSurfaceDistance [fixedResolution] [movingResolution]
+//
+// The fixed sphere is finely tessellated and the moving one coarsely, as
+// with a ground truth mesh against a decimated result. For each mode the
+// Hausdorff (50, 95, 100 percentiles) and average closest distances are
+// printed with their error and the time taken.
+
+#include "ClosestDistanceSurfaceToSurfaceMetric.h"
+#include "HausdorffDistanceSurfaceToSurfaceMetric.h"
+
+#include "itkOutputWindow.h"
+#include "itkTextOutput.h"
+#include "itkTimeProbe.h"
+
+#include "vtkSphereSource.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const double FixedRadius = 32.0;
+static const double MovingRadius = 34.0;
+
+vtkSmartPointer<vtkPolyData>
+makeSphere(double radius, int resolution)
+{
+  vtkSmartPointer<vtkSphereSource> sphereS = vtkSmartPointer<vtkSphereSource>::New();
+  sphereS->SetCenter(64, 64, 64);
+  sphereS->SetRadius(radius);
+  sphereS->SetThetaResolution(resolution);
+  sphereS->SetPhiResolution(resolution);
+  sphereS->LatLongTessellationOff();
+  sphereS->Update();
+
+  vtkSmartPointer<vtkPolyData> pd = sphereS->GetOutput();
+  return pd;
+}
+
+void
+runMode(const char* name, bool pointToTriangle,
+  vtkPolyData* fixedPD, vtkPolyData* movingPD)
+{
+  double trueDist = MovingRadius - FixedRadius;
+
+  std::vector<double> percentiles;
+  percentiles.push_back(0.5);
+  percentiles.push_back(0.95);
+  percentiles.push_back(1.0);
+
+  std::vector<double> hdValues;
+
+  itk::TimeProbe hdProbe;
+  hdProbe.Start();
+  {
+    HausdorffDistanceSurfaceToSurfaceMetric::Pointer metric =
+      HausdorffDistanceSurfaceToSurfaceMetric::New();
+    metric->SetPointToTriangleDistance(pointToTriangle);
+    metric->SetFixedSurface(fixedPD);
+    metric->SetMovingSurface(movingPD);
+    metric->GetValues(percentiles, hdValues);
+  }
+  hdProbe.Stop();
+
+  double closest = 0;
+
+  itk::TimeProbe closestProbe;
+  closestProbe.Start();
+  {
+    ClosestDistanceSurfaceToSurfaceMetric::Pointer metric =
+      ClosestDistanceSurfaceToSurfaceMetric::New();
+    metric->SetPointToTriangleDistance(pointToTriangle);
+    metric->SetFixedSurface(fixedPD);
+    metric->SetMovingSurface(movingPD);
+    closest = metric->GetValue();
+  }
+  closestProbe.Stop();
+
+  std::cout << name << std::endl;
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+    std::cout << "  Hausdorff" << 100*percentiles[i] << " = " << hdValues[i]
+      << " (error " << hdValues[i] - trueDist << ")" << std::endl;
+  std::cout << "  Hausdorff time = " << hdProbe.GetTotal() << " s" << std::endl;
+  std::cout << "  Closest = " << closest
+    << " (error " << closest - trueDist << ")" << std::endl;
+  std::cout << "  Closest time = " << closestProbe.GetTotal() << " s" << std::endl;
+}
+
+int
+benchmark(int fixedResolution, int movingResolution)
+{
+  itk::OutputWindow::SetInstance(itk::TextOutput::New());
+
+  vtkSmartPointer<vtkPolyData> fixedPD = makeSphere(FixedRadius, fixedResolution);
+  vtkSmartPointer<vtkPolyData> movingPD = makeSphere(MovingRadius, movingResolution);
+
+  std::cout << "Fixed sphere: " << fixedPD->GetNumberOfPoints() << " points, "
+    << fixedPD->GetNumberOfPolys() << " triangles" << std::endl;
+  std::cout << "Moving sphere: " << movingPD->GetNumberOfPoints() << " points, "
+    << movingPD->GetNumberOfPolys() << " triangles" << std::endl;
+  std::cout << "True distance = " << MovingRadius - FixedRadius << std::endl;
+
+  runMode("Vertex to vertex", false, fixedPD, movingPD);
+  runMode("Point to triangle", true, fixedPD, movingPD);
+
+  return 0;
+}
+
+int
+main(int argc, char** argv)
+{
+  int fixedResolution = 400;
+  int movingResolution = 40;
+
+  if (argc > 1)
+    fixedResolution = atoi(argv[1]);
+  if (argc > 2)
+    movingResolution = atoi(argv[2]);
+
+  try
+  {
+    benchmark(fixedResolution, movingResolution);
+  }
+  catch (itk::ExceptionObject& e)
+  {
+    std::cerr << e << std::endl;
+    return -1;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return -1;
+  }
+  catch (std::string& s)
+  {
+    std::cerr << "Exception: " << s << std::endl;
+    return -1;
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown exception" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
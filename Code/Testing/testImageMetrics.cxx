@@ -8,18 +8,37 @@
 
 #include "CohenKappaImageToImageMetric.h"
 
+#include "MultipleLabelOverlapCalculator.h"
+
+#include "BhattacharyyaImageToImageMetric.h"
+#include "FastLog.h"
+#include "KullbackLeiblerImageToImageMetric.h"
+
 #include "AverageDistanceImageToImageMetric.h"
+#include "GroundTruthCache.h"
 #include "HausdorffDistanceImageToImageMetric.h"
+#include "PercentileSelector.h"
+#include "SurfaceDistanceCache.h"
 
+#include "itkBinaryThresholdImageFilter.h"
 #include "itkImage.h"
 #include "itkImageRegionIteratorWithIndex.h"
+#include "itkVectorImage.h"
 
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 
 int
@@ -28,6 +47,9 @@ testMetrics()
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
+  // Checks that fail are reported and counted, the rest still run
+  int failures = 0;
+
   typedef itk::Image<unsigned char, 3> ByteImageType;
 
   ByteImageType::SizeType size = {{64, 64, 64}};
@@ -116,6 +138,59 @@ testMetrics()
 
   std::cout << "PositivePredictiveValue(A,B) = " <<  precMetric->GetValue() << std::endl;
 
+  typedef MultipleLabelOverlapCalculator<ByteImageType, ByteImageType>
+    OverlapCalculatorType;
+  OverlapCalculatorType::Pointer overlapCalc = OverlapCalculatorType::New();
+  overlapCalc->SetFixedImage(Amask);
+  overlapCalc->SetMovingImage(Bmask);
+  overlapCalc->Update();
+
+  for (unsigned int i = 0; i < overlapCalc->GetNumberOfValues(); i++)
+  {
+    unsigned long label = overlapCalc->GetLabel(i);
+    std::cout << "Dice(A_" << label << ",B_" << label << ") = "
+      << overlapCalc->GetDice(i) << std::endl;
+    std::cout << "Specificity(A_" << label << ",B_" << label << ") = "
+      << overlapCalc->GetSpecificity(i) << std::endl;
+  }
+
+  // Same Dice from the metric on each label thresholded to a binary mask
+  typedef itk::BinaryThresholdImageFilter<ByteImageType, ByteImageType>
+    ThresholdFilterType;
+  for (unsigned int i = 0; i < overlapCalc->GetNumberOfValues(); i++)
+  {
+    unsigned char label = (unsigned char)overlapCalc->GetLabel(i);
+
+    ThresholdFilterType::Pointer athresh = ThresholdFilterType::New();
+    athresh->SetInput(Amask);
+    athresh->SetLowerThreshold(label);
+    athresh->SetUpperThreshold(label);
+    athresh->SetInsideValue(1);
+    athresh->SetOutsideValue(0);
+    athresh->Update();
+
+    ThresholdFilterType::Pointer bthresh = ThresholdFilterType::New();
+    bthresh->SetInput(Bmask);
+    bthresh->SetLowerThreshold(label);
+    bthresh->SetUpperThreshold(label);
+    bthresh->SetInsideValue(1);
+    bthresh->SetOutsideValue(0);
+    bthresh->Update();
+
+    DiceMetricType::Pointer labelDiceMetric = DiceMetricType::New();
+    labelDiceMetric->SetFixedImage(athresh->GetOutput());
+    labelDiceMetric->SetMovingImage(bthresh->GetOutput());
+
+    double dice = labelDiceMetric->GetValue();
+    if (std::fabs(dice - overlapCalc->GetDice(i)) > 1e-12)
+    {
+      std::cerr << "FAILED: Dice of label " << (int)label << " is "
+        << overlapCalc->GetDice(i) << ", thresholded masks give " << dice
+        << std::endl;
+      failures++;
+    }
+  }
+
   typedef CohenKappaImageToImageMetric<ByteImageType, ByteImageType>
     KappaMetricType;
   KappaMetricType::Pointer kappaMetric = KappaMetricType::New();
@@ -124,6 +199,9 @@ testMetrics()
 
   std::cout << "Kappa(A,B) = " << kappaMetric->GetValue() << std::endl;
 
+  kappaMetric->SetWeighting(KappaMetricType::QuadraticWeights);
+  std::cout << "QuadraticKappa(A,B) = " << kappaMetric->GetValue() << std::endl;
+
   typedef AverageDistanceImageToImageMetric<ByteImageType, ByteImageType>
     AveDistanceMetricType;
   AveDistanceMetricType::Pointer aveDistMetric = AveDistanceMetricType::New();
@@ -148,6 +226,66 @@ testMetrics()
   hDistMetric->SetMovingImage(Bmask);
   std::cout << "HausdorffDist(A,B) = " << hDistMetric->GetValue() << std::endl;
 
+  std::vector<double> percentiles;
+  percentiles.push_back(0.5);
+  percentiles.push_back(0.95);
+  percentiles.push_back(1.0);
+
+  std::vector<double> hDistValues;
+  hDistMetric->GetValues(percentiles, hDistValues);
+  for (unsigned int i = 0; i < percentiles.size(); i++)
+    std::cout << "HausdorffDist" << 100*percentiles[i] << "(A,B) = "
+      << hDistValues[i] << std::endl;
+
+  // Early break search, should match HausdorffDist100 above
+  hDistMetric->SetPercentile(1.0);
+  std::cout << "HausdorffDistMax(A,B) = " << hDistMetric->GetValue() << std::endl;
+
+  // Same maximum from the early break search and the distance maps, also
+  // against a ball that is not aligned with the grid
+  ByteImageType::Pointer Cmask = ByteImageType::New();
+  Cmask->SetRegions(region);
+  Cmask->Allocate();
+  Cmask->FillBuffer(0);
+
+  for (ind[2] = 0; ind[2] < (long)size[2]; ind[2]++)
+    for (ind[1] = 0; ind[1] < (long)size[1]; ind[1]++)
+      for (ind[0] = 0; ind[0] < (long)size[0]; ind[0]++)
+      {
+        double dx = ind[0] - 24.3;
+        double dy = ind[1] - 30.6;
+        double dz = ind[2] - 37.1;
+        if (dx*dx + dy*dy + dz*dz <= 12.5*12.5)
+          Cmask->SetPixel(ind, 1);
+      }
+
+  const ByteImageType* hausdorffPairs[2][2] = {
+    { Amask, Bmask }, { Amask, Cmask } };
+  for (unsigned int k = 0; k < 2; k++)
+  {
+    HausdorffDistanceMetricType::Pointer maxDistMetric =
+      HausdorffDistanceMetricType::New();
+    maxDistMetric->SetFixedImage(hausdorffPairs[k][0]);
+    maxDistMetric->SetMovingImage(hausdorffPairs[k][1]);
+    maxDistMetric->SetPercentile(1.0);
+
+    maxDistMetric->EarlyBreakOn();
+    double earlyBreakMax = maxDistMetric->GetValue();
+
+    maxDistMetric->EarlyBreakOff();
+    double distanceMapMax = maxDistMetric->GetValue();
+
+    if (std::fabs(earlyBreakMax - distanceMapMax) > 1e-4)
+    {
+      std::cerr << "FAILED: early break Hausdorff of pair " << k << " is "
+        << earlyBreakMax << ", distance maps give " << distanceMapMax
+        << std::endl;
+      failures++;
+    }
+  }
+
+  hDistMetric->SetPercentile(0.95);
+
   hDistMetric->SetFixedImage(Amask);
   hDistMetric->SetMovingImage(Amask);
   std::cout << "HausdorffDist(A,A) = " << hDistMetric->GetValue() << std::endl;
@@ -156,8 +294,479 @@ testMetrics()
   hDistMetric->SetMovingImage(Zmask);
   std::cout << "HausdorffDist(A,Z) = " << hDistMetric->GetValue() << std::endl;
 
-  return 0;
+  return failures;
+
+}
+
+// Kappa of images holding a known confusion table, over labels {0, 1, 3}:
+//
+//          moving 0   1   3
+//   fixed 0      10   2   0
+//         1       3  20   5
+//         3       0   4   6
+//
+// Row sums are 12, 28, 10 and column sums 13, 26, 11 over 50 voxels. The
+// labels are scaled by s, which leaves the weighted kappas unchanged, so
+// larger labels go through the sparse part of the confusion table.
+template <class TPixel>
+int
+testKappaTable(unsigned int s)
+{
+  typedef itk::Image<TPixel, 3> ImageType;
+
+  unsigned int labels[3] = { 0, 1, 3 };
+  unsigned int table[3][3] = { { 10, 2, 0 }, { 3, 20, 5 }, { 0, 4, 6 } };
+
+  typename ImageType::SizeType size = {{5, 5, 2}};
+  typename ImageType::RegionType region;
+  region.SetSize(size);
+
+  typename ImageType::Pointer fixedImg = ImageType::New();
+  fixedImg->SetRegions(region);
+  fixedImg->Allocate();
+
+  typename ImageType::Pointer movingImg = ImageType::New();
+  movingImg->SetRegions(region);
+  movingImg->Allocate();
+
+  TPixel* fixedBuffer = fixedImg->GetBufferPointer();
+  TPixel* movingBuffer = movingImg->GetBufferPointer();
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < 3; i++)
+    for (unsigned int j = 0; j < 3; j++)
+      for (unsigned int k = 0; k < table[i][j]; k++, n++)
+      {
+        fixedBuffer[n] = (TPixel)(s*labels[i]);
+        movingBuffer[n] = (TPixel)(s*labels[j]);
+      }
+
+  // Observed agreement 36/50 against expected (156 + 728 + 110)/2500
+  double unweighted = (36.0/50 - 994.0/2500) / (1.0 - 994.0/2500);
+
+  // Weights |a-b|: observed 2*1 + 3*1 + 5*2 + 4*2 = 23, expected
+  // 12*(26*1 + 11*3) + 28*(13*1 + 11*2) + 10*(13*3 + 26*2) = 2598
+  double linear = 1.0 - (23.0/50) / (2598.0/2500);
+
+  // Weights (a-b)^2: observed 2*1 + 3*1 + 5*4 + 4*4 = 41, expected
+  // 12*(26*1 + 11*9) + 28*(13*1 + 11*4) + 10*(13*9 + 26*4) = 5306
+  double quadratic = 1.0 - (41.0/50) / (5306.0/2500);
+
+  typedef CohenKappaImageToImageMetric<ImageType, ImageType> KappaMetricType;
+  typename KappaMetricType::Pointer kappaMetric = KappaMetricType::New();
+  kappaMetric->SetFixedImage(fixedImg);
+  kappaMetric->SetMovingImage(movingImg);
+
+  typename KappaMetricType::WeightingType weightings[3] = {
+    KappaMetricType::Unweighted, KappaMetricType::LinearWeights,
+    KappaMetricType::QuadraticWeights };
+  double expected[3] = { unweighted, linear, quadratic };
+
+  int failures = 0;
+  for (unsigned int w = 0; w < 3; w++)
+  {
+    kappaMetric->SetWeighting(weightings[w]);
+    double kappa = kappaMetric->GetValue();
+    if (std::fabs(kappa - expected[w]) > 1e-12)
+    {
+      std::cerr << "FAILED: kappa with weighting " << w << " and labels scaled by "
+        << s << " is " << kappa << ", expected " << expected[w] << std::endl;
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+// Selected percentiles against indexing the sorted values, for lists with
+// repeated values and percentiles given in any order
+int
+testPercentileSelector()
+{
+  int failures = 0;
+
+  std::vector<double> percentiles;
+  percentiles.push_back(0.95);
+  percentiles.push_back(0.0);
+  percentiles.push_back(0.5);
+  percentiles.push_back(1.0);
+  percentiles.push_back(0.5);
+  percentiles.push_back(0.999);
+
+  srand(17);
+
+  for (unsigned int n = 1; n <= 1000; n = 3*n + 1)
+  {
+    std::vector<double> values(n);
+    for (unsigned int i = 0; i < n; i++)
+      values[i] = rand() % 50;
+
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<double> results;
+    PercentileSelector::Select(values, percentiles, results);
+
+    for (unsigned int k = 0; k < percentiles.size(); k++)
+    {
+      double expected = sorted[(size_t)(percentiles[k]*(n - 1))];
+      if (results[k] != expected)
+      {
+        std::cerr << "FAILED: percentile " << percentiles[k] << " of " << n
+          << " values is " << results[k] << ", expected " << expected
+          << std::endl;
+        failures++;
+      }
+    }
+  }
+
+  return failures;
+}
+
+// FastLog against std::log over many binades, near one, and for subnormal
+// arguments
+int
+testFastLog()
+{
+  int failures = 0;
+
+  std::vector<double> values;
+  for (double x = 1e-300; x < 1e300; x *= 1.37)
+    values.push_back(x);
+  for (int k = 1; k <= 1000; k++)
+  {
+    values.push_back(1.0 + k * 1e-13);
+    values.push_back(1.0 - k * 1e-13);
+    values.push_back(1.0 + k * 1e-4);
+    values.push_back(1.0 - k * 1e-4);
+  }
+  values.push_back(1.0);
+  values.push_back(std::sqrt(0.5));
+  values.push_back(std::sqrt(2.0));
+  for (double x = 2.2250738585072014e-308; x > 0; x *= 0.37)
+    values.push_back(x);
+
+  std::vector<double> logs(values.size());
+  FastLog::Evaluate(&values[0], &logs[0], values.size());
+
+  for (unsigned int i = 0; i < values.size(); i++)
+  {
+    double expected = std::log(values[i]);
+    double err = std::fabs(logs[i] - expected);
+    if (err > 1e-15 * std::fabs(expected) && err > 1e-300)
+    {
+      std::cerr << "FAILED: FastLog(" << values[i] << ") is " << logs[i]
+        << ", std::log gives " << expected << std::endl;
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+// Kullback-Leibler and Bhattacharyya metrics against summing over the
+// voxels directly, and the density check on an input that does not sum to
+// one
+int
+testProbabilityMetrics()
+{
+  int failures = 0;
+
+  typedef itk::VectorImage<float, 3> ProbabilityImageType;
+  typedef ProbabilityImageType::PixelType VectorType;
+
+  const unsigned int numComponents = 4;
+
+  ProbabilityImageType::SizeType size = {{9, 7, 5}};
+  ProbabilityImageType::RegionType region;
+  region.SetSize(size);
+
+  ProbabilityImageType::Pointer fixedImage = ProbabilityImageType::New();
+  fixedImage->SetVectorLength(numComponents);
+  fixedImage->SetRegions(region);
+  fixedImage->Allocate();
+
+  ProbabilityImageType::Pointer movingImage = ProbabilityImageType::New();
+  movingImage->SetVectorLength(numComponents);
+  movingImage->SetRegions(region);
+  movingImage->Allocate();
+
+  srand(23);
+
+  // Some moving components are zero, so KL clamps them to epsilon
+  typedef itk::ImageRegionIteratorWithIndex<ProbabilityImageType> IteratorType;
+  IteratorType fixedIt(fixedImage, region);
+  for (fixedIt.GoToBegin(); !fixedIt.IsAtEnd(); ++fixedIt)
+  {
+    VectorType a(numComponents);
+    VectorType b(numComponents);
+    double asum = 0;
+    double bsum = 0;
+    for (unsigned int c = 0; c < numComponents; c++)
+    {
+      a[c] = (float)(rand() % 100 + 1);
+      b[c] = (float)(rand() % 5 == 0 ? 0 : rand() % 100 + 1);
+      asum += a[c];
+      bsum += b[c];
+    }
+    if (bsum == 0)
+    {
+      b[0] = 1;
+      bsum = 1;
+    }
+    for (unsigned int c = 0; c < numComponents; c++)
+    {
+      a[c] = (float)(a[c] / asum);
+      b[c] = (float)(b[c] / bsum);
+    }
+    fixedImage->SetPixel(fixedIt.GetIndex(), a);
+    movingImage->SetPixel(fixedIt.GetIndex(), b);
+  }
+
+  typedef KullbackLeiblerImageToImageMetric<
+    ProbabilityImageType, ProbabilityImageType> KLMetricType;
+  KLMetricType::Pointer klMetric = KLMetricType::New();
+  klMetric->SetFixedImage(fixedImage);
+  klMetric->SetMovingImage(movingImage);
+
+  typedef BhattacharyyaImageToImageMetric<
+    ProbabilityImageType, ProbabilityImageType> BhattacharyyaMetricType;
+  BhattacharyyaMetricType::Pointer bMetric = BhattacharyyaMetricType::New();
+  bMetric->SetFixedImage(fixedImage);
+  bMetric->SetMovingImage(movingImage);
+
+  double epsilon = klMetric->GetEpsilon();
+  double klExpected = 0;
+  double bExpected = 0;
+  for (fixedIt.GoToBegin(); !fixedIt.IsAtEnd(); ++fixedIt)
+  {
+    VectorType a = fixedIt.Get();
+    VectorType b = movingImage->GetPixel(fixedIt.GetIndex());
+    for (unsigned int c = 0; c < numComponents; c++)
+    {
+      double pa = a[c];
+      double pb = b[c];
+      bExpected += std::sqrt(pa * pb);
+
+      pa = (pa < epsilon) ? epsilon : pa;
+      pb = (pb < epsilon) ? epsilon : pb;
+      klExpected += pa * std::log(pa / pb);
+    }
+  }
+
+  double kl = klMetric->GetValue();
+  std::cout << "KL(A,B) = " << kl << std::endl;
+  if (std::fabs(kl - klExpected) > 1e-10 * std::fabs(klExpected))
+  {
+    std::cerr << "FAILED: KL is " << kl << ", summing voxels gives "
+      << klExpected << std::endl;
+    failures++;
+  }
+
+  double b = bMetric->GetValue();
+  std::cout << "Bhattacharyya(A,B) = " << b << std::endl;
+  if (std::fabs(b - bExpected) > 1e-10 * std::fabs(bExpected))
+  {
+    std::cerr << "FAILED: Bhattacharyya is " << b << ", summing voxels gives "
+      << bExpected << std::endl;
+    failures++;
+  }
+
+  // One voxel of the moving image no longer sums to one
+  ProbabilityImageType::IndexType ind = {{4, 3, 2}};
+  VectorType v = movingImage->GetPixel(ind);
+  v[0] += 0.5f;
+  movingImage->SetPixel(ind, v);
+  movingImage->Modified();
+
+  bool thrown = false;
+  try
+  {
+    bMetric->GetValue();
+  }
+  catch (itk::ExceptionObject&)
+  {
+    thrown = true;
+  }
+  if (!thrown)
+  {
+    std::cerr << "FAILED: Bhattacharyya accepted a moving image that is not "
+      << "a probability density" << std::endl;
+    failures++;
+  }
+
+  return failures;
+}
+
+typedef itk::Image<unsigned char, 3> CacheTestImageType;
+
+// Average and Hausdorff distances of labels 1 and 2, with the ground truth
+// entries loaded from the cache directory if one is given
+int
+computeCachedDistances(const CacheTestImageType* truthImg,
+  const CacheTestImageType* testImg, const std::string& cacheDir,
+  bool expectRead, std::vector<double>& values)
+{
+  typedef SurfaceDistanceCache<CacheTestImageType> SurfaceDistanceCacheType;
+  SurfaceDistanceCacheType::Pointer distanceCache =
+    SurfaceDistanceCacheType::New();
+  distanceCache->CropToBoundingBoxOn();
+
+  int failures = 0;
+
+  if (!cacheDir.empty())
+  {
+    typedef GroundTruthCache<CacheTestImageType> GroundTruthCacheType;
+    GroundTruthCacheType::Pointer truthCache = GroundTruthCacheType::New();
+    truthCache->SetDirectory(cacheDir);
+    truthCache->SetSurfaceDistanceCache(distanceCache);
+    if (truthCache->Load(truthImg) != expectRead)
+    {
+      std::cerr << "FAILED: ground truth cache file "
+        << (expectRead ? "not read" : "read") << std::endl;
+      failures++;
+    }
+  }
+
+  typedef AverageDistanceImageToImageMetric<
+    CacheTestImageType, CacheTestImageType> AveDistanceMetricType;
+  typedef HausdorffDistanceImageToImageMetric<
+    CacheTestImageType, CacheTestImageType> HausdorffDistanceMetricType;
+
+  values.clear();
+  for (unsigned char label = 1; label <= 2; label++)
+  {
+    AveDistanceMetricType::Pointer aveDistMetric = AveDistanceMetricType::New();
+    aveDistMetric->SetFixedImage(truthImg);
+    aveDistMetric->SetMovingImage(testImg);
+    aveDistMetric->SetSurfaceDistanceCache(distanceCache);
+    aveDistMetric->SetLabel(label);
+    values.push_back(aveDistMetric->GetValue());
+
+    HausdorffDistanceMetricType::Pointer hDistMetric =
+      HausdorffDistanceMetricType::New();
+    hDistMetric->SetFixedImage(truthImg);
+    hDistMetric->SetMovingImage(testImg);
+    hDistMetric->SetSurfaceDistanceCache(distanceCache);
+    hDistMetric->SetLabel(label);
+    values.push_back(hDistMetric->GetValue());
+
+    distanceCache->ReleaseLabel(label);
+  }
+
+  return failures;
+}
+
+// Distances of each label with no ground truth cache, with a cache that
+// misses and is written, and with one that is read, which must all agree.
+// Truncated files and files of another version must be recomputed.
+int
+testGroundTruthCache(const std::string& dir)
+{
+  int failures = 0;
+
+  CacheTestImageType::SizeType size = {{40, 36, 32}};
+  CacheTestImageType::RegionType region;
+  region.SetSize(size);
+
+  CacheTestImageType::SpacingType spacing;
+  spacing[0] = 0.8;
+  spacing[1] = 1.0;
+  spacing[2] = 1.5;
+
+  CacheTestImageType::Pointer truthImg = CacheTestImageType::New();
+  truthImg->SetRegions(region);
+  truthImg->SetSpacing(spacing);
+  truthImg->Allocate();
+  truthImg->FillBuffer(0);
+
+  CacheTestImageType::Pointer testImg = CacheTestImageType::New();
+  testImg->SetRegions(region);
+  testImg->SetSpacing(spacing);
+  testImg->Allocate();
+  testImg->FillBuffer(0);
+
+  // A box and a ball of different labels, shifted in the test image
+  CacheTestImageType::IndexType ind;
+  for (ind[2] = 0; ind[2] < (long)size[2]; ind[2]++)
+    for (ind[1] = 0; ind[1] < (long)size[1]; ind[1]++)
+      for (ind[0] = 0; ind[0] < (long)size[0]; ind[0]++)
+      {
+        if (ind[0] >= 4 && ind[0] < 16 && ind[1] >= 5 && ind[1] < 20
+            && ind[2] >= 6 && ind[2] < 14)
+          truthImg->SetPixel(ind, 1);
+        if (ind[0] >= 6 && ind[0] < 17 && ind[1] >= 5 && ind[1] < 22
+            && ind[2] >= 7 && ind[2] < 14)
+          testImg->SetPixel(ind, 1);
+
+        double dx = ind[0] - 27.2;
+        double dy = ind[1] - 22.7;
+        double dz = ind[2] - 19.4;
+        if (dx*dx + dy*dy + dz*dz <= 7.5*7.5)
+          truthImg->SetPixel(ind, 2);
+        dx += 1.6;
+        dz -= 0.9;
+        if (dx*dx + dy*dy + dz*dz <= 6.8*6.8)
+          testImg->SetPixel(ind, 2);
+      }
+
+  std::string cacheDir = dir + "/groundTruthCache";
+  itksys::SystemTools::RemoveADirectory(cacheDir.c_str());
+
+  std::string fn;
+  {
+    typedef GroundTruthCache<CacheTestImageType> GroundTruthCacheType;
+    GroundTruthCacheType::Pointer truthCache = GroundTruthCacheType::New();
+    truthCache->SetDirectory(cacheDir);
+    truthCache->SetSurfaceDistanceCache(
+      SurfaceDistanceCache<CacheTestImageType>::New());
+    fn = truthCache->GetFileName(truthImg);
+  }
+
+  std::vector<double> expected;
+  failures += computeCachedDistances(truthImg, testImg, "", false, expected);
+
+  const char* runs[5] = {
+    "written", "read", "truncated", "of another version", "rewritten" };
+
+  for (unsigned int k = 0; k < 5; k++)
+  {
+    // Damage the file written by the run before
+    if (k == 2 || k == 3)
+    {
+      std::string contents;
+      {
+        std::ifstream is(fn.c_str(), std::ios::in | std::ios::binary);
+        std::ostringstream oss;
+        oss << is.rdbuf();
+        contents = oss.str();
+      }
+
+      if (k == 2)
+        contents.resize(contents.size() - 100);
+      else
+        contents[9] = (char)(contents[9] + 1);
+
+      std::ofstream os(fn.c_str(), std::ios::out | std::ios::binary);
+      os.write(contents.c_str(), contents.size());
+    }
+
+    std::vector<double> values;
+    failures += computeCachedDistances(truthImg, testImg, cacheDir,
+      k == 1 || k == 4, values);
+
+    for (unsigned int i = 0; i < expected.size(); i++)
+    {
+      if (values[i] != expected[i])
+      {
+        std::cerr << "FAILED: distance " << i << " with the cache file "
+          << runs[k] << " is " << values[i] << ", without cache "
+          << expected[i] << std::endl;
+        failures++;
+      }
+    }
+  }
 
+  return failures;
 }
 
 int
@@ -165,7 +774,15 @@ main(int argc, char** argv)
 {
   try
   {
-    testMetrics();
+    int failures = testMetrics();
+    failures += testPercentileSelector();
+    failures += testKappaTable<unsigned char>(1);
+    failures += testKappaTable<unsigned short>(20);
+    failures += testFastLog();
+    failures += testProbabilityMetrics();
+    failures += testGroundTruthCache(argc > 1 ? argv[1] : ".");
+    if (failures != 0)
+      return -1;
   } 
   catch (itk::ExceptionObject& e)
   {
@@ -0,0 +1,279 @@
+
+#include "MappedImageFileReader.h"
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include "itkOutputWindow.h"
+#include "itkTextOutput.h"
+
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+
+// Image with a pattern of values covering the pixel type, and geometry
+// that is not the default in any field
+template <class TImage>
+typename TImage::Pointer
+createTestImage()
+{
+  const unsigned int dim = TImage::ImageDimension;
+
+  typename TImage::SizeType size;
+  typename TImage::SpacingType spacing;
+  typename TImage::PointType origin;
+  for (unsigned int i = 0; i < dim; i++)
+  {
+    size[i] = 7 - i;
+    spacing[i] = 0.5 + 0.25*i;
+    origin[i] = -12.5 + 3.75*i;
+  }
+
+  // Rotation in the plane of the first two axes
+  typename TImage::DirectionType direction;
+  direction.SetIdentity();
+  double angle = 0.3;
+  direction(0, 0) = std::cos(angle);
+  direction(0, 1) = -std::sin(angle);
+  direction(1, 0) = std::sin(angle);
+  direction(1, 1) = std::cos(angle);
+
+  typename TImage::RegionType region;
+  region.SetSize(size);
+
+  typename TImage::Pointer img = TImage::New();
+  img->SetRegions(region);
+  img->SetSpacing(spacing);
+  img->SetOrigin(origin);
+  img->SetDirection(direction);
+  img->Allocate();
+
+  typedef itk::ImageRegionIteratorWithIndex<TImage> IteratorType;
+  IteratorType it(img, region);
+
+  unsigned long k = 0;
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it, k++)
+    it.Set(static_cast<typename TImage::PixelType>((k * 37) % 251));
+
+  return img;
+}
+
+// Compares the output of MappedImageFileReader with ImageFileReader,
+// expecting the file to be mapped or not
+template <class TImage>
+int
+compareWithImageFileReader(const std::string& fn, bool expectMapped)
+{
+  const unsigned int dim = TImage::ImageDimension;
+
+  typedef MappedImageFileReader<TImage> MappedReaderType;
+  typename MappedReaderType::Pointer mappedReader = MappedReaderType::New();
+  mappedReader->SetFileName(fn);
+  mappedReader->Update();
+
+  typedef itk::ImageFileReader<TImage> ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fn);
+  reader->Update();
+
+  TImage* mapped = mappedReader->GetOutput();
+  TImage* img = reader->GetOutput();
+
+  int failures = 0;
+
+  if (mappedReader->GetMapped() != expectMapped)
+  {
+    std::cerr << "FAILED: " << fn << (expectMapped ? " not" : "")
+      << " mapped" << std::endl;
+    failures++;
+  }
+
+  if (mapped->GetLargestPossibleRegion() != img->GetLargestPossibleRegion())
+  {
+    std::cerr << "FAILED: " << fn << " mapped region "
+      << mapped->GetLargestPossibleRegion() << " differs from "
+      << img->GetLargestPossibleRegion() << std::endl;
+    return failures + 1;
+  }
+
+  for (unsigned int i = 0; i < dim; i++)
+  {
+    bool same =
+      std::fabs(mapped->GetSpacing()[i] - img->GetSpacing()[i]) < 1e-9
+      && std::fabs(mapped->GetOrigin()[i] - img->GetOrigin()[i]) < 1e-9;
+    for (unsigned int j = 0; j < dim; j++)
+      if (std::fabs(mapped->GetDirection()(i, j) - img->GetDirection()(i, j))
+          >= 1e-9)
+        same = false;
+
+    if (!same)
+    {
+      std::cerr << "FAILED: " << fn << " mapped geometry differs along axis "
+        << i << std::endl;
+      failures++;
+    }
+  }
+
+  typedef itk::ImageRegionConstIterator<TImage> IteratorType;
+  IteratorType mappedIt(mapped, mapped->GetLargestPossibleRegion());
+  IteratorType it(img, img->GetLargestPossibleRegion());
+
+  unsigned long numDiffering = 0;
+  for (; !it.IsAtEnd(); ++it, ++mappedIt)
+    if (mappedIt.Get() != it.Get())
+      numDiffering++;
+
+  if (numDiffering > 0)
+  {
+    std::cerr << "FAILED: " << fn << " has " << numDiffering
+      << " mapped voxels that differ" << std::endl;
+    failures++;
+  }
+
+  std::cout << fn << (mappedReader->GetMapped() ? " mapped" : " read")
+    << std::endl;
+
+  return failures;
+}
+
+// Writes the test image in each format and layout, and checks how each
+// file reads back
+template <class TImage>
+int
+testFormats(const std::string& dir, const std::string& name)
+{
+  typename TImage::Pointer img = createTestImage<TImage>();
+
+  typedef itk::ImageFileWriter<TImage> WriterType;
+
+  // Data in the header file, in a separate file, and compressed
+  const char* extensions[4] = { ".mha", ".mhd", ".nrrd", ".nhdr" };
+
+  int failures = 0;
+  for (unsigned int k = 0; k < 4; k++)
+  {
+    for (unsigned int compress = 0; compress < 2; compress++)
+    {
+      std::string fn = dir + "/" + name + (compress ? "_gz" : "") + extensions[k];
+
+      typename WriterType::Pointer writer = WriterType::New();
+      writer->SetInput(img);
+      writer->SetFileName(fn);
+      writer->SetUseCompression(compress != 0);
+      writer->Update();
+
+      failures += compareWithImageFileReader<TImage>(fn, compress == 0);
+    }
+  }
+
+  return failures;
+}
+
+// MetaImage written by hand with the data in the other byte order, which
+// must not be mapped
+int
+testOtherByteOrder(const std::string& dir)
+{
+  std::string fn = dir + "/byteorder.mha";
+
+  bool hostBigEndian = false;
+  {
+    unsigned short one = 1;
+    hostBigEndian = (*(unsigned char*)&one == 0);
+  }
+
+  {
+    std::ofstream os(fn.c_str(), std::ios::out | std::ios::binary);
+    os << "ObjectType = Image\n"
+      << "NDims = 3\n"
+      << "BinaryData = True\n"
+      << "BinaryDataByteOrderMSB = " << (hostBigEndian ? "False" : "True") << "\n"
+      << "CompressedData = False\n"
+      << "Offset = 1 2 3\n"
+      << "ElementSpacing = 0.5 1 2\n"
+      << "DimSize = 3 2 2\n"
+      << "ElementType = MET_USHORT\n"
+      << "ElementDataFile = LOCAL\n";
+
+    for (unsigned short v = 0; v < 12; v++)
+    {
+      unsigned short value = v * 257 + 1;
+      os.put((char)(value & 0xff));
+      os.put((char)(value >> 8));
+    }
+  }
+
+  return compareWithImageFileReader< itk::Image<unsigned short, 3> >(fn, false);
+}
+
+// Mapped images are checked against ImageFileReader on files written by
+// ITK in every format and layout MappedImageFile parses, and on files it
+// must refuse, which MappedImageFileReader then reads the usual way
+int
+testMappedImageFile(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " outputDirectory" << std::endl;
+    return -1;
+  }
+
+  itk::OutputWindow::SetInstance(itk::TextOutput::New());
+
+  std::string dir = argv[1];
+
+  int failures = 0;
+  failures += testFormats< itk::Image<unsigned char, 3> >(dir, "uchar3");
+  failures += testFormats< itk::Image<short, 3> >(dir, "short3");
+  failures += testFormats< itk::Image<float, 3> >(dir, "float3");
+  failures += testFormats< itk::Image<unsigned short, 2> >(dir, "ushort2");
+  failures += testOtherByteOrder(dir);
+
+  // Files of another pixel type or dimension are read, not mapped
+  failures += compareWithImageFileReader< itk::Image<unsigned short, 3> >(
+    dir + "/uchar3.mha", false);
+  failures += compareWithImageFileReader< itk::Image<short, 3> >(
+    dir + "/ushort2.nrrd", false);
+
+  return failures;
+}
+
+int
+main(int argc, char** argv)
+{
+  try
+  {
+    if (testMappedImageFile(argc, argv) != 0)
+      return -1;
+  }
+  catch (itk::ExceptionObject& e)
+  {
+    std::cerr << e << std::endl;
+    return -1;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return -1;
+  }
+  catch (std::string& s)
+  {
+    std::cerr << "Exception: " << s << std::endl;
+    return -1;
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown exception" << std::endl;
+    return -1;
+  }
+
+  return 0;
+
+
+}
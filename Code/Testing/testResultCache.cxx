@@ -0,0 +1,218 @@
+
+#include "ResultCache.h"
+
+#include "itkOutputWindow.h"
+#include "itkTextOutput.h"
+
+#include "itksys/SystemTools.hxx"
+
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+void
+writeFile(const std::string& fn, const std::string& contents)
+{
+  std::ofstream os(fn.c_str(), std::ios::out | std::ios::binary);
+  os << contents;
+}
+
+std::string
+readFile(const std::string& fn)
+{
+  std::ifstream is(fn.c_str(), std::ios::in | std::ios::binary);
+  std::ostringstream oss;
+  oss << is.rdbuf();
+  return oss.str();
+}
+
+// Compute step for FindOrCompute writing the given contents to the output
+// file and returning the given value, counting its calls
+struct WriteOutput
+{
+  std::string FileName;
+  std::string Contents;
+  int ReturnValue;
+  int* Calls;
+
+  int operator()() const
+  {
+    (*Calls)++;
+    writeFile(FileName, Contents);
+    return ReturnValue;
+  }
+};
+
+// Checks that a key is the same as the base key, or differs from it
+int
+checkKey(const std::string& key, const std::string& base, bool same,
+  const char* what)
+{
+  if (key.empty() || (key == base) != same)
+  {
+    std::cerr << "FAILED: key " << (same ? "changed" : "unchanged")
+      << " with " << what << ": " << key << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Keys must follow the contents of the files, the metric, the parameters
+// and the code version but not the file names, and results are only
+// stored when the metric succeeds
+int
+testResultCache(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " outputDirectory" << std::endl;
+    return -1;
+  }
+
+  itk::OutputWindow::SetInstance(itk::TextOutput::New());
+
+  std::string dir = std::string(argv[1]) + "/resultcache";
+  std::string cacheDir = dir + "/results";
+  itksys::SystemTools::RemoveADirectory(dir.c_str());
+  itksys::SystemTools::MakeDirectory(dir.c_str());
+
+  // Changed files have the size of the original, so only their contents
+  // tell them apart
+  std::string truthfn = dir + "/truth.txt";
+  std::string testfn = dir + "/test.txt";
+  std::string renamedfn = dir + "/renamed.txt";
+  std::string changedTruthfn = dir + "/truth_changed.txt";
+  std::string changedTestfn = dir + "/test_changed.txt";
+  writeFile(truthfn, "truth labels");
+  writeFile(testfn, "test labels");
+  writeFile(renamedfn, "test labels");
+  writeFile(changedTruthfn, "truth labelz");
+  writeFile(changedTestfn, "test labelz");
+
+  int failures = 0;
+
+  ResultCache::Pointer cache = ResultCache::New();
+
+  if (!cache->GetKey(truthfn, testfn, "Dice", "").empty())
+  {
+    std::cerr << "FAILED: key with the cache disabled" << std::endl;
+    failures++;
+  }
+
+  cache->SetDirectory(cacheDir);
+
+  std::string base = cache->GetKey(truthfn, testfn, "Dice", "label 1");
+
+  failures += checkKey(cache->GetKey(truthfn, testfn, "Dice", "label 1"),
+    base, true, "nothing");
+  failures += checkKey(cache->GetKey(truthfn, renamedfn, "Dice", "label 1"),
+    base, true, "the submission file name");
+  failures += checkKey(
+    cache->GetKey(changedTruthfn, testfn, "Dice", "label 1"),
+    base, false, "the truth contents");
+  failures += checkKey(
+    cache->GetKey(truthfn, changedTestfn, "Dice", "label 1"),
+    base, false, "the submission contents");
+  failures += checkKey(cache->GetKey(testfn, truthfn, "Dice", "label 1"),
+    base, false, "the files swapped");
+  failures += checkKey(cache->GetKey(truthfn, testfn, "Jaccard", "label 1"),
+    base, false, "the metric");
+  failures += checkKey(cache->GetKey(truthfn, testfn, "Dice", "label 2"),
+    base, false, "the parameters");
+
+  {
+    ResultCache::Pointer other = ResultCache::New();
+    other->SetDirectory(cacheDir);
+    other->SetVersion(std::string(ResultCache::CodeVersion) + ".1");
+    failures += checkKey(other->GetKey(truthfn, testfn, "Dice", "label 1"),
+      base, false, "the code version");
+  }
+
+  if (!cache->GetKey(truthfn, dir + "/missing.txt", "Dice", "").empty())
+  {
+    std::cerr << "FAILED: key for a missing file" << std::endl;
+    failures++;
+  }
+
+  // A failed metric leaves nothing behind and runs again the next time
+  std::string outfn = dir + "/output.txt";
+  int calls = 0;
+
+  WriteOutput failed;
+  failed.FileName = outfn;
+  failed.Contents = "partial";
+  failed.ReturnValue = 1;
+  failed.Calls = &calls;
+
+  std::string result;
+  if (cache->FindOrCompute(base, outfn, failed) != 1 || calls != 1 ||
+      cache->Find(base, result))
+  {
+    std::cerr << "FAILED: result of a failed metric stored" << std::endl;
+    failures++;
+  }
+
+  WriteOutput succeeded = failed;
+  succeeded.Contents = "Dice=0.75\n";
+  succeeded.ReturnValue = 0;
+
+  if (cache->FindOrCompute(base, outfn, succeeded) != 0 || calls != 2 ||
+      !cache->Find(base, result) || result != succeeded.Contents)
+  {
+    std::cerr << "FAILED: result of a metric not stored after a failure"
+      << std::endl;
+    failures++;
+  }
+
+  // Found from then on, without running the metric
+  itksys::SystemTools::RemoveFile(outfn.c_str());
+
+  WriteOutput other = succeeded;
+  other.Contents = "Dice=0.5\n";
+
+  if (cache->FindOrCompute(base, outfn, other) != 0 || calls != 2 ||
+      readFile(outfn) != succeeded.Contents)
+  {
+    std::cerr << "FAILED: stored result not found" << std::endl;
+    failures++;
+  }
+
+  return failures;
+}
+
+int
+main(int argc, char** argv)
+{
+  try
+  {
+    if (testResultCache(argc, argv) != 0)
+      return -1;
+  }
+  catch (itk::ExceptionObject& e)
+  {
+    std::cerr << e << std::endl;
+    return -1;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return -1;
+  }
+  catch (std::string& s)
+  {
+    std::cerr << "Exception: " << s << std::endl;
+    return -1;
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown exception" << std::endl;
+    return -1;
+  }
+
+  return 0;
+
+
+}
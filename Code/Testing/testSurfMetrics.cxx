@@ -6,12 +6,87 @@
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
+#include "vtkCellArray.h"
+#include "vtkIdList.h"
+#include "vtkPoints.h"
 #include "vtkSphereSource.h"
 
+#include "vnl/vnl_math.h"
+
+#include <cmath>
 #include <exception>
 #include <iostream>
 #include <string>
+#include <vector>
+
+
+// Currents distance by summing the kernel over every pair of triangles,
+// without truncation or approximation, as the reference for the metric
+double
+exactCurrentsValue(vtkPolyData* fixedPD, vtkPolyData* movingPD,
+  double kernelWidth)
+{
+  // Triangle centroids and area weighted normals, moving then fixed
+  std::vector<double> centers[2];
+  std::vector<double> normals[2];
+  vtkPolyData* surfaces[2] = { movingPD, fixedPD };
+
+  vtkSmartPointer<vtkIdList> ids = vtkSmartPointer<vtkIdList>::New();
+  for (unsigned int s = 0; s < 2; s++)
+  {
+    for (vtkIdType i = 0; i < surfaces[s]->GetNumberOfCells(); i++)
+    {
+      surfaces[s]->GetCellPoints(i, ids);
+      if (ids->GetNumberOfIds() != 3)
+        throw std::string("exactCurrentsValue: non triangle cell");
+
+      double x0[3];
+      double x1[3];
+      double x2[3];
+      surfaces[s]->GetPoint(ids->GetId(0), x0);
+      surfaces[s]->GetPoint(ids->GetId(1), x1);
+      surfaces[s]->GetPoint(ids->GetId(2), x2);
+
+      double u[3];
+      double v[3];
+      for (unsigned int d = 0; d < 3; d++)
+      {
+        centers[s].push_back((x0[d] + x1[d] + x2[d]) / 3.0);
+        u[d] = x1[d] - x0[d];
+        v[d] = x2[d] - x0[d];
+      }
+
+      normals[s].push_back((u[1]*v[2] - u[2]*v[1]) / 2.0);
+      normals[s].push_back((u[2]*v[0] - u[0]*v[2]) / 2.0);
+      normals[s].push_back((u[0]*v[1] - u[1]*v[0]) / 2.0);
+    }
+  }
 
+  // sum_i sum_j k(c_i, c_j) <n_i, n_j> over the difference of the currents
+  double var = kernelWidth * kernelWidth;
+
+  double sum = 0;
+  for (unsigned int s = 0; s < 2; s++)
+    for (unsigned int t = 0; t < 2; t++)
+    {
+      double sign = (s == t) ? 1.0 : -1.0;
+      for (unsigned int i = 0; i < centers[s].size(); i += 3)
+        for (unsigned int j = 0; j < centers[t].size(); j += 3)
+        {
+          double d2 = 0;
+          double dotnn = 0;
+          for (unsigned int d = 0; d < 3; d++)
+          {
+            double diff = centers[s][i+d] - centers[t][j+d];
+            d2 += diff*diff;
+            dotnn += normals[s][i+d] * normals[t][j+d];
+          }
+          sum += sign * dotnn * exp(-0.5 * d2 / var);
+        }
+    }
+
+  return sum / pow(2.0*var*vnl_math::pi, 3.0/2.0);
+}
 
 int
 testMetrics()
@@ -19,6 +94,9 @@ testMetrics()
 
   itk::OutputWindow::SetInstance(itk::TextOutput::New());
 
+  // Checks that fail are reported and counted, the rest still run
+  int failures = 0;
+
   vtkSmartPointer<vtkPolyData> spherePD1;
   {
     vtkSmartPointer<vtkSphereSource> sphereS = vtkSmartPointer<vtkSphereSource>::New();
@@ -71,6 +149,54 @@ testMetrics()
 
   std::cout << "Hausdorff(A,A) = " <<  haussdMetric->GetValue() << std::endl;
 
+  // Zero area triangles along an edge of B, one with two coincident
+  // vertices and one with a vertex at the edge midpoint, leave the surface
+  // and the largest point-to-triangle distance as they are
+  vtkSmartPointer<vtkPolyData> degeneratePD = vtkSmartPointer<vtkPolyData>::New();
+  degeneratePD->DeepCopy(spherePD2);
+  {
+    vtkSmartPointer<vtkIdList> ids = vtkSmartPointer<vtkIdList>::New();
+    degeneratePD->GetCellPoints(0, ids);
+    vtkIdType p0 = ids->GetId(0);
+    vtkIdType p1 = ids->GetId(1);
+
+    double x0[3];
+    double x1[3];
+    degeneratePD->GetPoint(p0, x0);
+    degeneratePD->GetPoint(p1, x1);
+    vtkIdType mid = degeneratePD->GetPoints()->InsertNextPoint(
+      0.5*(x0[0] + x1[0]), 0.5*(x0[1] + x1[1]), 0.5*(x0[2] + x1[2]));
+
+    vtkIdType coincident[3] = { p0, p0, p1 };
+    vtkIdType collinear[3] = { p0, mid, p1 };
+    degeneratePD->GetPolys()->InsertNextCell(3, coincident);
+    degeneratePD->GetPolys()->InsertNextCell(3, collinear);
+    degeneratePD->BuildCells();
+  }
+
+  haussdMetric->SetPointToTriangleDistance(true);
+  haussdMetric->SetPercentile(1.0);
+
+  haussdMetric->SetFixedSurface(spherePD1);
+  haussdMetric->SetMovingSurface(spherePD2);
+  double triangleHausdorff = haussdMetric->GetValue();
+
+  haussdMetric->SetMovingSurface(degeneratePD);
+  double degenerateHausdorff = haussdMetric->GetValue();
+
+  std::cout << "TriangleHausdorff(A,B) = " << triangleHausdorff << std::endl;
+  std::cout << "TriangleHausdorff(A,B degenerate) = " << degenerateHausdorff
+    << std::endl;
+
+  if (!vnl_math_isfinite(degenerateHausdorff)
+      || std::fabs(degenerateHausdorff - triangleHausdorff) > 1e-9)
+  {
+    std::cerr << "FAILED: point-to-triangle Hausdorff with degenerate "
+      << "triangles is " << degenerateHausdorff << ", without them "
+      << triangleHausdorff << std::endl;
+    failures++;
+  }
+
   CurrentsSurfaceToSurfaceMetric::Pointer currMetric = CurrentsSurfaceToSurfaceMetric::New();
   currMetric->SetFixedSurface(spherePD1);
   currMetric->SetMovingSurface(spherePD2);
@@ -84,7 +210,31 @@ testMetrics()
 
   std::cout << "Currents(A,A) = " <<  currMetric->GetValue() << std::endl;
 
-  return 0;
+  currMetric->SetFixedSurface(spherePD1);
+  currMetric->SetMovingSurface(spherePD2);
+  currMetric->UseParticleMeshApproximation();
+
+  double particleMeshCurrents = currMetric->GetValue();
+  double exactCurrents = exactCurrentsValue(spherePD1, spherePD2, 4.0);
+
+  std::cout << "Currents(A,B), particle mesh = " << particleMeshCurrents
+    << std::endl;
+  std::cout << "Currents(A,B), exact = " << exactCurrents << std::endl;
+
+  // At the default 4 grid points per kernel width the particle mesh is
+  // within about 0.1% of the exact sum on these spheres, fail past 1%
+  const double particleMeshTolerance = 0.01;
+  if (!vnl_math_isfinite(particleMeshCurrents)
+      || std::fabs(particleMeshCurrents - exactCurrents) >
+         particleMeshTolerance * std::fabs(exactCurrents))
+  {
+    std::cerr << "FAILED: particle mesh currents " << particleMeshCurrents
+      << " differ from the exact kernel sum " << exactCurrents
+      << " by more than " << 100.0*particleMeshTolerance << "%" << std::endl;
+    failures++;
+  }
+
+  return failures;
 
 }
 
@@ -93,7 +243,8 @@ main(int argc, char** argv)
 {
   try
   {
-    testMetrics();
+    if (testMetrics() != 0)
+      return -1;
   } 
   catch (itk::ExceptionObject& e)
   {
@@ -0,0 +1,280 @@
+
+#include "itkImage.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include "itkOutputWindow.h"
+#include "itkTextOutput.h"
+
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef itk::Image<unsigned short, 3> ImageType;
+
+// Cube of the given size with a box of label 1 holding a smaller box of
+// label 2, both moved along x by shift voxels
+ImageType::Pointer
+createLabelImage(unsigned int size, unsigned int shift)
+{
+  ImageType::SizeType imageSize;
+  imageSize.Fill(size);
+
+  ImageType::RegionType region;
+  region.SetSize(imageSize);
+
+  ImageType::Pointer img = ImageType::New();
+  img->SetRegions(region);
+  img->Allocate();
+
+  typedef itk::ImageRegionIteratorWithIndex<ImageType> IteratorType;
+  IteratorType it(img, region);
+
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    ImageType::IndexType index = it.GetIndex();
+    index[0] -= shift;
+
+    bool inner = true;
+    bool outer = true;
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+      long i = index[dim];
+      outer = outer && i >= (long)size/4 && i < (long)(3*size)/4;
+      inner = inner && i >= (long)size/3 && i < (long)size/2;
+    }
+
+    it.Set(inner ? 2 : (outer ? 1 : 0));
+  }
+
+  return img;
+}
+
+void
+writeImage(ImageType* img, const std::string& fn, bool compress)
+{
+  typedef itk::ImageFileWriter<ImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(img);
+  writer->SetFileName(fn);
+  writer->SetUseCompression(compress);
+  writer->Update();
+}
+
+std::string
+readFile(const std::string& fn)
+{
+  std::ifstream is(fn.c_str(), std::ios::in | std::ios::binary);
+  std::ostringstream oss;
+  oss << is.rdbuf();
+  return oss.str();
+}
+
+// Runs validateLabelImages with the given arguments, returning its exit
+// status and its standard output in out
+int
+runValidate(const std::string& exe, const std::string& args,
+  const std::string& dir, std::string& out)
+{
+  std::string outfn = dir + "/validate_out.txt";
+  std::string command = "\"" + exe + "\" " + args +
+    " > \"" + outfn + "\" 2> \"" + dir + "/validate_err.txt\"";
+
+  int status = std::system(command.c_str());
+  out = readFile(outfn);
+  return status;
+}
+
+// Batch output entry of a pair from the metric_name=value lines of single
+// pair mode
+std::string
+batchEntry(const std::string& dataset, const std::string& output)
+{
+  std::ostringstream oss;
+  oss << "{\"dataset\": \"" << dataset << "\", \"metrics\": [";
+
+  std::istringstream iss(output);
+  std::string line;
+  bool first = true;
+  while (std::getline(iss, line))
+  {
+    std::string::size_type eq = line.find('=');
+    if (eq == std::string::npos)
+      continue;
+
+    if (!first)
+      oss << ", ";
+    first = false;
+
+    oss << "{\"name\": \"" << line.substr(0, eq) << "\", \"value\": \""
+      << line.substr(eq+1) << "\"}";
+  }
+
+  oss << "]}";
+  return oss.str();
+}
+
+// Scores a manifest of generated pairs with validateLabelImages --manifest
+// and checks that each pair gets the metrics of single pair mode, whatever
+// the number of threads or the memory limit, and that a pair with a missing
+// file fails alone
+int
+testValidateBatch(int argc, char** argv)
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0]
+      << " validateLabelImagesExecutable outputDirectory" << std::endl;
+    return -1;
+  }
+
+  itk::OutputWindow::SetInstance(itk::TextOutput::New());
+
+  std::string exe = argv[1];
+  std::string dir = argv[2];
+
+  int failures = 0;
+
+  // Pairs of different sizes, so the pool does not take them in manifest
+  // order, every other one compressed so it is read rather than mapped and
+  // counts against the memory limit of the reader threads. The largest
+  // compressed pair takes 2.7 MB once read.
+  const unsigned int numPairs = 4;
+  std::vector<std::string> truthFiles;
+  std::vector<std::string> testFiles;
+  std::vector<std::string> entries;
+  for (unsigned int i = 0; i < numPairs; i++)
+  {
+    std::ostringstream name;
+    name << "batch" << i;
+    truthFiles.push_back(dir + "/" + name.str() + "_truth.mha");
+    testFiles.push_back(dir + "/" + name.str() + "_test.mha");
+
+    unsigned int size = 40 + 16*i;
+    writeImage(createLabelImage(size, 0), truthFiles[i], i % 2 != 0);
+    writeImage(createLabelImage(size, i + 1), testFiles[i], i % 2 != 0);
+
+    std::string out;
+    if (runValidate(exe,
+        "\"" + truthFiles[i] + "\" \"" + testFiles[i] + "\"", dir, out) != 0)
+    {
+      std::cerr << "FAILED: single pair mode on " << testFiles[i] << std::endl;
+      failures++;
+    }
+
+    entries.push_back(batchEntry(name.str() + "_truth.mha", out));
+  }
+
+  std::string manifestfn = dir + "/batch_manifest.txt";
+  {
+    std::ofstream os(manifestfn.c_str());
+    for (unsigned int i = 0; i < numPairs; i++)
+      os << truthFiles[i] << "\t" << testFiles[i] << "\n";
+  }
+
+  std::string expected = "[";
+  for (unsigned int i = 0; i < numPairs; i++)
+    expected += (i > 0 ? ", " : "") + entries[i];
+  expected += "]\n";
+
+  // Threads, then threads and a memory limit of 1 MB, below the largest
+  // pair, which stops the reader threads until that pair is scored
+  const char* options[3] = { "1", "4", "4 1" };
+  for (unsigned int k = 0; k < 3; k++)
+  {
+    std::string out;
+    int status = runValidate(exe,
+      "--manifest \"" + manifestfn + "\" " + options[k], dir, out);
+    if (status != 0 || out != expected)
+    {
+      std::cerr << "FAILED: manifest with options " << options[k]
+        << ", status " << status << ", output" << std::endl
+        << out << "expected" << std::endl << expected;
+      failures++;
+    }
+  }
+
+  // A pair whose submission is missing, in the middle of the manifest
+  std::string missingTruth = dir + "/missing_truth.mha";
+  writeImage(createLabelImage(24, 0), missingTruth, false);
+
+  std::string missingManifestfn = dir + "/batch_manifest_missing.txt";
+  {
+    std::ofstream os(missingManifestfn.c_str());
+    for (unsigned int i = 0; i < numPairs; i++)
+    {
+      if (i == numPairs/2)
+        os << missingTruth << "\t" << dir << "/missing_test.mha\n";
+      os << truthFiles[i] << "\t" << testFiles[i] << "\n";
+    }
+  }
+
+  {
+    std::string out;
+    int status = runValidate(exe,
+      "--manifest \"" + missingManifestfn + "\" 4", dir, out);
+    if (status == 0)
+    {
+      std::cerr << "FAILED: manifest with a missing file succeeded" << std::endl;
+      failures++;
+    }
+
+    if (out.find("{\"dataset\": \"missing_truth.mha\", \"error\": \"") ==
+        std::string::npos)
+    {
+      std::cerr << "FAILED: no error for the missing file in" << std::endl
+        << out;
+      failures++;
+    }
+
+    for (unsigned int i = 0; i < numPairs; i++)
+    {
+      if (out.find(entries[i]) == std::string::npos)
+      {
+        std::cerr << "FAILED: pair " << i << " not scored next to a missing "
+          << "file, expected" << std::endl << entries[i] << std::endl;
+        failures++;
+      }
+    }
+  }
+
+  return failures;
+}
+
+int
+main(int argc, char** argv)
+{
+  try
+  {
+    if (testValidateBatch(argc, argv) != 0)
+      return -1;
+  }
+  catch (itk::ExceptionObject& e)
+  {
+    std::cerr << e << std::endl;
+    return -1;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return -1;
+  }
+  catch (std::string& s)
+  {
+    std::cerr << "Exception: " << s << std::endl;
+    return -1;
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown exception" << std::endl;
+    return -1;
+  }
+
+  return 0;
+
+
+}
@@ -3,15 +3,32 @@
  * metric one per line to stdout in the form:
  *
  * <metric_name>=<value>
+ *
+ * With --manifest, scores every (truth, submission) pair listed in a file,
+ * one pair per line separated by a tab, on a pool of threads, while reader
+ * threads read the next pairs ahead of the pool. The metrics of all pairs
+ * are written to stdout as one JSON document, the same as the output of
+ * scoreSubmission.py:
+ *
+ * [{"dataset": <truth file name>, "metrics": [{"name": <metric_name>,
+ *   "value": <value>}, ...]}, ...]
+ *
+ * A pair that cannot be read or scored has "error": <messages> in place of
+ * its metrics, without holding up the other pairs, and the exit status is
+ * then nonzero.
+ *
+ * With --groundTruthCache, the boundaries and distance maps of each truth
+ * image are read from the given directory, or computed and stored there
+ * for the next submission scored against the same truth.
+ *
+ * With --resultCache, the metrics of pairs scored before are looked up in
+ * the given directory by the contents of both files, and the metrics of new
+ * pairs are stored there.
  */
 
-#include "DiceOverlapImageToImageMetric.h"
-#include "JaccardOverlapImageToImageMetric.h"
-#include "SensitivityImageToImageMetric.h"
-#include "SpecificityImageToImageMetric.h"
-#include "PositivePredictiveValueImageToImageMetric.h"
-
-#include "MultipleBinaryImageMetricsCalculator.h"
+#include "GroundTruthCache.h"
+#include "MultipleLabelOverlapCalculator.h"
+#include "SurfaceDistanceCache.h"
 
 #include "CohenKappaImageToImageMetric.h"
 
@@ -19,89 +36,86 @@
 #include "HausdorffDistanceImageToImageMetric.h"
 
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageRegionIterator.h"
 
+#include "ImagePairPrefetcher.h"
+#include "MappedImageFileReader.h"
+#include "ResultCache.h"
+#include "WorkStealingJobPool.h"
+
+#include "itkImageIOFactory.h"
+
 #include "itkOutputWindow.h"
 #include "itkTextOutput.h"
 
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <cstdlib>
 #include <exception>
+#include <fstream>
 #include <iostream>
-#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 typedef unsigned short PixelType;
 typedef itk::Image<PixelType, 3> ImageType;
 
+typedef SurfaceDistanceCache<ImageType> SurfaceDistanceCacheType;
+typedef GroundTruthCache<ImageType> GroundTruthCacheType;
+
 /**
- * Validate that the given image contains only two labels. This is implemented by
- * iterating over the pixels in the image and ensuring that the number of distinct
- * values is no more than three.
+ * Validate that the given image contains only two labels, that is no more
+ * than three distinct values counting the background. The values are taken
+ * from the label inventory kept by the distance cache, which the distance
+ * metrics reuse later.
  */
-bool validateLabelCount(const ImageType::Pointer& image)
+bool validateLabelCount(SurfaceDistanceCacheType* cache, const ImageType* image)
 {
-  itk::ImageRegionConstIterator<ImageType> itr(image, image->GetRequestedRegion());
-  std::set<PixelType> distinctValues;
-
-  itr.GoToBegin();
-  while (!itr.IsAtEnd())
-  {
-    distinctValues.insert(itr.Get());
-
-    if (distinctValues.size() > 3) {
-        return false;
-    }
-    ++itr;
-  }
-  return true;
+  return cache->GetLabelImageInventory(image)->GetNumberOfDistinctValues() <= 3;
 }
 
 int
-validateLabelImages(const char* fixedfn, const char* movingfn)
+scoreLabelImages(ImageType* fixedImage, ImageType* movingImage,
+  const char* fixedfn, const char* movingfn, const std::string& cacheDir,
+  int numThreads, std::ostream& out, std::ostream& err)
 {
-  typedef itk::ImageFileReader<ImageType> ReaderType;
-
-  ReaderType::Pointer freader = ReaderType::New();
-  freader->SetFileName(fixedfn);
-  freader->Update();
-  ImageType::Pointer fixedImage = freader->GetOutput();
-
-  ReaderType::Pointer mreader = ReaderType::New();
-  mreader->SetFileName(movingfn);
-  mreader->Update();
-  ImageType::Pointer movingImage = mreader->GetOutput();
-
   ImageType::SizeType fsize = fixedImage->GetLargestPossibleRegion().GetSize();
   ImageType::SizeType msize = movingImage->GetLargestPossibleRegion().GetSize();
 
   if (fsize != msize) {
-    std::cerr << "Error: Image sizes do not match. Make sure that your image " <<
+    err << "Error: Image sizes do not match. Make sure that your image " <<
       "orientation is correct." << std::endl;
-    std::cerr << "Fixed size: " << fsize << std::endl;
-    std::cerr << "Moving size: " << msize << std::endl;
+    err << "Fixed size: " << fsize << std::endl;
+    err << "Moving size: " << msize << std::endl;
     return 1;
   }
 
-  if (!validateLabelCount(fixedImage)) {
-    std::cerr << "Error: " << fixedfn << " has more than two labels." << std::endl;
+  // Shared by the label checks and the distance metrics
+  SurfaceDistanceCacheType::Pointer distanceCache = SurfaceDistanceCacheType::New();
+  distanceCache->CropToBoundingBoxOn();
+  if (numThreads > 0)
+    distanceCache->SetNumberOfThreads(numThreads);
+
+  if (!cacheDir.empty())
+  {
+    GroundTruthCacheType::Pointer truthCache = GroundTruthCacheType::New();
+    truthCache->SetDirectory(cacheDir);
+    truthCache->SetSurfaceDistanceCache(distanceCache);
+    truthCache->Load(fixedImage);
+  }
+
+  if (!validateLabelCount(distanceCache, fixedImage)) {
+    err << "Error: " << fixedfn << " has more than two labels." << std::endl;
     return 1;
   }
-  if (!validateLabelCount(movingImage)) {
-    std::cerr << "Error: " << movingfn << " has more than two labels." << std::endl;
+  if (!validateLabelCount(distanceCache, movingImage)) {
+    err << "Error: " << movingfn << " has more than two labels." << std::endl;
     return 1;
   }
 
   // Metrics for binary data
-  typedef DiceOverlapImageToImageMetric<ImageType, ImageType>
-    DiceMetricType;
-  typedef JaccardOverlapImageToImageMetric<ImageType, ImageType>
-    JaccardMetricType;
-  typedef SpecificityImageToImageMetric<ImageType, ImageType>
-    SpecificityMetricType;
-  typedef SensitivityImageToImageMetric<ImageType, ImageType>
-    SensitivityMetricType;
-  typedef PositivePredictiveValueImageToImageMetric<ImageType, ImageType>
-    PPVMetricType;
   typedef AverageDistanceImageToImageMetric<ImageType, ImageType>
     AverageDistanceMetricType;
   typedef HausdorffDistanceImageToImageMetric<ImageType, ImageType>
@@ -111,104 +125,404 @@ validateLabelImages(const char* fixedfn, const char* movingfn)
   typedef CohenKappaImageToImageMetric<ImageType, ImageType>
     KappaMetricType;
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, DiceMetricType>
-    DiceCalculatorType;
+  // Overlap metrics for all labels share one confusion table
+  typedef MultipleLabelOverlapCalculator<ImageType, ImageType>
+    OverlapCalculatorType;
+  std::vector<unsigned long> labels;
   {
-    DiceCalculatorType::Pointer calc = DiceCalculatorType::New();
+    OverlapCalculatorType::Pointer calc = OverlapCalculatorType::New();
     calc->SetFixedImage(fixedImage);
     calc->SetMovingImage(movingImage);
+    if (numThreads > 0)
+      calc->SetNumberOfThreads(numThreads);
     calc->Update();
     for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "Dice" << i+1 << "=" << calc->GetValue(i) << std::endl;
+      labels.push_back(calc->GetLabel(i));
+    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
+      out << "Dice" << labels[i] << "=" << calc->GetDice(i) << std::endl;
+    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
+      out << "Jac" << labels[i] << "=" << calc->GetJaccard(i) << std::endl;
+    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
+      out << "Spec" << labels[i] << "=" << calc->GetSpecificity(i) << std::endl;
+    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
+      out << "Sens" << labels[i] << "=" << calc->GetSensitivity(i) << std::endl;
+    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
+      out << "PPV" << labels[i] << "=" << calc->GetPositivePredictiveValue(i) << std::endl;
   }
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, JaccardMetricType>
-    JaccardCalculatorType;
+  // Distance metrics for each label share the boundaries and distance maps,
+  // which are released once both metrics are done with the label. These are
+  // only computed around the label, not over the whole volume. Labels are
+  // those present in either image, as for the overlap metrics.
   {
-    JaccardCalculatorType::Pointer calc = JaccardCalculatorType::New();
-    calc->SetFixedImage(fixedImage);
-    calc->SetMovingImage(movingImage);
-    calc->Update();
-    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "Jac" << i+1 << "=" << calc->GetValue(i) << std::endl;
+    std::vector<double> aveDistValues;
+    std::vector<double> hausdorffValues;
+
+    for (unsigned int i = 0; i < labels.size(); i++)
+    {
+      PixelType label = (PixelType)labels[i];
+
+      AverageDistanceMetricType::Pointer adb = AverageDistanceMetricType::New();
+      adb->SetFixedImage(fixedImage);
+      adb->SetMovingImage(movingImage);
+      adb->SetSurfaceDistanceCache(distanceCache);
+      adb->SetLabel(label);
+      if (numThreads > 0)
+        adb->SetNumberOfThreads(numThreads);
+      aveDistValues.push_back(adb->GetValue());
+
+      HausdorffDistanceMetricType::Pointer hdb = HausdorffDistanceMetricType::New();
+      hdb->SetFixedImage(fixedImage);
+      hdb->SetMovingImage(movingImage);
+      hdb->SetSurfaceDistanceCache(distanceCache);
+      hdb->SetLabel(label);
+      if (numThreads > 0)
+        hdb->SetNumberOfThreads(numThreads);
+      hausdorffValues.push_back(hdb->GetValue());
+
+      distanceCache->ReleaseLabel(label);
+    }
+
+    for (unsigned int i = 0; i < aveDistValues.size(); i++)
+      out << "Adb" << labels[i] << "=" << aveDistValues[i] << std::endl;
+    for (unsigned int i = 0; i < hausdorffValues.size(); i++)
+      out << "Hdb" << labels[i] << "=" << hausdorffValues[i] << std::endl;
   }
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, SpecificityMetricType>
-    SpecificityCalculatorType;
+  KappaMetricType::Pointer kappa = KappaMetricType::New();
+  kappa->SetFixedImage(fixedImage);
+  kappa->SetMovingImage(movingImage);
+  if (numThreads > 0)
+    kappa->SetNumberOfThreads(numThreads);
+  out << "Kap=" << kappa->GetValue() << std::endl;
+
+  return 0;
+}
+
+int
+validateLabelImages(const char* fixedfn, const char* movingfn,
+  const std::string& cacheDir, ResultCache* results,
+  std::ostream& out, std::ostream& err)
+{
+  // Pairs of unchanged files scored before are looked up
+  std::string key =
+    results->GetKey(fixedfn, movingfn, "validateLabelImages", "");
+  std::string stored;
+  if (results->Find(key, stored))
   {
-    SpecificityCalculatorType::Pointer calc = SpecificityCalculatorType::New();
-    calc->SetFixedImage(fixedImage);
-    calc->SetMovingImage(movingImage);
-    calc->Update();
-    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "Spec" << i+1 << "=" << calc->GetValue(i) << std::endl;
+    out << stored;
+    return 0;
   }
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, SensitivityMetricType>
-    SensitivityCalculatorType;
+  typedef MappedImageFileReader<ImageType> ReaderType;
+
+  ReaderType::Pointer freader = ReaderType::New();
+  freader->SetFileName(fixedfn);
+  freader->Update();
+  ImageType::Pointer fixedImage = freader->GetOutput();
+
+  ReaderType::Pointer mreader = ReaderType::New();
+  mreader->SetFileName(movingfn);
+  mreader->Update();
+  ImageType::Pointer movingImage = mreader->GetOutput();
+
+  std::ostringstream scores;
+  int status = scoreLabelImages(
+    fixedImage, movingImage, fixedfn, movingfn, cacheDir, 0, scores, err);
+  if (status == 0)
+    results->Store(key, scores.str());
+
+  out << scores.str();
+  return status;
+}
+
+typedef ImagePairPrefetcher<ImageType, ImageType> PrefetcherType;
+
+// One pair of a manifest, scored on a pool thread
+struct BatchCase
+{
+  std::string Dataset;
+  std::string TruthFileName;
+  std::string TestFileName;
+  std::string ResultKey;
+
+  int Status;
+  std::string Output;
+  std::string Errors;
+};
+
+struct Batch
+{
+  std::vector<BatchCase> Cases;
+
+  // Case scored by each job, those not found in the result cache
+  std::vector<unsigned int> Jobs;
+
+  PrefetcherType::Pointer Prefetcher;
+  std::string GroundTruthCacheDirectory;
+  ResultCache::Pointer Results;
+
+  // Threads for the metrics of each pair
+  int ThreadsPerCase;
+};
+
+void
+scoreBatchCase(unsigned int job, unsigned int, void* data)
+{
+  Batch* batch = static_cast<Batch*>(data);
+  BatchCase& c = batch->Cases[batch->Jobs[job]];
+
+  ImageType::Pointer fixedImage;
+  ImageType::Pointer movingImage;
+  batch->Prefetcher->GetPair(job, fixedImage, movingImage);
+
+  std::ostringstream out;
+  std::ostringstream err;
+  c.Status = scoreLabelImages(fixedImage, movingImage,
+    c.TruthFileName.c_str(), c.TestFileName.c_str(),
+    batch->GroundTruthCacheDirectory, batch->ThreadsPerCase, out, err);
+  c.Output = out.str();
+  c.Errors = err.str();
+
+  if (c.Status == 0)
+    batch->Results->Store(c.ResultKey, c.Output);
+}
+
+std::string
+quoteJSON(const std::string& s)
+{
+  std::ostringstream oss;
+  oss << '"';
+  for (unsigned int i = 0; i < s.size(); i++)
   {
-    SensitivityCalculatorType::Pointer calc = SensitivityCalculatorType::New();
-    calc->SetFixedImage(fixedImage);
-    calc->SetMovingImage(movingImage);
-    calc->Update();
-    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "Sens" << i+1 << "=" << calc->GetValue(i) << std::endl;
+    if (s[i] == '"' || s[i] == '\\')
+      oss << '\\' << s[i];
+    else if (s[i] == '\n')
+      oss << "\\n";
+    else if (s[i] == '\t')
+      oss << "\\t";
+    else
+      oss << s[i];
   }
+  oss << '"';
+  return oss.str();
+}
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, PPVMetricType>
-    PPVCalculatorType;
+/**
+ * Scores the pairs listed in the manifest. The largest pairs, by file size,
+ * are started first and each thread takes another pair as soon as it is
+ * done, so a few large cases do not hold up the rest. Metrics of a pair run
+ * on the threads left over once every pool thread has a pair.
+ *
+ * Pairs are read ahead in the same order on two reader threads, holding at
+ * most one pair per pool thread, and no more than the memory limit in MB,
+ * if there is one, besides the pairs being scored.
+ *
+ * Pairs found in the result cache are neither read nor scored.
+ */
+int
+validateBatch(const char* manifestfn, int numThreads, int memoryLimit,
+  const std::string& cacheDir, const std::string& resultCacheDir)
+{
+  Batch batch;
+  batch.GroundTruthCacheDirectory = cacheDir;
+  batch.ThreadsPerCase = 0;
+  batch.Results = ResultCache::New();
+  batch.Results->SetDirectory(resultCacheDir);
+  std::vector<BatchCase>& cases = batch.Cases;
+
+  std::ifstream manifest(manifestfn);
+  if (!manifest.is_open())
   {
-    PPVCalculatorType::Pointer calc = PPVCalculatorType::New();
-    calc->SetFixedImage(fixedImage);
-    calc->SetMovingImage(movingImage);
-    calc->Update();
-    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "PPV" << i+1 << "=" << calc->GetValue(i) << std::endl;
+    std::cerr << "Error: cannot open manifest " << manifestfn << std::endl;
+    return 1;
   }
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, AverageDistanceMetricType>
-    AverageDistanceCalculatorType;
+  std::string line;
+  while (std::getline(manifest, line))
   {
-    AverageDistanceCalculatorType::Pointer calc = AverageDistanceCalculatorType::New();
-    calc->SetFixedImage(fixedImage);
-    calc->SetMovingImage(movingImage);
-    calc->Update();
-    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "Adb" << i+1 << "=" << calc->GetValue(i) << std::endl;
+    if (!line.empty() && line[line.size()-1] == '\r')
+      line.erase(line.size()-1);
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::string::size_type tab = line.find('\t');
+    if (tab == std::string::npos)
+    {
+      std::cerr << "Error: manifest line is not truth<TAB>submission: "
+        << line << std::endl;
+      return 1;
+    }
+
+    BatchCase c;
+    c.TruthFileName = line.substr(0, tab);
+    c.TestFileName = line.substr(tab+1);
+    c.Dataset = itksys::SystemTools::GetFilenameName(c.TruthFileName);
+    c.Status = 1;
+    cases.push_back(c);
   }
 
-  typedef MultipleBinaryImageMetricsCalculator<ImageType, ImageType, HausdorffDistanceMetricType>
-    HausdorffDistanceCalculatorType;
+  if (cases.empty())
   {
-    HausdorffDistanceCalculatorType::Pointer calc = HausdorffDistanceCalculatorType::New();
-    calc->SetFixedImage(fixedImage);
-    calc->SetMovingImage(movingImage);
-    calc->Update();
-    for (unsigned int i = 0; i < calc->GetNumberOfValues(); i++)
-      std::cout << "Hdb" << i+1 << "=" << calc->GetValue(i) << std::endl;
+    std::cout << "[]" << std::endl;
+    return 0;
   }
 
-  KappaMetricType::Pointer kappa = KappaMetricType::New();
-  kappa->SetFixedImage(fixedImage);
-  kappa->SetMovingImage(movingImage);
-  std::cout << "Kap=" << kappa->GetValue() << std::endl;
+  for (unsigned int i = 0; i < cases.size(); i++)
+  {
+    cases[i].ResultKey = batch.Results->GetKey(cases[i].TruthFileName,
+      cases[i].TestFileName, "validateLabelImages", "");
+    if (batch.Results->Find(cases[i].ResultKey, cases[i].Output))
+      cases[i].Status = 0;
+    else
+      batch.Jobs.push_back(i);
+  }
 
-  return 0;
+  if (!batch.Jobs.empty())
+  {
+    std::vector<double> costs;
+    for (unsigned int j = 0; j < batch.Jobs.size(); j++)
+    {
+      const BatchCase& c = cases[batch.Jobs[j]];
+      costs.push_back(
+        (double)itksys::SystemTools::FileLength(c.TruthFileName) +
+        (double)itksys::SystemTools::FileLength(c.TestFileName));
+    }
+
+    WorkStealingJobPool::Pointer pool = WorkStealingJobPool::New();
+    if (numThreads > 0)
+      pool->SetNumberOfThreads(numThreads);
+    pool->SetJobCosts(costs);
+
+    batch.ThreadsPerCase = std::max(
+      (int)pool->GetNumberOfThreads() / (int)batch.Jobs.size(), 1);
+
+    // Register the image IO factories before the reader threads create readers
+    itk::ImageIOFactory::CreateImageIO(
+      cases[batch.Jobs[0]].TruthFileName.c_str(),
+      itk::ImageIOFactory::ReadMode);
+
+    batch.Prefetcher = PrefetcherType::New();
+    for (unsigned int j = 0; j < batch.Jobs.size(); j++)
+      batch.Prefetcher->AddPair(cases[batch.Jobs[j]].TruthFileName,
+        cases[batch.Jobs[j]].TestFileName);
+    batch.Prefetcher->SetReadOrder(pool->GetJobOrder());
+    batch.Prefetcher->SetMaximumQueueLength(pool->GetNumberOfThreads());
+    if (memoryLimit > 0)
+      batch.Prefetcher->SetMemoryLimit((itk::SizeValueType)memoryLimit << 20);
+    batch.Prefetcher->Start();
+
+    pool->Run(scoreBatchCase, &batch);
+
+    batch.Prefetcher->Stop();
+
+    for (unsigned int j = 0; j < batch.Jobs.size(); j++)
+    {
+      if (pool->GetJobError(j).empty())
+        continue;
+
+      BatchCase& c = cases[batch.Jobs[j]];
+      c.Status = 1;
+      c.Errors += pool->GetJobError(j);
+    }
+  }
+
+  bool failed = false;
+  for (unsigned int i = 0; i < cases.size(); i++)
+  {
+    if (cases[i].Status == 0)
+      continue;
+
+    failed = true;
+    std::cerr << "Error scoring " << cases[i].TestFileName << ":" << std::endl;
+    std::cerr << cases[i].Errors << std::endl;
+  }
+
+  // Every pair is listed, with the errors in place of the metrics of those
+  // that failed
+  std::cout << "[";
+  for (unsigned int i = 0; i < cases.size(); i++)
+  {
+    if (i > 0)
+      std::cout << ", ";
+    std::cout << "{\"dataset\": " << quoteJSON(cases[i].Dataset);
+
+    if (cases[i].Status != 0)
+    {
+      std::cout << ", \"error\": " << quoteJSON(cases[i].Errors) << "}";
+      continue;
+    }
+
+    std::cout << ", \"metrics\": [";
+
+    std::istringstream iss(cases[i].Output);
+    bool first = true;
+    while (std::getline(iss, line))
+    {
+      std::string::size_type eq = line.find('=');
+      if (eq == std::string::npos)
+        continue;
+
+      if (!first)
+        std::cout << ", ";
+      first = false;
+
+      std::cout << "{\"name\": " << quoteJSON(line.substr(0, eq))
+        << ", \"value\": " << quoteJSON(line.substr(eq+1)) << "}";
+    }
+
+    std::cout << "]}";
+  }
+  std::cout << "]" << std::endl;
+
+  return failed ? 1 : 0;
 }
 
 int
 main(int argc, char** argv)
 {
-  if (argc != 3)
+  // Arguments after the cache options, if given
+  int first = 1;
+  std::string cacheDir;
+  std::string resultCacheDir;
+  while (argc - first >= 2)
   {
-    std::cerr << argv[0] << " fixed moving" << std::endl;
+    std::string option = argv[first];
+    if (option == "--groundTruthCache")
+      cacheDir = argv[first+1];
+    else if (option == "--resultCache")
+      resultCacheDir = argv[first+1];
+    else
+      break;
+    first += 2;
+  }
+  int numArgs = argc - first;
+
+  bool batch = numArgs >= 2 && std::string(argv[first]) == "--manifest";
+
+  if ((batch && numArgs > 4) || (!batch && numArgs != 2))
+  {
+    std::cerr << argv[0] << " [--groundTruthCache dir] [--resultCache dir]"
+      << " fixed moving" << std::endl;
+    std::cerr << argv[0] << " [--groundTruthCache dir] [--resultCache dir]"
+      << " --manifest manifest [threads [memoryLimitMB]]" << std::endl;
     return 1;
   }
 
   int val(0);
   try
   {
-    val = validateLabelImages(argv[1], argv[2]);
+    if (batch)
+      val = validateBatch(argv[first+1],
+        numArgs > 2 ? atoi(argv[first+2]) : 0,
+        numArgs > 3 ? atoi(argv[first+3]) : 0, cacheDir, resultCacheDir);
+    else
+    {
+      ResultCache::Pointer results = ResultCache::New();
+      results->SetDirectory(resultCacheDir);
+      val = validateLabelImages(argv[first], argv[first+1], cacheDir,
+        results, std::cout, std::cerr);
+    }
   }
   catch (itk::ExceptionObject& e)
   {
@@ -62,6 +62,110 @@ def getMetricValues(textFilename, numLabels):
   #print "Metric values for",  metrics
   return metrics
 
+def getAllMetricValues(jsonFilename, metricBinaryList, numLabels):
+  """
+  Get list of metric values from the JSON output of ValidateImageAll, in the
+  order of the metric binaries, accounting for missing objects.
+  """
+
+  with open(jsonFilename, 'r') as f:
+    results = json.load(f)
+
+  values = []
+  for b in metricBinaryList:
+    name = os.path.basename(b)[len("ValidateImage"):]
+    result = results.get(name)
+
+    if not isinstance(result, dict):
+      # Single entry for multiple objects (e.g., kappa), null is undefined
+      if result is None or np.isinf(result):
+        result = np.nan
+      values += [float(result)]
+      continue
+
+    # Tag missing segmentation objects using nan
+    metrics = [np.nan] * numLabels
+    for label, value in result.items():
+      index = int(label) - 1
+      if index < 0 or index >= numLabels:
+        continue
+      # For consistency, tag inf as nan
+      if value is None or np.isinf(value):
+        value = np.nan
+      metrics[index] = float(value)
+
+    values += metrics
+
+  return values
+
+def getMissingMetricValues(metricBinaryList, numLabels):
+  """
+  Get list of nan values for metrics that could not be computed, in the
+  order of the metric binaries.
+  """
+
+  values = []
+  for b in metricBinaryList:
+    if os.path.basename(b).find("Kappa") >= 0:
+      values += [np.nan]
+    else:
+      values += [np.nan] * numLabels
+
+  return values
+
+def evaluateMetrics(metricBinaryList, allBinary, fixed, moving, textout,
+  numLabels, resultCache=None):
+  """
+  Run the metric apps on a pair of label images, returning the values of all
+  metrics and objects. With ValidateImageAll the images are read once for
+  all metrics. With a result cache directory, the apps look up pairs they
+  have scored before instead of computing them again.
+  """
+
+  metricValues = []
+
+  cacheArgs = []
+  if resultCache is not None:
+    cacheArgs = ["--resultCache", resultCache]
+
+  if allBinary is not None:
+    names = [os.path.basename(b)[len("ValidateImage"):] for b in metricBinaryList]
+    command = [allBinary, fixed, moving, textout, "--metrics", ",".join(names)]
+    command += cacheArgs
+
+    p = subprocess.Popen(args=command, stdout=subprocess.PIPE,
+      stderr=subprocess.PIPE)
+    stdout, stderr = p.communicate()
+
+    # The output file may hold the results of an earlier pair
+    if p.returncode != 0:
+      print "WARNING: Cannot evaluate metrics on", fixed, "and", moving, \
+        "\n", stderr
+      return getMissingMetricValues(metricBinaryList, numLabels)
+
+    return getAllMetricValues(textout, metricBinaryList, numLabels)
+
+  for b in metricBinaryList:
+
+    # Run validation app and obtain list of metrics from stdout
+    command = [b, fixed, moving, textout] + cacheArgs
+
+    #print "Running", command
+
+    p = subprocess.Popen(args=command, stdout=subprocess.PIPE,
+      stderr=subprocess.PIPE)
+    stdout, stderr = p.communicate()
+
+    if p.returncode != 0:
+      print "WARNING: Cannot evaluate", os.path.basename(b), "on", fixed, \
+        "and", moving, "\n", stderr
+      metricValues += getMissingMetricValues([b], numLabels)
+      continue
+
+    metricValues += getMetricValues(textout, numLabels)
+
+  return metricValues
+
 def getSubjectKey(s):
   """Get subject key given the filename."""
   f, ext = os.path.splitext(os.path.basename(s))
@@ -88,6 +192,8 @@ if __name__ == "__main__":
     help="number of perturbations per ground truth")
   parser.add_argument("-t", "--threads", type=int, default=8,
     help="number of threads (processes) for metric evaluations")
+  parser.add_argument("-c", "--cache", type=str, default=None,
+    help="directory of stored metric results, reused by later runs")
 
   args = parser.parse_args()
 
@@ -100,6 +206,8 @@ if __name__ == "__main__":
   numPerturbations = args.perturbations
   numProcesses = args.threads
 
+  resultCache = args.cache
+
   numCPU = multiprocessing.cpu_count()
   if numProcesses > numCPU or numProcesses < 1:
     print "Setting number of processes from", numProcesses, "to", numCPU
@@ -123,6 +231,14 @@ if __name__ == "__main__":
 
   metricBinaryList = sorted(glob.glob(os.path.join(binaryPath, "ValidateImage*")))
 
+  # Metrics are computed by ValidateImageAll in one run per image pair when
+  # it is available, the separate binaries select which metrics it computes
+  allBinary = os.path.join(binaryPath, "ValidateImageAll")
+  if allBinary in metricBinaryList:
+    metricBinaryList.remove(allBinary)
+  else:
+    allBinary = None
+
   # Remove Jaccard if we have both Dice and Jaccard (since they're equivalent)
   diceBinary = os.path.join(binaryPath, "ValidateImageDice")
   jaccardBinary = os.path.join(binaryPath, "ValidateImageJaccard")
@@ -352,19 +468,8 @@ if __name__ == "__main__":
           continue
 
         # Evaluate each metric on gt and perturbed submission
-        metricValues = []
-        for j in range(numMetricBinaries):
-
-          # Run validation app and obtain list of metrics from stdout
-          command = [metricBinaryList[j], pert_gt, subm, textout]
-
-          #print "Running", command
-
-          p = subprocess.Popen(args=command, stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE)
-          stdout, stderr = p.communicate()
-
-          metricValues += getMetricValues(textout, numObjects)
+        metricValues = evaluateMetrics(metricBinaryList, allBinary,
+          pert_gt, subm, textout, numObjects, resultCache)
 
         if debugAddRandom:
           metricValues += [random.uniform(0,100)]
@@ -528,22 +633,11 @@ if __name__ == "__main__":
       tempFileSet.add(textout)
 
       # Evaluate each metric on gt and perturbed submission
-      metricValues = []
-      for j in range(numMetricBinaries):
-
-        # Run validation app and obtain list of metrics from stdout
-        command = [metricBinaryList[j], gt, subm, textout]
+      metricValues = evaluateMetrics(metricBinaryList, allBinary,
+        gt, subm, textout, numObjects, resultCache)
 
-        #print "Running", command
-
-        p = subprocess.Popen(args=command, stdout=subprocess.PIPE,
-          stderr=subprocess.PIPE)
-        stdout, stderr = p.communicate()
-
-        metricValues += getMetricValues(textout, numObjects)
-
-        if debugAddRandom:
-          metricValues += [random.uniform(0,100)]
+      if debugAddRandom:
+        metricValues += [random.uniform(0,100)]
 
       metricTable.append(metricValues)
 
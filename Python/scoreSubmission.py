@@ -4,9 +4,10 @@
 # corresponding set of ground truth files. It is the entry point for this
 # repository's docker container.
 
-# It matches each input file with each ground truth file, scores each one,
-# then builds a JSON response that it prints out at the end representing the
-# final scoring output of the whole submission.
+# It matches each input file with each ground truth file, scores all of the
+# pairs in one run of the scoring executable, which uses every core, and
+# prints the JSON response it builds representing the final scoring output of
+# the whole submission.
 
 from __future__ import print_function
 
@@ -15,6 +16,7 @@ import json
 import os
 import subprocess
 import sys
+import tempfile
 
 
 def matchInputFile(gt, subDir):
@@ -32,23 +34,37 @@ def matchInputFile(gt, subDir):
     raise Exception('No matching input file for prefix: ' + prefix)
 
 
-def runScoring(truth, test):
+def runScoring(pairs, resultCache=None, truthCache=None):
     """
-    Run the scoring executable. This is assumed to be running inside the
-    docker container for this repository.
+    Run the scoring executable on a list of (truth, test) pairs, returning
+    the scores it outputs for each. This is assumed to be running inside the docker
+    container for this repository. With a result cache directory, pairs
+    scored before are looked up instead of computed again. With a ground
+    truth cache directory, the boundaries and distance maps of each ground
+    truth file are computed once and reused by every submission scored
+    against it.
     """
-    command = (
-        '/covalic/_build/Covalic-Build/Code/Testing/validateLabelImages',
-        truth,
-        test
-    )
-
-    p = subprocess.Popen(args=command, stdout=subprocess.PIPE,
-                         stderr=subprocess.PIPE)
-    stdout, stderr = p.communicate()
+    with tempfile.NamedTemporaryFile(
+            mode='w', suffix='.txt', delete=False) as manifest:
+        for truth, test in pairs:
+            manifest.write(truth + '\t' + test + '\n')
+
+    command = ('/covalic/_build/Covalic-Build/Code/Testing/validateLabelImages',)
+    if truthCache is not None:
+        command += ('--groundTruthCache', truthCache)
+    if resultCache is not None:
+        command += ('--resultCache', resultCache)
+    command += ('--manifest', manifest.name)
+
+    try:
+        p = subprocess.Popen(args=command, stdout=subprocess.PIPE,
+                             stderr=subprocess.PIPE)
+        stdout, stderr = p.communicate()
+    finally:
+        os.remove(manifest.name)
 
     if p.returncode != 0:
-        print('Error scoring %s:' % test, file=sys.stderr)
+        print('Error scoring submission:', file=sys.stderr)
         print('Command: ' + ' '.join(command), file=sys.stderr)
         print('STDOUT: ' + stdout, file=sys.stderr)
         print('STDERR: ' + stderr, file=sys.stderr)
@@ -56,30 +72,19 @@ def runScoring(truth, test):
         raise Exception('Scoring subprocess returned error code {}'.format(
             p.returncode))
 
-    metrics = []
-    for line in stdout.splitlines():
-        name, value = line.split('=')
-        metrics.append({
-            'name': name,
-            'value': value
-        })
-
-    return metrics
+    return json.loads(stdout)
 
 
 def scoreAll(args):
-    # Iterate over each file and call scoring executable on the pair
-    scores = []
+    # Match each ground truth file with its input file and score all pairs
+    pairs = []
     for gt in os.listdir(args.groundtruth):
         sub = matchInputFile(gt, args.submission)
         truth = os.path.join(args.groundtruth, gt)
 
-        scores.append({
-            'dataset': gt,
-            'metrics': runScoring(truth, sub)
-        })
+        pairs.append((truth, sub))
 
-    print(json.dumps(scores))
+    print(json.dumps(runScoring(pairs, args.cache, args.truthcache)))
 
 
 if __name__ == '__main__':
@@ -89,6 +94,13 @@ if __name__ == '__main__':
                         help='path to the ground truth folder')
     parser.add_argument('-s', '--submission', required=True,
                         help='path to the submission folder')
+    parser.add_argument('-c', '--cache', default=None,
+                        help='path to a folder of stored results to reuse')
+    parser.add_argument('-t', '--truthcache',
+                        default=os.path.join(tempfile.gettempdir(),
+                                             'covalic_groundtruth_cache'),
+                        help='path to a folder of stored ground truth '
+                        'boundaries and distance maps to reuse')
     args = parser.parse_args()
 
     scoreAll(args)
@@ -39,6 +39,10 @@ void GetImageInformation( std::string fileName,
   // Find out the component type of the image in file
   typedef itk::ImageIOBase::IOComponentType  PixelType;
 
+  // Left unknown if the file cannot be read
+  componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  dimension = 0;
+
   itk::ImageIOBase::Pointer imageIO = 
     itk::ImageIOFactory::CreateImageIO( fileName.c_str(), 
                                         itk::ImageIOFactory::ReadMode );
@@ -57,12 +61,77 @@ void GetImageInformation( std::string fileName,
   dimension = imageIO->GetNumberOfDimensions();
   }
 
+// Description:
+// Of two images, the file name of the one whose component type can hold the
+// values of both, so that reading both as that type truncates neither.
+// Floating point types rank above integers and larger types above smaller
+// ones. Labels are taken to be nonnegative, so of a signed and an unsigned
+// type of the same size the unsigned one is chosen.
+std::string GetWidestImage( std::string fileName1,
+                            std::string fileName2 )
+  {
+  itk::ImageIOBase::IOComponentType componentTypes[2];
+  unsigned int dimension;
+
+  std::string fileNames[2];
+  fileNames[0] = fileName1;
+  fileNames[1] = fileName2;
+
+  int ranks[2];
+  for( unsigned int i = 0; i < 2; i++ )
+    {
+    componentTypes[i] = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+    GetImageInformation( fileNames[i], componentTypes[i], dimension );
+
+    switch( componentTypes[i] )
+      {
+      case itk::ImageIOBase::CHAR:
+        ranks[i] = 2*sizeof(char);
+        break;
+      case itk::ImageIOBase::UCHAR:
+        ranks[i] = 2*sizeof(char) + 1;
+        break;
+      case itk::ImageIOBase::SHORT:
+        ranks[i] = 2*sizeof(short);
+        break;
+      case itk::ImageIOBase::USHORT:
+        ranks[i] = 2*sizeof(short) + 1;
+        break;
+      case itk::ImageIOBase::INT:
+        ranks[i] = 2*sizeof(int);
+        break;
+      case itk::ImageIOBase::UINT:
+        ranks[i] = 2*sizeof(int) + 1;
+        break;
+      case itk::ImageIOBase::LONG:
+        ranks[i] = 2*sizeof(long);
+        break;
+      case itk::ImageIOBase::ULONG:
+        ranks[i] = 2*sizeof(long) + 1;
+        break;
+      case itk::ImageIOBase::FLOAT:
+        ranks[i] = 100;
+        break;
+      case itk::ImageIOBase::DOUBLE:
+        ranks[i] = 101;
+        break;
+      case itk::ImageIOBase::UNKNOWNCOMPONENTTYPE:
+      default:
+        ranks[i] = -1;
+        break;
+      }
+    }
+
+  return ( ranks[1] > ranks[0] ) ? fileName2 : fileName1;
+  }
+
 int ParseArgsAndCallDoIt( std::string inputImage,
                           int argc,
                           char **argv )
   {   
-  itk::ImageIOBase::IOComponentType componentType;
-  unsigned int dimension;
+  itk::ImageIOBase::IOComponentType componentType =
+    itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  unsigned int dimension = 0;
 
   try    
     {    
@@ -127,6 +196,12 @@ int ParseArgsAndCallDoIt( std::string inputImage,
           return EXIT_FAILURE;
         }    
       }
+    else
+      {
+      std::cerr << argv[0] << ": unsupported image dimension " << dimension
+                << " of " << inputImage << std::endl;
+      return EXIT_FAILURE;
+      }
     }  
   catch( itk::ExceptionObject &excep )   
     {    
@@ -139,10 +214,37 @@ int ParseArgsAndCallDoIt( std::string inputImage,
     std::cerr << argv[0] << ": exception caught !" << std::endl;
     return EXIT_FAILURE;    
     }  
-
-  return EXIT_SUCCESS;
   }
 
+// Description:
+// Function object calling ParseArgsAndCallDoIt with the widest of two
+// images, for code taking a callable such as ResultCache::FindOrCompute.
+// The images are only looked at when it is called.
+class CallDoItWithWidestImage
+  {
+public:
+  CallDoItWithWidestImage( std::string fileName1,
+                           std::string fileName2,
+                           int argc,
+                           char **argv )
+    : m_FileName1( fileName1 ), m_FileName2( fileName2 ),
+      m_Argc( argc ), m_Argv( argv )
+    {
+    }
+
+  int operator()() const
+    {
+    return ParseArgsAndCallDoIt( GetWidestImage( m_FileName1, m_FileName2 ),
+                                 m_Argc, m_Argv );
+    }
+
+private:
+  std::string m_FileName1;
+  std::string m_FileName2;
+  int         m_Argc;
+  char      **m_Argv;
+  };
+
 }; // namespace covalic
 
 #endif